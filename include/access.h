@@ -34,6 +34,10 @@ struct CoreExport Privilege
 	Anope::string desc;
 	/* Rank relative to other privileges */
 	int rank;
+	/* Small number identifying this privilege, the same for every privilege
+	 * with this name. Used to index compiled privileges and levels.
+	 */
+	unsigned id;
 
 	Privilege(const Anope::string &name, const Anope::string &desc, int rank);
 	bool operator==(const Privilege &other) const;
@@ -42,12 +46,39 @@ struct CoreExport Privilege
 class CoreExport PrivilegeManager
 {
 	static std::vector<Privilege> Privileges;
+	/* Registered privileges, indexed by id */
+	static std::vector<Privilege *> PrivilegesById;
+	static uint64_t generation;
+
+	static void Reindex();
  public:
 	static void AddPrivilege(Privilege p);
 	static void RemovePrivilege(Privilege &p);
 	static Privilege *FindPrivilege(const Anope::string &name);
 	static std::vector<Privilege> &GetPrivileges();
 	static void ClearPrivileges();
+
+	/** Get the id privileges with the given name have
+	 * @param name The privilege name
+	 * @return The id, which is assigned on first use
+	 */
+	static unsigned GetPrivilegeId(const Anope::string &name);
+
+	/** Get how many privilege ids have been assigned
+	 */
+	static unsigned GetPrivilegeIdCount();
+
+	/** Get the generation of compiled privileges and levels. Changes
+	 * whenever they have to be compiled again.
+	 */
+	static uint64_t GetGeneration() { return generation; }
+
+	/** Make every access entry and channel compile its privileges and
+	 * levels again. Call this when what an access entry has a privilege
+	 * for changes, eg. a provider's configuration. Changes to a channel's
+	 * levels only change that channel's levels generation.
+	 */
+	static void Recompile();
 };
 
 /* A provider of access. Only used for creating ChanAccesses, as
@@ -74,8 +105,15 @@ class CoreExport AccessProvider : public Service
 class CoreExport ChanAccess : public Serializable
 {
 	Anope::string mask;
+	/* mask compiled for matching users against */
+	Anope::CompiledMask compiled_mask;
 	/* account this access entry is for, if any */
 	Serialize::Reference<NickCore> nc;
+	/* privileges this entry has, indexed by Privilege::id, and the
+	 * generations of privileges and the channel's levels they were compiled at
+	 */
+	mutable std::vector<bool> compiled_privs;
+	mutable uint64_t privs_generation, privs_levels_generation;
 
  public:
 	typedef std::vector<ChanAccess *> Path;
@@ -95,6 +133,12 @@ class CoreExport ChanAccess : public Serializable
 	const Anope::string &Mask() const;
 	NickCore *GetAccount() const;
 
+	/** Check if this access entry has the given privilege. The privileges of
+	 * HasPriv(const Anope::string &) are compiled to a bitset on first use.
+	 * @param priv The privilege
+	 */
+	bool HasCompiledPriv(const Privilege &priv) const;
+
 	void Serialize(Serialize::Data &data) const anope_override;
 	static Serializable* Unserialize(Serializable *obj, Serialize::Data &);
 
@@ -154,6 +198,7 @@ class CoreExport AccessGroup
 	 * @return true if any entry has the given privilege
 	 */
 	bool HasPriv(const Anope::string &priv) const;
+	bool HasPriv(const Privilege &priv) const;
 
 	/** Get the "highest" access entry from this group of entries.
 	 * The highest entry is determined by the entry that has the privilege
@@ -171,4 +216,30 @@ class CoreExport AccessGroup
 	inline bool empty() const { return paths.empty(); }
 };
 
+/* Tracks when the matches ChannelInfo::AccessFor memoizes may have changed.
+ * Generations are never handed out twice, so a memoized match for an object
+ * can not be mistaken for one of a later object at the same address.
+ */
+class CoreExport AccessCache
+{
+	static uint64_t last_generation, generation;
+ public:
+	/* How many AccessFor lookups were and weren't answered from memoized matches */
+	static unsigned long hits, misses;
+
+	/** Get a generation that has never been returned before
+	 */
+	static uint64_t NewGeneration() { return ++last_generation; }
+
+	/** Get the generation of everything other than users that access lists
+	 * are matched against, eg. access lists, registered channels and nicks
+	 */
+	static uint64_t Generation() { return generation; }
+
+	/** Forget all memoized matches. Called when an access list or anything
+	 * else other than a user that matching depends on changes.
+	 */
+	static void Invalidate() { generation = NewGeneration(); }
+};
+
 #endif
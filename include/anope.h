@@ -311,12 +311,86 @@ namespace Anope
 	inline const string operator+(const char *_str, const string &str) { string tmp(_str); tmp += str; return tmp; }
 	inline const string operator+(const std::string &_str, const string &str) { string tmp(_str); tmp += str; return tmp; }
 
-	struct hash_ci
+	/**
+	 * A read only reference to a range of characters owned by something else,
+	 * such as a socket's read buffer. It is only valid for as long as the memory
+	 * it refers to, so convert it to a string with str() to keep it.
+	 */
+	class CoreExport string_view
 	{
-		inline size_t operator()(const string &s) const
+		const char *_data;
+		size_t _length;
+
+	 public:
+		typedef const char *const_iterator;
+		typedef size_t size_type;
+		static const size_type npos = static_cast<size_type>(-1);
+
+		string_view() : _data(""), _length(0) { }
+		string_view(const char *_str) : _data(_str), _length(strlen(_str)) { }
+		string_view(const char *_str, size_type n) : _data(_str), _length(n) { }
+		string_view(const string &_str) : _data(_str.data()), _length(_str.length()) { }
+
+		inline const_iterator begin() const { return this->_data; }
+		inline const_iterator end() const { return this->_data + this->_length; }
+
+		inline const char &operator[](size_type n) const { return this->_data[n]; }
+
+		inline const char *data() const { return this->_data; }
+		inline size_type length() const { return this->_length; }
+		inline size_type size() const { return this->_length; }
+		inline bool empty() const { return this->_length == 0; }
+
+		inline string str() const { return string(this->_data, this->_length); }
+
+		inline bool equals_cs(const string_view &_str) const { return this->_length == _str._length && !memcmp(this->_data, _str._data, this->_length); }
+		inline bool equals_ci(const string_view &_str) const
+		{
+			if (this->_length != _str._length)
+				return false;
+			for (size_type i = 0; i < this->_length; ++i)
+				if (Anope::tolower(this->_data[i]) != Anope::tolower(_str._data[i]))
+					return false;
+			return true;
+		}
+
+		inline bool operator==(const string_view &_str) const { return this->equals_cs(_str); }
+		inline bool operator!=(const string_view &_str) const { return !this->equals_cs(_str); }
+
+		inline size_type find(char c, size_type pos = 0) const
 		{
-			return TR1NS::hash<std::string>()(s.lower().str());
+			if (pos >= this->_length)
+				return npos;
+			const void *p = memchr(this->_data + pos, c, this->_length - pos);
+			return p ? static_cast<const char *>(p) - this->_data : npos;
 		}
+
+		inline string_view substr(size_type pos, size_type n = npos) const
+		{
+			if (pos > this->_length)
+				pos = this->_length;
+			return string_view(this->_data + pos, std::min(n, this->_length - pos));
+		}
+
+		/** Remove characters from the front of the view
+		 * @param n How many characters to remove
+		 */
+		inline void remove_prefix(size_type n) { n = std::min(n, this->_length); this->_data += n; this->_length -= n; }
+		/** Remove characters from the end of the view
+		 * @param n How many characters to remove
+		 */
+		inline void remove_suffix(size_type n) { this->_length -= std::min(n, this->_length); }
+	};
+
+	inline std::ostream &operator<<(std::ostream &os, const string_view &_str) { return os.write(_str.data(), _str.length()); }
+
+	/** Case insensitive hash, folding case with the active casemap as it goes
+	 * rather than hashing a lowercased copy.
+	 */
+	struct CoreExport hash_ci
+	{
+		size_t operator()(const string &s) const;
+		static size_t Hash(const char *s, size_t len);
 	};
 
 	struct hash_cs
@@ -327,18 +401,187 @@ namespace Anope
 		}
 	};
 
-	struct compare
+	/** Case insensitive equality using the same case folding as hash_ci */
+	struct CoreExport compare
 	{
-		inline bool operator()(const string &s1, const string &s2) const
-		{
-			return s1.equals_ci(s2);
-		}
+		bool operator()(const string &s1, const string &s2) const;
+		static bool Equals(const char *s1, const char *s2, size_t len);
 	};
 
 	template<typename T> class map : public std::map<string, T, ci::less> { };
 	template<typename T> class multimap : public std::multimap<string, T, ci::less> { };
 	template<typename T> class hash_map : public TR1NS::unordered_map<string, T, hash_ci, compare> { };
 
+	/** A map keyed by the IDs of TS6 style protocols, such as UIDs and SIDs.
+	 * IDs of up to ten letters and digits are packed into an integer, which is
+	 * used as the key instead of the string. Anything else is kept keyed by
+	 * its hash_ci hash, so protocols using other kinds of IDs still work and
+	 * can be looked up without building a string. Like hash_map, keys are
+	 * case insensitive.
+	 */
+	template<typename T> class id_map
+	{
+	 public:
+		typedef TR1NS::unordered_map<uint64_t, T> packed_map;
+		typedef TR1NS::unordered_multimap<size_t, std::pair<string, T> > other_map;
+
+	 private:
+		packed_map packed;
+		other_map other;
+
+		static inline bool Matches(const typename other_map::value_type &entry, const char *s, size_t len)
+		{
+			return entry.second.first.length() == len && compare::Equals(entry.second.first.data(), s, len);
+		}
+
+	 public:
+		/** Pack an ID into an integer, six bits per character
+		 * @param s The ID
+		 * @param len The length of the ID
+		 * @param id Set to the packed ID
+		 * @return false if the ID can not be packed
+		 */
+		static inline bool Pack(const char *s, size_t len, uint64_t &id)
+		{
+			if (!len || len > 10)
+				return false;
+
+			id = 0;
+			for (size_t i = 0; i < len; ++i)
+			{
+				char c = s[i];
+				unsigned v;
+				if (c >= '0' && c <= '9')
+					v = c - '0' + 1;
+				else if (c >= 'A' && c <= 'Z')
+					v = c - 'A' + 11;
+				else if (c >= 'a' && c <= 'z')
+					v = c - 'a' + 11;
+				else
+					return false;
+				id = (id << 6) | v;
+			}
+			return true;
+		}
+
+		/** Find the value for an ID
+		 * @param s The ID
+		 * @param len The length of the ID
+		 * @return The value, or a default constructed T if there is none
+		 */
+		T Find(const char *s, size_t len) const
+		{
+			uint64_t id;
+			if (Pack(s, len, id))
+			{
+				typename packed_map::const_iterator it = packed.find(id);
+				return it != packed.end() ? it->second : T();
+			}
+
+			std::pair<typename other_map::const_iterator, typename other_map::const_iterator> range = other.equal_range(hash_ci::Hash(s, len));
+			for (typename other_map::const_iterator it = range.first; it != range.second; ++it)
+				if (Matches(*it, s, len))
+					return it->second.second;
+			return T();
+		}
+
+		T Find(const string &s) const { return Find(s.data(), s.length()); }
+
+		T &operator[](const string &s)
+		{
+			uint64_t id;
+			if (Pack(s.data(), s.length(), id))
+				return packed[id];
+
+			size_t hash = hash_ci::Hash(s.data(), s.length());
+			std::pair<typename other_map::iterator, typename other_map::iterator> range = other.equal_range(hash);
+			for (typename other_map::iterator it = range.first; it != range.second; ++it)
+				if (Matches(*it, s.data(), s.length()))
+					return it->second.second;
+			return other.insert(std::make_pair(hash, std::make_pair(s, T())))->second.second;
+		}
+
+		void erase(const string &s)
+		{
+			uint64_t id;
+			if (Pack(s.data(), s.length(), id))
+			{
+				packed.erase(id);
+				return;
+			}
+
+			std::pair<typename other_map::iterator, typename other_map::iterator> range = other.equal_range(hash_ci::Hash(s.data(), s.length()));
+			for (typename other_map::iterator it = range.first; it != range.second; ++it)
+				if (Matches(*it, s.data(), s.length()))
+				{
+					other.erase(it);
+					return;
+				}
+		}
+
+		size_t size() const { return packed.size() + other.size(); }
+		bool empty() const { return packed.empty() && other.empty(); }
+
+		const packed_map &GetPacked() const { return packed; }
+		const other_map &GetOther() const { return other; }
+	};
+
+	/** A wildcard mask split up for matching, for masks which are matched
+	 * many times such as those of XLines and access entries. The parts of the
+	 * mask between its *s are folded to lower case once here, so matching only
+	 * has to fold the string. Parts which are surrounded by *s and have no ?s
+	 * are searched for as a whole.
+	 */
+	class CoreExport CompiledMask
+	{
+		struct Segment
+		{
+			string text;
+			/* Whether text contains a ? */
+			bool wild;
+		};
+
+		string mask;
+		bool case_sensitive;
+		/* Whether the mask has no *s */
+		mutable bool literal;
+		/* Whether the mask begins or ends with a * */
+		mutable bool star_start, star_end;
+		mutable std::vector<Segment> segments;
+		/* The length of the shortest string which can match */
+		mutable size_t min_length;
+		/* The case map generation the segments were folded with */
+		mutable unsigned casemap;
+
+		/* Bumped by ClearCache */
+		static unsigned casemaps;
+
+		void Compile() const;
+		bool SegmentAt(const Segment &seg, const char *str) const;
+		size_t FindSegment(const Segment &seg, const string &str, size_t pos, size_t end) const;
+
+	 public:
+		/** Constructor
+		 * @param m The mask, only * and ? are wildcards
+		 * @param cs Whether or not the match is case sensitive
+		 */
+		CompiledMask(const string &m = "", bool cs = false);
+
+		const string &GetMask() const { return mask; }
+
+		/** Check whether a string matches this mask
+		 * @param str The string
+		 * @return true if it matches
+		 */
+		bool Matches(const string &str) const;
+
+		/** Empties the cache of regular expressions used by Anope::Match, and
+		 * makes case insensitive masks fold their parts again when they are
+		 * next matched. Called when the case map or regex engine changes.
+		 */
+		static void ClearCache();
+	};
+
 #ifndef REPRODUCIBLE_BUILD
 	static const char *const compiled = __TIME__ " " __DATE__;
 #endif
@@ -540,6 +783,7 @@ namespace Anope
 	 * @param Raw message from the uplink
 	 */
 	extern void Process(const Anope::string &);
+	extern void Process(const Anope::string_view &);
 
 	/** Does a blocking dns query and returns the first IP.
 	 * @param host host to look up
@@ -39,6 +39,8 @@ class CoreExport Channel : public Base, public Extensible
 	/** A map of channel modes with their parameters set on this channel
 	 */
 	ModeList modes;
+	/* Entries of the list modes MatchesList has checked, dropped when the list changes */
+	std::map<Anope::string, std::vector<Entry> > list_entries;
 
  public:
 	/* Channel name */
@@ -24,6 +24,9 @@ class CoreExport ExtensibleBase : public Service
 	ExtensibleBase(Module *m, const Anope::string &n);
 	~ExtensibleBase();
 
+	/* Marks obj as changed if it is serializable, as its extensions are serialized with it */
+	static void Changed(Extensible *obj);
+
  public:
 	virtual void Unset(Extensible *obj) = 0;
 
@@ -90,15 +93,21 @@ class BaseExtensibleItem : public ExtensibleBase
 		Unset(obj);
 		items[obj] = t;
 		obj->extension_items.insert(this);
+		Changed(obj);
 		return t;
 	}
 
 	void Unset(Extensible *obj) anope_override
 	{
+		/* Every object is unset from every item it is not loaded with, so check the object's own small set first */
+		if (!obj->extension_items.count(this))
+			return;
+
 		T *value = Get(obj);
 		items.erase(obj);
 		obj->extension_items.erase(this);
 		delete value;
+		Changed(obj);
 	}
 
 	T* Get(const Extensible *obj) const
@@ -191,14 +200,12 @@ class SerializableExtensibleItem<bool> : public PrimitiveExtensibleItem<bool>
 	void ExtensibleSerialize(const Extensible *e, const Serializable *s, Serialize::Data &data) const anope_override
 	{
 		data.SetType(this->name, Serialize::Data::DT_INT);
-		data[this->name] << this->HasExt(e);
+		data.SetInt(this->name, this->HasExt(e));
 	}
 
 	void ExtensibleUnserialize(Extensible *e, Serializable *s, Serialize::Data &data) anope_override
 	{
-		bool b = false;
-		data[this->name] >> b;
-		if (b)
+		if (data.GetInt(this->name))
 			this->Set(e);
 		else
 			this->Unset(e);
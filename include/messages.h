@@ -52,6 +52,7 @@ namespace Message
 		Join(Module *creator, const Anope::string &mname = "JOIN") : IRCDMessage(creator, mname, 1) { SetFlag(IRCDMESSAGE_REQUIRE_USER); SetFlag(IRCDMESSAGE_SOFT_LIMIT); }
 
 		void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override;
+		void Run(MessageSource &source, const ParsedMessage &message) anope_override;
 
 		typedef std::pair<ChannelStatus, User *> SJoinUser;
 
@@ -105,6 +106,7 @@ namespace Message
 		Part(Module *creator, const Anope::string &mname = "PART") : IRCDMessage(creator, mname, 1) { SetFlag(IRCDMESSAGE_REQUIRE_USER); SetFlag(IRCDMESSAGE_SOFT_LIMIT); }
 
 		void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override;
+		void Run(MessageSource &source, const ParsedMessage &message) anope_override;
 	};
 
 	struct CoreExport Ping : IRCDMessage
@@ -112,6 +114,7 @@ namespace Message
 		Ping(Module *creator, const Anope::string &mname = "PING") : IRCDMessage(creator, mname, 1) { SetFlag(IRCDMESSAGE_SOFT_LIMIT); }
 
 		void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override;
+		void Run(MessageSource &source, const ParsedMessage &message) anope_override;
 	};
 
 	struct CoreExport Privmsg : IRCDMessage
@@ -119,6 +122,7 @@ namespace Message
 		Privmsg(Module *creator, const Anope::string &mname = "PRIVMSG") : IRCDMessage(creator, mname, 2) { SetFlag(IRCDMESSAGE_REQUIRE_USER); }
 
 		void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override;
+		void Run(MessageSource &source, const ParsedMessage &message) anope_override;
 	};
 
 	struct CoreExport Quit : IRCDMessage
@@ -126,6 +130,7 @@ namespace Message
 		Quit(Module *creator, const Anope::string &mname = "QUIT") : IRCDMessage(creator, mname, 1) { SetFlag(IRCDMESSAGE_REQUIRE_USER); }
 
 		void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override;
+		void Run(MessageSource &source, const ParsedMessage &message) anope_override;
 	};
 
 	struct CoreExport SQuit : IRCDMessage
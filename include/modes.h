@@ -393,6 +393,8 @@ class CoreExport Entry
 {
 	Anope::string name;
 	Anope::string mask;
+	/* nick, user, host and real compiled for matching */
+	Anope::CompiledMask nick_mask, user_mask, host_mask, real_mask;
  public:
 	unsigned short cidr_len;
 	int family;
@@ -37,6 +37,18 @@ struct BadWord
 
 struct BadWords
 {
+ private:
+	static size_t Find(const Anope::string &text, const Anope::string &word, bool casesensitive)
+	{
+		return casesensitive ? text.find(word) : text.find_ci(word);
+	}
+
+	static bool Equals(const Anope::string &a, const Anope::string &b, bool casesensitive)
+	{
+		return casesensitive ? a.equals_cs(b) : a.equals_ci(b);
+	}
+
+ public:
 	virtual ~BadWords() { }
 
 	/** Add a badword to the badword list
@@ -66,5 +78,51 @@ struct BadWords
 	 */
 	virtual void ClearBadWords() = 0;
 
+	/** Find the first badword on the list a message contains. By default
+	 * each badword is checked against the message in turn.
+	 * @param text The normalized message
+	 * @param casesensitive Whether badwords are matched case sensitively
+	 * @return The badword, or NULL if there is none
+	 */
+	virtual BadWord* FindBadWord(const Anope::string &text, bool casesensitive)
+	{
+		for (unsigned i = 0; i < this->GetBadWordCount(); ++i)
+		{
+			BadWord *bw = this->GetBadWord(i);
+			size_t len = bw->word.length();
+
+			if (!len || len > text.length())
+				continue;
+
+			switch (bw->type)
+			{
+				case BW_ANY:
+					if (Find(text, bw->word, casesensitive) != Anope::string::npos)
+						return bw;
+					break;
+				case BW_SINGLE:
+					if (Equals(bw->word, text, casesensitive))
+						return bw;
+					if (text.find(' ') == len && Equals(bw->word, text.substr(0, len), casesensitive))
+						return bw;
+					if (len < text.length() && text.rfind(' ') == text.length() - len - 1 && Find(text, bw->word, casesensitive) == text.length() - len)
+						return bw;
+					if (Find(text, " " + bw->word + " ", casesensitive) != Anope::string::npos)
+						return bw;
+					break;
+				case BW_START:
+					if (Equals(text.substr(0, len), bw->word, casesensitive) || Find(text, " " + bw->word, casesensitive) != Anope::string::npos)
+						return bw;
+					break;
+				case BW_END:
+					if (Equals(text.substr(text.length() - len), bw->word, casesensitive) || Find(text, bw->word + " ", casesensitive) != Anope::string::npos)
+						return bw;
+					break;
+			}
+		}
+
+		return NULL;
+	}
+
 	virtual void Check() = 0;
 };
@@ -0,0 +1,462 @@
+/*
+ *
+ * (C) 2003-2024 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ */
+
+#ifndef DB_FLATFILE_H
+#define DB_FLATFILE_H
+
+/* The binary snapshot format of db_flatfile. This only uses the standard
+ * library so anopedbconv can convert databases without linking to Anope.
+ *
+ * All integers are little endian. A snapshot is:
+ *
+ *   "ANOPEDB\0" <u32 version>
+ *   <u32 string count> { <u32 length> <bytes> } ...
+ *   <u32 section count> { <u32 type string> <u32 object count> <u64 offset> <u64 length> } ...
+ *   the sections, one per type, each a run of objects:
+ *     <u64 id> <u32 field count> { <u32 key string> <u32 length> <bytes> } ...
+ *
+ * Type names and keys are stored once in the string table. If an object has
+ * the same key twice, the last one is used, like the text format.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace FlatFile
+{
+	static const char Magic[8] = { 'A', 'N', 'O', 'P', 'E', 'D', 'B', '\0' };
+	static const uint32_t Version = 1;
+
+	/** Check whether a database is a binary snapshot
+	 * @param data The start of the file
+	 * @param len How much of the file there is
+	 */
+	inline bool IsBinary(const char *data, size_t len)
+	{
+		return len >= sizeof(Magic) && !memcmp(data, Magic, sizeof(Magic));
+	}
+
+	/** Parse the decimal object id of an ID line
+	 * @param p The start of the number
+	 * @param eol The end of the line
+	 * @param id Set to the id if the whole line is a number
+	 * @return false if it is not
+	 */
+	inline bool ParseId(const char *p, const char *eol, uint64_t &id)
+	{
+		if (p == eol)
+			return false;
+
+		uint64_t i = 0;
+		for (; p != eol; ++p)
+		{
+			if (*p < '0' || *p > '9')
+				return false;
+			i = i * 10 + (*p - '0');
+		}
+		id = i;
+		return true;
+	}
+
+	inline void Put32(std::string &out, uint32_t i)
+	{
+		char buf[4];
+		for (unsigned j = 0; j < 4; ++j)
+			buf[j] = static_cast<char>(i >> (j * 8));
+		out.append(buf, 4);
+	}
+
+	inline void Put64(std::string &out, uint64_t i)
+	{
+		Put32(out, static_cast<uint32_t>(i));
+		Put32(out, static_cast<uint32_t>(i >> 32));
+	}
+
+	/** Builds a snapshot from objects given in any order of types */
+	class Writer
+	{
+	 public:
+		/* Where an object is in its section */
+		struct Position
+		{
+			size_t section, begin, end;
+
+			bool operator<(const Position &other) const
+			{
+				return section < other.section || (section == other.section && begin < other.begin);
+			}
+		};
+
+	 private:
+		struct Section
+		{
+			uint32_t type;
+			uint32_t count;
+			std::string data;
+		};
+
+		std::map<std::string, uint32_t> string_ids;
+		std::vector<std::string> strings;
+		std::vector<Section> sections;
+		/* Section of each type string */
+		std::map<uint32_t, size_t> section_ids;
+
+		Section *current;
+		/* Where the last object begun is */
+		Position last;
+		/* Objects to leave out of the snapshot */
+		std::vector<Position> removed;
+		/* Where the current object's field count is */
+		size_t count_pos;
+		uint32_t field_count;
+
+		static void Set32(std::string &out, size_t pos, uint32_t i)
+		{
+			for (unsigned j = 0; j < 4; ++j)
+				out[pos + j] = static_cast<char>(i >> (j * 8));
+		}
+
+	 public:
+		Writer() : current(NULL), count_pos(0), field_count(0)
+		{
+			last.section = last.begin = last.end = 0;
+		}
+
+		uint32_t AddString(const std::string &str)
+		{
+			std::pair<std::map<std::string, uint32_t>::iterator, bool> it = this->string_ids.insert(std::make_pair(str, static_cast<uint32_t>(this->strings.size())));
+			if (it.second)
+				this->strings.push_back(str);
+			return it.first->second;
+		}
+
+		void BeginObject(const std::string &type, uint64_t id)
+		{
+			uint32_t t = this->AddString(type);
+			std::pair<std::map<uint32_t, size_t>::iterator, bool> it = this->section_ids.insert(std::make_pair(t, this->sections.size()));
+			if (it.second)
+			{
+				this->sections.push_back(Section());
+				this->sections.back().type = t;
+				this->sections.back().count = 0;
+			}
+
+			this->current = &this->sections[it.first->second];
+			++this->current->count;
+			this->last.section = it.first->second;
+			this->last.begin = this->current->data.size();
+			Put64(this->current->data, id);
+			this->count_pos = this->current->data.size();
+			this->field_count = 0;
+			Put32(this->current->data, 0);
+		}
+
+		void AddField(const std::string &key, const char *value, size_t len)
+		{
+			Put32(this->current->data, this->AddString(key));
+			Put32(this->current->data, static_cast<uint32_t>(len));
+			this->current->data.append(value, len);
+			++this->field_count;
+		}
+
+		void EndObject()
+		{
+			Set32(this->current->data, this->count_pos, this->field_count);
+			this->last.end = this->current->data.size();
+			this->current = NULL;
+		}
+
+		/** Get where the last object written is */
+		const Position &GetLast() const { return this->last; }
+
+		/** Leave an object already written out of the snapshot
+		 * @param pos Where it is, from GetLast()
+		 */
+		void Remove(const Position &pos)
+		{
+			this->removed.push_back(pos);
+		}
+
+		/** Get the snapshot. The writer is empty afterwards.
+		 * @param out Where to put it
+		 */
+		void Finish(std::string &out)
+		{
+			/* Close up the gaps left by removed objects, a section at a time */
+			std::sort(this->removed.begin(), this->removed.end());
+			for (size_t i = 0; i < this->removed.size();)
+			{
+				size_t section = this->removed[i].section;
+				Section &s = this->sections[section];
+				char *data = &s.data[0];
+				size_t to = this->removed[i].begin, from = to;
+				for (; i < this->removed.size() && this->removed[i].section == section; ++i)
+				{
+					const Position &pos = this->removed[i];
+					memmove(data + to, data + from, pos.begin - from);
+					to += pos.begin - from;
+					from = pos.end;
+					--s.count;
+				}
+				memmove(data + to, data + from, s.data.size() - from);
+				s.data.resize(to + s.data.size() - from);
+			}
+			this->removed.clear();
+
+			out.clear();
+			out.append(Magic, sizeof(Magic));
+			Put32(out, Version);
+
+			Put32(out, static_cast<uint32_t>(this->strings.size()));
+			for (unsigned i = 0; i < this->strings.size(); ++i)
+			{
+				Put32(out, static_cast<uint32_t>(this->strings[i].length()));
+				out.append(this->strings[i]);
+			}
+
+			size_t total = 0;
+			for (unsigned i = 0; i < this->sections.size(); ++i)
+				total += this->sections[i].data.size();
+
+			Put32(out, static_cast<uint32_t>(this->sections.size()));
+			uint64_t offset = out.size() + this->sections.size() * 24;
+			out.reserve(offset + total);
+			for (unsigned i = 0; i < this->sections.size(); ++i)
+			{
+				const Section &s = this->sections[i];
+				Put32(out, s.type);
+				Put32(out, s.count);
+				Put64(out, offset);
+				Put64(out, s.data.size());
+				offset += s.data.size();
+			}
+
+			for (unsigned i = 0; i < this->sections.size(); ++i)
+			{
+				out.append(this->sections[i].data);
+				std::string().swap(this->sections[i].data);
+			}
+
+			this->string_ids.clear();
+			this->strings.clear();
+			this->sections.clear();
+			this->section_ids.clear();
+		}
+	};
+
+	/** Reads a snapshot in place, without copying any of it */
+	class Reader
+	{
+	 public:
+		struct String
+		{
+			const char *data;
+			uint32_t length;
+
+			bool operator==(const char *str) const { return strlen(str) == length && !memcmp(data, str, length); }
+			std::string str() const { return std::string(data, length); }
+		};
+
+		struct Field
+		{
+			uint32_t key;
+			const char *value;
+			uint32_t length;
+		};
+
+		struct Section
+		{
+			uint32_t type;
+			uint32_t count;
+			const char *begin, *end;
+		};
+
+		/* A cursor over the objects of a section */
+		struct Object
+		{
+			const char *pos, *end;
+			uint64_t id;
+			std::vector<Field> fields;
+
+			Object() : pos(NULL), end(NULL), id(0) { }
+		};
+
+	 private:
+		const char *data, *end;
+		std::vector<String> strings;
+		std::vector<Section> sections;
+
+		static uint32_t Get32(const char *p)
+		{
+			const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+			return u[0] | (u[1] << 8) | (u[2] << 16) | (static_cast<uint32_t>(u[3]) << 24);
+		}
+
+		static uint64_t Get64(const char *p)
+		{
+			return Get32(p) | (static_cast<uint64_t>(Get32(p + 4)) << 32);
+		}
+
+		bool Read32(const char *&p, uint32_t &i) const
+		{
+			if (this->end - p < 4)
+				return false;
+			i = Get32(p);
+			p += 4;
+			return true;
+		}
+
+	 public:
+		Reader() : data(NULL), end(NULL) { }
+
+		/** Parse the string table and section list of a snapshot
+		 * @param d The snapshot, which must outlive the reader
+		 * @param len Its length
+		 * @param error Set to what is wrong with it, if anything
+		 * @return Whether the snapshot is usable
+		 */
+		bool Open(const char *d, size_t len, std::string &error)
+		{
+			this->data = d;
+			this->end = d + len;
+			this->strings.clear();
+			this->sections.clear();
+
+			if (!IsBinary(d, len))
+			{
+				error = "not a binary database";
+				return false;
+			}
+
+			const char *p = d + sizeof(Magic);
+			uint32_t version, count;
+			if (!this->Read32(p, version) || version != Version)
+			{
+				error = "unsupported version";
+				return false;
+			}
+
+			if (!this->Read32(p, count))
+			{
+				error = "truncated string table";
+				return false;
+			}
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				String s;
+				if (!this->Read32(p, s.length) || static_cast<uint64_t>(this->end - p) < s.length)
+				{
+					error = "truncated string table";
+					return false;
+				}
+				s.data = p;
+				p += s.length;
+				this->strings.push_back(s);
+			}
+
+			if (!this->Read32(p, count) || static_cast<uint64_t>(this->end - p) < static_cast<uint64_t>(count) * 24)
+			{
+				error = "truncated section table";
+				return false;
+			}
+			for (uint32_t i = 0; i < count; ++i, p += 24)
+			{
+				Section s;
+				s.type = Get32(p);
+				s.count = Get32(p + 4);
+				uint64_t offset = Get64(p + 8), length = Get64(p + 16);
+				if (s.type >= this->strings.size() || offset > len || length > len - offset)
+				{
+					error = "bad section table";
+					return false;
+				}
+				s.begin = d + offset;
+				s.end = s.begin + length;
+				this->sections.push_back(s);
+			}
+
+			return true;
+		}
+
+		const std::vector<Section> &GetSections() const { return this->sections; }
+
+		const String &GetString(uint32_t i) const { return this->strings[i]; }
+
+		void Begin(const Section &s, Object &obj) const
+		{
+			obj.pos = s.begin;
+			obj.end = s.end;
+		}
+
+		/** Read the next object of a section
+		 * @param obj The cursor from Begin
+		 * @param error Set if the section is corrupt
+		 * @return false at the end of the section, or if it is corrupt
+		 */
+		bool Next(Object &obj, std::string &error) const
+		{
+			obj.fields.clear();
+			if (obj.pos == obj.end)
+				return false;
+
+			if (obj.end - obj.pos < 12)
+			{
+				error = "truncated object";
+				return false;
+			}
+			obj.id = Get64(obj.pos);
+			uint32_t count = Get32(obj.pos + 8);
+			obj.pos += 12;
+
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				Field f;
+				if (obj.end - obj.pos < 8)
+				{
+					error = "truncated field";
+					return false;
+				}
+				f.key = Get32(obj.pos);
+				f.length = Get32(obj.pos + 4);
+				obj.pos += 8;
+				if (f.key >= this->strings.size() || static_cast<uint64_t>(obj.end - obj.pos) < f.length)
+				{
+					error = "bad field";
+					return false;
+				}
+				f.value = obj.pos;
+				obj.pos += f.length;
+				obj.fields.push_back(f);
+			}
+
+			return true;
+		}
+
+		/** Find the value of a key in an object, the last one if there are several
+		 * @return The field, or NULL
+		 */
+		const Field *Find(const Object &obj, const char *key, size_t keylen) const
+		{
+			for (size_t i = obj.fields.size(); i > 0; --i)
+			{
+				const Field &f = obj.fields[i - 1];
+				const String &k = this->strings[f.key];
+				if (k.length == keylen && !memcmp(k.data, key, keylen))
+					return &f;
+			}
+			return NULL;
+		}
+	};
+}
+
+#endif // DB_FLATFILE_H
@@ -124,7 +124,10 @@ class HTTPClient : public ClientSocket, public BinarySocket, public Base
 	}
 
  public:
-	HTTPClient(ListenSocket *l, int f, const sockaddrs &a) : ClientSocket(l, a), BinarySocket() { }
+	HTTPClient(ListenSocket *l, int f, const sockaddrs &a) : ClientSocket(l, a), BinarySocket()
+	{
+		this->SetWriteHighWater(NET_BUFSIZE);
+	}
 
 	virtual const Anope::string GetIP()
 	{
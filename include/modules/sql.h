@@ -29,6 +29,53 @@ namespace SQL
 			return *ss;
 		}
 
+		void SetString(const Anope::string &key, const Anope::string_view &value) anope_override
+		{
+			std::stringstream *&ss = data[key];
+			if (!ss)
+				ss = new std::stringstream();
+			ss->str(std::string(value.data(), value.length()));
+			ss->clear();
+		}
+
+		void SetInt(const Anope::string &key, int64_t value) anope_override
+		{
+			char buf[20];
+			this->SetString(key, Serialize::FormatInt(buf, value));
+		}
+
+		void SetUInt(const Anope::string &key, uint64_t value) anope_override
+		{
+			char buf[20];
+			this->SetString(key, Serialize::FormatUInt(buf, value));
+		}
+
+		Anope::string GetString(const Anope::string &key) anope_override
+		{
+			Map::const_iterator it = this->data.find(key);
+			return it != this->data.end() ? it->second->str() : "";
+		}
+
+		int64_t GetInt(const Anope::string &key, int64_t def = 0) anope_override
+		{
+			Map::const_iterator it = this->data.find(key);
+			if (it == this->data.end())
+				return def;
+
+			const std::string &value = it->second->str();
+			return Serialize::ParseInt(Anope::string_view(value.data(), value.length()), def);
+		}
+
+		uint64_t GetUInt(const Anope::string &key, uint64_t def = 0) anope_override
+		{
+			Map::const_iterator it = this->data.find(key);
+			if (it == this->data.end())
+				return def;
+
+			const std::string &value = it->second->str();
+			return Serialize::ParseUInt(Anope::string_view(value.data(), value.length()), def);
+		}
+
 		std::set<Anope::string> KeySet() const anope_override
 		{
 			std::set<Anope::string> keys;
@@ -37,15 +84,6 @@ namespace SQL
 			return keys;
 		}
 
-		size_t Hash() const anope_override
-		{
-			size_t hash = 0;
-			for (Map::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
-				if (!it->second->str().empty())
-					hash ^= Anope::hash_cs()(it->second->str());
-			return hash;
-		}
-
 		std::map<Anope::string, std::iostream *> GetData() const
 		{
 			std::map<Anope::string, std::iostream *> d;
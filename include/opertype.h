@@ -66,6 +66,45 @@ class CoreExport OperType
 	/** Set of opertypes we inherit from
 	 */
 	std::set<OperType *> inheritances;
+
+	/** privs or commands compiled for matching. Masks without wildcards
+	 * are looked up in a hash map, the rest are tried in order.
+	 */
+	struct CompiledList
+	{
+		struct Wildcard
+		{
+			/* Position in the list */
+			size_t pos;
+			/* Whether this grants, or is a ~ negation */
+			bool grant;
+			Anope::CompiledMask mask;
+		};
+
+		bool compiled;
+		/* Position and whether it grants of the first entry for each name without wildcards */
+		Anope::hash_map<std::pair<size_t, bool> > exact;
+		std::vector<Wildcard> wildcards;
+		/* Results of previous checks, including those decided by inherited opertypes */
+		Anope::hash_map<bool> results;
+
+		CompiledList() : compiled(false) { }
+
+		void Compile(const std::list<Anope::string> &list);
+		void Clear();
+
+		/** Find the first entry matching a string
+		 * @return 1 if it grants, 0 if it is a negation, -1 if nothing matches
+		 */
+		int Decide(const Anope::string &str) const;
+	};
+
+	mutable CompiledList compiled_commands, compiled_privs;
+
+	/** Check a command or priv against this opertype and the ones it inherits,
+	 * compiling this opertype's list on first use
+	 */
+	bool Check(bool is_command, const Anope::string &str) const;
  public:
 	/** Modes to set when someone identifies using this opertype
 	 */
@@ -17,6 +17,45 @@
 #include "service.h"
 #include "modes.h"
 
+/** A message from the uplink tokenized in place. The tags, source, command
+ * and parameters all refer to the line the message was parsed from, so it is
+ * only valid for as long as that line is.
+ */
+struct CoreExport ParsedMessage
+{
+	struct Tag
+	{
+		Anope::string_view name, value;
+	};
+
+	std::vector<Tag> tags;
+	Anope::string_view source;
+	Anope::string_view command;
+	std::vector<Anope::string_view> params;
+
+	ParsedMessage();
+
+	/** Refer to already split parameters, eg. to call the Run() taking a
+	 * ParsedMessage from one taking a vector of strings
+	 * @param p The parameters, which must outlive this object
+	 */
+	explicit ParsedMessage(const std::vector<Anope::string> &p);
+
+	/** Empty the message, keeping the memory allocated for it */
+	void clear();
+
+	/** Copy the parameters into strings, for code which wants to keep them
+	 * or still takes a vector of strings
+	 * @param p The vector to fill, it is cleared first
+	 */
+	void GetParams(std::vector<Anope::string> &p) const;
+
+	/** Copy the tags into a map
+	 * @param t The map to fill
+	 */
+	void GetTags(Anope::map<Anope::string> &t) const;
+};
+
 /* Encapsulates the IRCd protocol we are speaking. */
 class CoreExport IRCDProto : public Service
 {
@@ -41,6 +80,12 @@ class CoreExport IRCDProto : public Service
 
 	const Anope::string &GetProtocolName();
 	virtual bool Parse(const Anope::string &, Anope::map<Anope::string> &, Anope::string &, Anope::string &, std::vector<Anope::string> &);
+	/** Parse a message from the uplink without copying any of it
+	 * @param buffer The message
+	 * @param message Filled in with views into buffer, it should be empty
+	 * @return false if the message is malformed
+	 */
+	virtual bool Parse(const Anope::string_view &buffer, ParsedMessage &message);
 	virtual Anope::string Format(const Anope::string &source, const Anope::string &message);
 
 	/* Modes used by default by our clients */
@@ -268,7 +313,13 @@ enum IRCDMessageFlag
 {
 	IRCDMESSAGE_SOFT_LIMIT,
 	IRCDMESSAGE_REQUIRE_SERVER,
-	IRCDMESSAGE_REQUIRE_USER
+	IRCDMESSAGE_REQUIRE_USER,
+	/* Set by subclasses of the core handlers in messages.h which override
+	 * the ParsedMessage Run(). Without it a subclass gets its vector Run()
+	 * called, even when the message reaches the core handler's ParsedMessage
+	 * Run().
+	 */
+	IRCDMESSAGE_PARSED
 };
 
 class CoreExport IRCDMessage : public Service
@@ -278,27 +329,78 @@ class CoreExport IRCDMessage : public Service
 	std::set<IRCDMessageFlag> flags;
  public:
 	IRCDMessage(Module *owner, const Anope::string &n, unsigned p = 0);
+	~IRCDMessage();
 	unsigned GetParamCount() const;
 	virtual void Run(MessageSource &, const std::vector<Anope::string> &params) = 0;
 	virtual void Run(MessageSource &, const std::vector<Anope::string> &params, const Anope::map<Anope::string> &tags);
 
+	/** Called with the message as parsed from the uplink. By default this
+	 * copies the parameters and tags and calls one of the Run() overloads
+	 * above; handlers on hot paths can override it to use the views directly.
+	 */
+	virtual void Run(MessageSource &, const ParsedMessage &message);
+
 	void SetFlag(IRCDMessageFlag f) { flags.insert(f); }
 	bool HasFlag(IRCDMessageFlag f) const { return flags.count(f); }
 };
 
+/** Maps the commands received from the uplink to the IRCDMessages of the
+ * protocol module handling them. The table is built from the registered
+ * services (and their aliases) when the first message after a change
+ * arrives, and thrown away whenever a module is loaded or unloaded or an
+ * IRCDMessage is created or destroyed, so looking up a command neither
+ * allocates nor walks the service maps.
+ */
+class CoreExport MessageTable
+{
+ public:
+	/** Usage of one command, kept across rebuilds of the table */
+	struct Stats
+	{
+		/* Lowercased command name */
+		Anope::string command;
+		/* How many times the command was dispatched */
+		unsigned long hits;
+		/* Time spent in the handler, in microseconds */
+		unsigned long long time;
+
+		Stats() : hits(0), time(0) { }
+	};
+
+	/** Find the handler of a command
+	 * @param command The command, in any case
+	 * @param stats Set to the usage of the command if a handler was found
+	 * @return The handler, or NULL if the protocol module has none
+	 */
+	static IRCDMessage *Find(const Anope::string_view &command, Stats *&stats);
+
+	/** Mark the table as needing to be rebuilt */
+	static void Invalidate();
+
+	/** Get the usage of every command seen so far
+	 * @param stats Filled with the stats, most used first
+	 */
+	static void GetStats(std::vector<const Stats *> &stats);
+
+	/** Zero the usage of every command */
+	static void ResetStats();
+};
+
 /** MessageTokenizer allows tokens in the IRC wire format to be read from a string */
 class CoreExport MessageTokenizer
 {
 private:
 	/** The message we are parsing tokens from. */
-	Anope::string message;
+	Anope::string_view message;
 
 	/** The current position within the message. */
 	Anope::string::size_type position;
 
  public:
-	/** Create a tokenstream and fill it with the provided data. */
-	MessageTokenizer(const Anope::string &msg);
+	/** Create a tokenstream and fill it with the provided data.
+	 * The tokenizer refers to msg, which must outlive it.
+	 */
+	MessageTokenizer(const Anope::string_view &msg);
 
 	/** Retrieve the next \<middle> token in the message.
 	 * @param token The next token available, or an empty string if none remain.
@@ -311,6 +413,18 @@ private:
 	 * @return True if a token was retrieved; otherwise, false.
 	 */
 	bool GetTrailing(Anope::string &token);
+
+	/** Retrieve the next \<middle> token in the message without copying it.
+	 * @param token The next token available, or an empty view if none remain.
+	 * @return True if a token was retrieved; otherwise, false.
+	 */
+	bool GetMiddle(Anope::string_view &token);
+
+	/** Retrieve the next \<trailing> token in the message without copying it.
+	 * @param token The next token available, or an empty view if none remain.
+	 * @return True if a token was retrieved; otherwise, false.
+	 */
+	bool GetTrailing(Anope::string_view &token);
 };
 
 extern CoreExport IRCDProto *IRCD;
@@ -16,6 +16,7 @@
 #include "modules.h"
 #include "serialize.h"
 #include "bots.h"
+#include "access.h"
 
 typedef Anope::hash_map<ChannelInfo *> registered_channel_map;
 
@@ -54,11 +55,30 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	Serialize::Checker<std::vector<ChanAccess *> > access;			/* List of authorized users */
 	Serialize::Checker<std::vector<AutoKick *> > akick;			/* List of users to kickban */
 	Anope::map<int16_t> levels;
+	/* changes whenever levels does, see GetLevelsGeneration */
+	uint64_t levels_generation;
+	/* levels indexed by Privilege::id, and the generations they were compiled at */
+	mutable std::vector<int16_t> compiled_levels;
+	mutable uint64_t compiled_generation, compiled_levels_generation;
 
  public:
 	friend class ChanAccess;
 	friend class AutoKick;
 
+	/* Access entries matched by a user or account, see AccessCache */
+	struct MemoizedAccess
+	{
+		uint64_t generation, user_generation;
+		std::vector<ChanAccess::Path> paths;
+	};
+
+ private:
+	/* Access entries matched by users and accounts */
+	TR1NS::unordered_map<const User *, MemoizedAccess> user_access;
+	TR1NS::unordered_map<const NickCore *, MemoizedAccess> account_access;
+
+ public:
+
 	Anope::string name;                       /* Channel name */
 	Anope::string desc;
 
@@ -135,6 +155,11 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	AccessGroup AccessFor(const User *u, bool updateLastUsed = true);
 	AccessGroup AccessFor(const NickCore *nc, bool updateLastUsed = true);
 
+	/** Forget the access entries memoized for a user, eg when they leave the channel
+	 * @param u The user
+	 */
+	void ForgetAccess(const User *u);
+
 	/** Get the size of the access vector for this channel
 	 * @return The access vector size
 	 */
@@ -208,6 +233,12 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	 * @throws CoreException if priv is not a valid privilege
 	 */
 	int16_t GetLevel(const Anope::string &priv) const;
+	int16_t GetLevel(const Privilege &priv) const;
+
+	/** Get the generation of the channel's levels. It changes whenever
+	 * the levels do, and is never shared with another channel.
+	 */
+	uint64_t GetLevelsGeneration() const { return this->levels_generation; }
 
 	/** Set the level for a privilege
 	 * @param priv The privilege priv
@@ -32,15 +32,77 @@ namespace Serialize
 
 		virtual std::iostream& operator[](const Anope::string &key) = 0;
 		virtual std::set<Anope::string> KeySet() const { throw CoreException("Not supported"); }
-		virtual size_t Hash() const { throw CoreException("Not supported"); }
 
 		virtual void SetType(const Anope::string &key, Type t) { }
 		virtual Type GetType(const Anope::string &key) const { return DT_TEXT; }
+
+		/* Typed access to values. These default to going through operator[], and are
+		 * overridden by backends that can store and read values without a stream.
+		 * Setting a value does not change the type of its key, use SetType for that.
+		 */
+		virtual void SetString(const Anope::string &key, const Anope::string_view &value) { (*this)[key] << value; }
+		virtual void SetInt(const Anope::string &key, int64_t value) { (*this)[key] << value; }
+		virtual void SetUInt(const Anope::string &key, uint64_t value) { (*this)[key] << value; }
+
+		virtual Anope::string GetString(const Anope::string &key)
+		{
+			Anope::string value;
+			(*this)[key] >> value;
+			return value;
+		}
+
+		/** Get an integer
+		 * @param key The key
+		 * @param def What to return if the key has no value. A value that is not a number gives 0
+		 */
+		virtual int64_t GetInt(const Anope::string &key, int64_t def = 0)
+		{
+			int64_t value = def;
+			(*this)[key] >> value;
+			return value;
+		}
+
+		virtual uint64_t GetUInt(const Anope::string &key, uint64_t def = 0)
+		{
+			uint64_t value = def;
+			(*this)[key] >> value;
+			return value;
+		}
 	};
 
 	extern void RegisterTypes();
 	extern void CheckTypes();
 
+	/** Tell the database modules about every object that has changed since
+	 * the last call. This is called once per iteration of the main loop, so
+	 * an object is only written once however many times it changed.
+	 */
+	extern void FlushUpdates();
+
+	/** How often the database modules were told about changed objects and asked to
+	 * check types, and how often that was skipped. An update is skipped if the object
+	 * is already waiting to be announced, and a check if the type was already checked
+	 * this loop iteration. Both are skipped if no module is listening.
+	 */
+	struct CoreExport Counters
+	{
+		static unsigned long updates, updates_suppressed, checks, checks_suppressed;
+	};
+
+	/** Parse an integer the same way extracting one from a stream would: leading
+	 * whitespace is skipped, an empty value gives def, one that is not a number
+	 * gives 0, and one that is out of range gives the nearest limit.
+	 */
+	extern CoreExport int64_t ParseInt(const Anope::string_view &value, int64_t def);
+	extern CoreExport uint64_t ParseUInt(const Anope::string_view &value, uint64_t def);
+
+	/** Format an integer without a stream
+	 * @param buf Somewhere with room for 20 characters
+	 * @return The formatted integer, somewhere in buf
+	 */
+	extern CoreExport Anope::string_view FormatInt(char *buf, int64_t value);
+	extern CoreExport Anope::string_view FormatUInt(char *buf, uint64_t value);
+
 	class Type;
 	template<typename T> class Checker;
 	template<typename T> class Reference;
@@ -64,10 +126,12 @@ class CoreExport Serializable : public virtual Base
 	Serialize::Type *s_type;
 	/* Iterator into serializable_items */
 	std::list<Serializable *>::iterator s_iter;
-	/* The hash of the last serialized form of this object committed to the database */
-	size_t last_commit;
-	/* The last time this object was committed to the database */
-	time_t last_commit_time;
+	/* Objects that have changed since the database modules were last told */
+	static std::list<Serializable *> *DirtyItems;
+	friend void Serialize::FlushUpdates();
+	/* Whether this object is in DirtyItems, and where */
+	bool dirty;
+	std::list<Serializable *>::iterator d_iter;
 
  protected:
 	Serializable(const Anope::string &serialize_type);
@@ -84,15 +148,16 @@ class CoreExport Serializable : public virtual Base
 	/* Only used by redis, to ignore updates */
 	unsigned short redis_ignore;
 
-	/** Marks the object as potentially being updated "soon".
+	/** Marks the object as changed, so the database modules write it out. This
+	 * must be called after changing anything the object serializes. It is cheap,
+	 * the database modules are only told at the end of the main loop iteration.
+	 * Changes made while unserializing objects are not marked.
 	 */
 	void QueueUpdate();
 
-	bool IsCached(Serialize::Data &);
-	void UpdateCache(Serialize::Data &);
-
-	bool IsTSCached();
-	void UpdateTS();
+	/** Check whether the object has changed since the database modules were last told
+	 */
+	bool IsDirty() const { return this->dirty; }
 
 	/** Get the type of serializable object this is
 	 * @return The serializable object type
@@ -129,6 +194,9 @@ class CoreExport Serialize::Type : public Base
 	 */
 	time_t timestamp;
 
+	/* The loop iteration this type was last checked in */
+	unsigned long checked;
+
  public:
 	/* Map of Serializable::id to Serializable objects */
 	std::map<uint64_t, Serializable *> objects;
@@ -155,6 +223,7 @@ class CoreExport Serialize::Type : public Base
 	Serializable *Unserialize(Serializable *obj, Serialize::Data &data);
 
 	/** Check if this object type has any pending changes and update them.
+	 * This only asks the database modules once per loop iteration.
 	 */
 	void Check();
 
@@ -238,7 +307,8 @@ class Serialize::Checker
  * used when holding references to serializable objects for extended periods of time
  * to ensure that the object it refers to it always up to date. This also behaves like
  * Reference in that it will invalidate itself if the object it refers to is
- * destructed.
+ * destructed. Accessing the object through a Reference does not mark it as
+ * changed, call QueueUpdate() on it after changing it.
  */
 template<typename T>
 class Serialize::Reference : public ReferenceBase
@@ -296,9 +366,9 @@ class Serialize::Reference : public ReferenceBase
 	{
 		if (!this->invalid)
 		{
-			if (this->ref)
+			if (this->ref && this->ref->GetSerializableType())
 				// This can invalidate me
-				this->ref->QueueUpdate();
+				this->ref->GetSerializableType()->Check();
 			if (!this->invalid)
 				return this->ref;
 		}
@@ -309,9 +379,9 @@ class Serialize::Reference : public ReferenceBase
 	{
 		if (!this->invalid)
 		{
-			if (this->ref)
+			if (this->ref && this->ref->GetSerializableType())
 				// This can invalidate me
-				this->ref->QueueUpdate();
+				this->ref->GetSerializableType()->Check();
 			if (!this->invalid)
 				return this->ref;
 		}
@@ -322,9 +392,9 @@ class Serialize::Reference : public ReferenceBase
 	{
 		if (!this->invalid)
 		{
-			if (this->ref)
+			if (this->ref && this->ref->GetSerializableType())
 				// This can invalidate me
-				this->ref->QueueUpdate();
+				this->ref->GetSerializableType()->Check();
 			if (!this->invalid)
 				return this->ref;
 		}
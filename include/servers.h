@@ -30,7 +30,7 @@ namespace Servers
 
 	/* Server maps by name and id */
 	extern CoreExport Anope::map<Server *> ByName;
-	extern CoreExport Anope::map<Server *> ByID;
+	extern CoreExport Anope::id_map<Server *> ByID;
 
 	/* CAPAB/PROTOCTL given by the uplink */
 	extern CoreExport std::set<Anope::string> Capab;
@@ -66,6 +66,16 @@ class CoreExport Service : public virtual Base
 		return keys;
 	}
 
+	static std::vector<Anope::string> GetAliasKeys(const Anope::string &t)
+	{
+		std::vector<Anope::string> keys;
+		std::map<Anope::string, std::map<Anope::string, Anope::string> >::iterator it = Aliases.find(t);
+		if (it != Aliases.end())
+			for (std::map<Anope::string, Anope::string>::iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2)
+				keys.push_back(it2->first);
+		return keys;
+	}
+
 	static void AddAlias(const Anope::string &t, const Anope::string &n, const Anope::string &v)
 	{
 		std::map<Anope::string, Anope::string> &smap = Aliases[t];
@@ -22,6 +22,13 @@ class CoreExport SocketEngine
 	/* Map of sockets */
 	static std::map<int, Socket *> Sockets;
 
+	/* Events dispatched and changes made to the kernel's interest list
+	 * (eg. epoll_ctl calls) by the last call to Process()
+	 */
+	static unsigned LastEvents, LastChanges;
+	/* The same, totalled since startup, and the number of calls to Process() */
+	static unsigned long TotalEvents, TotalChanges, TotalLoops;
+
 	/** Called to initialize the socket engine
 	 */
 	static void Init();
@@ -138,6 +138,12 @@ enum SocketFlag
 	SF_CONNECTED,
 	SF_ACCEPTING,
 	SF_ACCEPTED,
+	/* Set by ProcessRead() and ProcessWrite() when there is nothing more to
+	 * read, or no room to write more, until the socket engine is next told
+	 * the socket is ready.
+	 */
+	SF_READ_BLOCKED,
+	SF_WRITE_BLOCKED,
 	SF_SIZE
 };
 
@@ -274,15 +280,80 @@ class CoreExport Socket
 	virtual void ProcessError();
 };
 
+/** Data waiting to be written to a socket, kept in a chain of fixed size
+ * chunks. Appending never moves data that is already queued and sent data
+ * is released a chunk at a time, so queueing a large burst and draining it
+ * with partial writes is linear in the amount of data.
+ */
+class CoreExport SendQueue
+{
+ public:
+	static const size_t ChunkSize = 16384;
+
+ private:
+	struct Chunk
+	{
+		char data[ChunkSize];
+		/* Range of data[] not sent yet */
+		size_t start, end;
+	};
+
+	std::deque<Chunk *> chunks;
+	/* The last emptied chunk, kept to avoid reallocating one for every burst */
+	Chunk *spare;
+	size_t length;
+
+	SendQueue(const SendQueue &);
+	SendQueue &operator=(const SendQueue &);
+
+ public:
+	SendQueue();
+	~SendQueue();
+
+	/** Queue data
+	 * @param data The data
+	 * @param len The length of data
+	 */
+	void Append(const char *data, size_t len);
+
+	/** Get a contiguous block of queued data
+	 * @param index Which block to get, 0 being the oldest
+	 * @param len Set to the length of the block
+	 * @return The block, or NULL if there are no more blocks
+	 */
+	const char *GetBlock(size_t index, size_t &len) const;
+
+	/** Release data from the front of the queue after it has been sent
+	 * @param len How much was sent
+	 */
+	void Consume(size_t len);
+
+	/** Send as much of the queue as possible
+	 * @param s The socket to send to, using its SocketIO
+	 * @return The number of bytes sent, or the return value of a failed send
+	 */
+	int Flush(Socket *s);
+
+	inline bool empty() const { return this->length == 0; }
+	inline size_t size() const { return this->length; }
+};
+
 class CoreExport BufferedSocket : public virtual Socket
 {
  protected:
-	/* Things read from the socket */
-	Anope::string read_buffer;
+	/* Things read from the socket. Lines are handed out from read_offset
+	 * without moving the data, and the consumed part of the buffer is only
+	 * reclaimed when it is more than half of it.
+	 */
+	std::vector<char> read_buffer;
+	/* Start of the data not yet consumed, and end of the data received */
+	size_t read_offset, read_end;
 	/* Things to be written to the socket */
-	Anope::string write_buffer;
+	SendQueue write_buffer;
 	/* How much data was received from this socket on this recv() */
 	int recv_len;
+	/* If more than this much is queued Write() sends immediately, 0 to disable */
+	size_t write_high_water;
 
  public:
 	BufferedSocket();
@@ -302,6 +373,20 @@ class CoreExport BufferedSocket : public virtual Socket
 	 */
 	const Anope::string GetLine();
 
+	/** Gets the next line from the input buffer without copying it
+	 * @param line Set to the line, without its line ending. It is only valid
+	 * until the socket next reads.
+	 * @return true if a line was found
+	 */
+	bool GetLine(Anope::string_view &line);
+
+	/** Gets every complete line in the input buffer without copying them
+	 * @param lines The lines are appended to this. They are only valid until
+	 * the socket next reads.
+	 * @return The number of lines found
+	 */
+	size_t ReadLines(std::vector<Anope::string_view> &lines);
+
 	/** Write to the socket
 	* @param message The message
 	*/
@@ -320,23 +405,27 @@ class CoreExport BufferedSocket : public virtual Socket
 	 * @return The length of the write buffer
 	 */
 	int WriteBufferLen() const;
+
+	/** Set the write buffer high-water mark. Once more than this is queued,
+	 * Write() tries to send the data right away instead of waiting for the
+	 * socket engine to report the socket writable.
+	 * @param len The high-water mark, 0 to disable
+	 */
+	void SetWriteHighWater(size_t len);
+
+	/** Check whether the write buffer is above its high-water mark, eg.
+	 * because the remote end is not reading fast enough.
+	 */
+	bool IsWriteBufferFull() const;
 };
 
 class CoreExport BinarySocket : public virtual Socket
 {
  protected:
-	struct DataBlock
-	{
-		char *orig;
-		char *buf;
-		size_t len;
-
-		DataBlock(const char *b, size_t l);
-		~DataBlock();
-	};
-
 	/* Data to be written out */
-	std::deque<DataBlock *> write_buffer;
+	SendQueue write_buffer;
+	/* If more than this much is queued Write() sends immediately, 0 to disable */
+	size_t write_high_water;
 
  public:
 	BinarySocket();
@@ -366,6 +455,17 @@ class CoreExport BinarySocket : public virtual Socket
 	 * @return true to continue reading, false to drop the socket
 	 */
 	virtual bool Read(const char *buffer, size_t l);
+
+	/** Set the write buffer high-water mark. Once more than this is queued,
+	 * Write() tries to send the data right away instead of waiting for the
+	 * socket engine to report the socket writable.
+	 * @param len The high-water mark, 0 to disable
+	 */
+	void SetWriteHighWater(size_t len);
+
+	/** Check whether the write buffer is above its high-water mark
+	 */
+	bool IsWriteBufferFull() const;
 };
 
 class CoreExport ListenSocket : public virtual Socket
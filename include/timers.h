@@ -14,9 +14,32 @@
 
 #include "anope.h"
 
+class Timer;
+
+/** Links a timer into a slot of the timer wheel. Slots are circular lists
+ * headed by a link without a timer, so timers can be removed in constant time.
+ */
+struct TimerLink
+{
+	TimerLink *prev, *next;
+	Timer *timer;
+
+	TimerLink(Timer *t = NULL) : timer(t) { prev = next = this; }
+};
+
 class CoreExport Timer
 {
+	friend class TimerManager;
+
  private:
+	/** Where this timer is in the timer wheel
+	 */
+	TimerLink link;
+
+	/** When this timer triggers, in milliseconds on TimerManager's clock
+	 */
+	uint64_t deadline;
+
 	/** The owner of the timer, if any
 	 */
 	Module *owner;
@@ -62,11 +85,23 @@ class CoreExport Timer
 	 */
 	void SetTimer(time_t t);
 
+	/** Set the timer to trigger a number of milliseconds from now, for
+	 * timers which need to trigger sooner or more precisely than a whole
+	 * second. Repeating timers still repeat every GetSecs() seconds.
+	 * @param ms The number of milliseconds from now
+	 */
+	void SetDelay(uint64_t ms);
+
 	/** Retrieve the triggering time
 	 * @return The trigger time
 	 */
 	time_t GetTimer() const;
 
+	/** Retrieve when the timer triggers on TimerManager's clock
+	 * @return The deadline in milliseconds
+	 */
+	uint64_t GetDeadline() const;
+
 	/** Returns true if the timer is set to repeat
 	 * @return Returns true if the timer is set to repeat
 	 */
@@ -101,13 +136,25 @@ class CoreExport Timer
 /** This class manages sets of Timers, and triggers them at their defined times.
  * This will ensure timers are not missed, as well as removing timers that have
  * expired and allowing the addition of new ones.
+ *
+ * Timers are kept in a hierarchical timing wheel with a resolution of one
+ * millisecond, so adding and removing a timer takes constant time regardless
+ * of how many there are.
  */
 class CoreExport TimerManager
 {
-	/** A list of timers
-	 */
-	static std::multimap<time_t, Timer *> Timers;
  public:
+	/** Get the time on the monotonic clock timers are scheduled with
+	 * @return The time in milliseconds
+	 */
+	static uint64_t Now();
+
+	/** Get how long until the next timer is due, for the socket engine to wait
+	 * @param max The most to return, in milliseconds
+	 * @return The time in milliseconds
+	 */
+	static long GetTimeout(long max);
+
 	/** Add a timer to the list
 	 * @param t A Timer derived class to add
 	 */
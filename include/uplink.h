@@ -23,6 +23,9 @@ namespace Uplink
 /* This is the socket to our uplink */
 class UplinkSocket : public ConnectionSocket, public BufferedSocket
 {
+	/* Lines received by the last read, reused to avoid reallocating it */
+	std::vector<Anope::string_view> lines;
+
  public:
 	bool error;
 	UplinkSocket();
@@ -22,7 +22,8 @@
 
 typedef Anope::hash_map<User *> user_map;
 
-extern CoreExport user_map UserListByNick, UserListByUID;
+extern CoreExport user_map UserListByNick;
+extern CoreExport Anope::id_map<User *> UserListByUID;
 
 extern CoreExport int OperCount;
 extern CoreExport unsigned MaxUserCount;
@@ -79,6 +80,10 @@ class CoreExport User : public virtual Base, public Extensible, public CommandRe
 	time_t timestamp;
 	/* Is the user as super admin? */
 	bool super_admin;
+	/* Changes whenever the nick, account or displayed mask access lists match
+	 * this user on changes, see AccessCache
+	 */
+	uint64_t access_generation;
 
 	/* Channels the user is in */
 	typedef std::map<Channel *, ChanUserContainer *> ChanUserList;
@@ -17,7 +17,8 @@
 class CoreExport XLine : public Serializable
 {
 	void Init();
-	Anope::string nick, user, host, real;
+	/* The parts of the mask, and the whole mask, compiled for matching */
+	Anope::CompiledMask nick, user, host, real, compiled_mask;
  public:
 	cidr *c;
 	Anope::string mask;
@@ -39,6 +40,13 @@ class CoreExport XLine : public Serializable
 	const Anope::string &GetHost() const;
 	const Anope::string &GetReal() const;
 
+	/* The above and the whole mask compiled for matching */
+	const Anope::CompiledMask &GetCompiledNick() const { return nick; }
+	const Anope::CompiledMask &GetCompiledUser() const { return user; }
+	const Anope::CompiledMask &GetCompiledHost() const { return host; }
+	const Anope::CompiledMask &GetCompiledReal() const { return real; }
+	const Anope::CompiledMask &GetCompiledMask() const { return compiled_mask; }
+
 	Anope::string GetReason() const;
 
 	bool HasNickOrReal() const;
@@ -48,12 +56,16 @@ class CoreExport XLine : public Serializable
 	static Serializable* Unserialize(Serializable *obj, Serialize::Data &data);
 };
 
+class XLineIndex;
+
 /* Managers XLines. There is one XLineManager per type of XLine. */
 class CoreExport XLineManager : public Service
 {
 	char type;
 	/* List of XLines in this XLineManager */
 	Serialize::Checker<std::vector<XLine *> > xlines;
+	/* Index of the XLines, used by CheckAllXLines to only check users against XLines which may match them */
+	XLineIndex *xline_index;
 	/* Akills can have the same IDs, sometimes */
 	static Serialize::Checker<std::multimap<Anope::string, XLine *, ci::less> > XLinesByUID;
  public:
@@ -112,6 +124,11 @@ class CoreExport XLineManager : public Service
 	 */
 	void AddXLine(XLine *x);
 
+	/** Re-index an entry after its mask or expiry has been changed in place
+	 * @param x The entry
+	 */
+	void UpdateXLine(XLine *x);
+
 	void RemoveXLine(XLine *);
 
 	/** Delete an entry from this XLineManager
@@ -131,6 +148,12 @@ class CoreExport XLineManager : public Service
 	 */
 	void Clear();
 
+	/** Free the regexes the XLine indexes have compiled from the regex
+	 * XLines of every XLineManager, as the module which compiled them may be
+	 * going away. They are compiled again when next needed.
+	 */
+	static void DropRegexes();
+
 	/** Checks if a mask can/should be added to the XLineManager
 	 * @param source The source adding the mask.
 	 * @param mask The mask
@@ -158,6 +181,33 @@ class CoreExport XLineManager : public Service
 	 */
 	virtual bool Check(User *u, const XLine *x) = 0;
 
+	/** Get the mask an xline is indexed by. Literal masks, CIDR ranges and
+	 * masks of the form *.suffix or prefix.* are indexed, anything else is
+	 * checked against every user. By default nothing is indexed.
+	 * @param x The xline
+	 * @param mask Set to the mask
+	 * @return false if the xline should be checked against every user
+	 */
+	virtual bool GetIndexMask(const XLine *x, Anope::string &mask);
+
+	/** Get the strings of a user the masks given by GetIndexMask are matched
+	 * against. Check() is only called for indexed xlines whose mask matches
+	 * one of them, so they must cover everything Check() could match.
+	 * @param u The user
+	 * @param keys Filled with the strings
+	 * @return The IP CIDR ranges are matched against, or NULL
+	 */
+	virtual const sockaddrs *GetIndexKeys(User *u, std::vector<Anope::string> &keys);
+
+	/** Get the strings of a user regex xlines are matched against. Regex
+	 * xlines are matched against all of them at once, and Check() is only
+	 * called for those in a group which matched one of them. By default
+	 * there are none, and Check() is called for every regex xline.
+	 * @param u The user
+	 * @param keys Filled with the strings
+	 */
+	virtual void GetRegexKeys(User *u, std::vector<Anope::string> &keys);
+
 	/** Called when a user matches a xline in this XLineManager
 	 * @param u The user
 	 * @param x The XLine they match
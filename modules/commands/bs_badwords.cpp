@@ -27,13 +27,166 @@ struct BadWordImpl : BadWord, Serializable
 	static Serializable* Unserialize(Serializable *obj, Serialize::Data &);
 };
 
+/* An Aho-Corasick automaton of the badwords of a channel, used to find
+ * every badword a message contains in one pass over it.
+ */
+class BadWordMatcher
+{
+	struct Node
+	{
+		/* Transitions, sorted by character */
+		std::vector<std::pair<char, unsigned> > next;
+		/* The node of the longest proper suffix of this node which is in the automaton */
+		unsigned fail;
+		/* The nearest node reached through fail which ends a badword, or 0 */
+		unsigned output;
+		/* Length of the text this node represents */
+		size_t depth;
+		/* Indexes of the badwords ending at this node */
+		std::vector<unsigned> words;
+
+		Node(size_t d) : fail(0), output(0), depth(d) { }
+	};
+
+	std::vector<Node> nodes;
+	bool casesensitive;
+
+	char Fold(char c) const
+	{
+		return casesensitive ? c : Anope::tolower(c);
+	}
+
+	unsigned Next(unsigned node, char c) const
+	{
+		const std::vector<std::pair<char, unsigned> > &next = nodes[node].next;
+		std::vector<std::pair<char, unsigned> >::const_iterator it = std::lower_bound(next.begin(), next.end(), std::make_pair(c, 0U));
+		return it != next.end() && it->first == c ? it->second : 0;
+	}
+
+ public:
+	BadWordMatcher() : casesensitive(false) { }
+
+	bool IsCaseSensitive() const { return casesensitive; }
+
+	template<typename T> void Build(const std::vector<T *> &badwords, bool cs)
+	{
+		casesensitive = cs;
+		nodes.clear();
+		nodes.push_back(Node(0));
+
+		for (unsigned i = 0; i < badwords.size(); ++i)
+		{
+			const Anope::string &word = badwords[i]->word;
+			if (word.empty())
+				continue;
+
+			unsigned node = 0;
+			for (size_t j = 0; j < word.length(); ++j)
+			{
+				char c = Fold(word[j]);
+				unsigned n = Next(node, c);
+				if (!n)
+				{
+					n = nodes.size();
+					std::vector<std::pair<char, unsigned> > &next = nodes[node].next;
+					next.insert(std::lower_bound(next.begin(), next.end(), std::make_pair(c, 0U)), std::make_pair(c, n));
+					nodes.push_back(Node(j + 1));
+				}
+				node = n;
+			}
+			nodes[node].words.push_back(i);
+		}
+
+		/* Nodes are linked breadth first, so the fail node of a node's parent is always linked first */
+		std::deque<unsigned> queue;
+		queue.push_back(0);
+		while (!queue.empty())
+		{
+			unsigned node = queue.front();
+			queue.pop_front();
+
+			for (unsigned i = 0; i < nodes[node].next.size(); ++i)
+			{
+				char c = nodes[node].next[i].first;
+				unsigned child = nodes[node].next[i].second, fail = 0;
+
+				if (node)
+				{
+					fail = nodes[node].fail;
+					while (fail && !Next(fail, c))
+						fail = nodes[fail].fail;
+					fail = Next(fail, c);
+				}
+
+				nodes[child].fail = fail;
+				nodes[child].output = nodes[fail].words.empty() ? nodes[fail].output : fail;
+				queue.push_back(child);
+			}
+		}
+	}
+
+	/** Find the first badword of the list the automaton was built from a message contains
+	 * @return The index of the badword, or -1
+	 */
+	template<typename T> int Find(const std::vector<T *> &badwords, const Anope::string &text) const
+	{
+		int found = -1;
+		size_t len = text.length();
+
+		for (size_t i = 0, node = 0; i < len && found != 0; ++i)
+		{
+			char c = Fold(text[i]);
+			while (node && !Next(node, c))
+				node = nodes[node].fail;
+			node = Next(node, c);
+
+			for (unsigned n = nodes[node].words.empty() ? nodes[node].output : node; n; n = nodes[n].output)
+			{
+				size_t start = i + 1 - nodes[n].depth, end = i + 1;
+				bool word_start = !start || text[start - 1] == ' ', word_end = end == len || text[end] == ' ';
+
+				for (unsigned j = 0; j < nodes[n].words.size(); ++j)
+				{
+					unsigned index = nodes[n].words[j];
+					if (found != -1 && index >= static_cast<unsigned>(found))
+						continue;
+
+					bool matches;
+					switch (badwords[index]->type)
+					{
+						case BW_SINGLE:
+							matches = word_start && word_end;
+							break;
+						case BW_START:
+							matches = word_start;
+							break;
+						case BW_END:
+							matches = word_end;
+							break;
+						default:
+							matches = true;
+					}
+
+					if (matches)
+						found = index;
+				}
+			}
+		}
+
+		return found;
+	}
+};
+
 struct BadWordsImpl : BadWords
 {
 	Serialize::Reference<ChannelInfo> ci;
 	typedef std::vector<BadWordImpl *> list;
 	Serialize::Checker<list> badwords;
+	BadWordMatcher matcher;
+	/* Whether the list has changed since the matcher was built */
+	bool dirty;
 
-	BadWordsImpl(Extensible *obj) : ci(anope_dynamic_static_cast<ChannelInfo *>(obj)), badwords("BadWord") { }
+	BadWordsImpl(Extensible *obj) : ci(anope_dynamic_static_cast<ChannelInfo *>(obj)), badwords("BadWord"), dirty(true) { }
 
 	~BadWordsImpl();
 
@@ -45,6 +198,7 @@ struct BadWordsImpl : BadWords
 		bw->type = type;
 
 		this->badwords->push_back(bw);
+		this->dirty = true;
 
 		FOREACH_MOD(OnBadWordAdd, (ci, bw));
 
@@ -56,9 +210,7 @@ struct BadWordsImpl : BadWords
 		if (this->badwords->empty() || index >= this->badwords->size())
 			return NULL;
 
-		BadWordImpl *bw = (*this->badwords)[index];
-		bw->QueueUpdate();
-		return bw;
+		return (*this->badwords)[index];
 	}
 
 	unsigned GetBadWordCount() const anope_override
@@ -82,6 +234,20 @@ struct BadWordsImpl : BadWords
 			delete this->badwords->back();
 	}
 
+	BadWord* FindBadWord(const Anope::string &text, bool casesensitive) anope_override
+	{
+		/* Fetching the list first, as that may update it */
+		const list &words = *this->badwords;
+		if (this->dirty || this->matcher.IsCaseSensitive() != casesensitive)
+		{
+			this->matcher.Build(words, casesensitive);
+			this->dirty = false;
+		}
+
+		int index = this->matcher.Find(words, text);
+		return index != -1 ? words[index] : NULL;
+	}
+
 	void Check() anope_override
 	{
 		if (this->badwords->empty())
@@ -109,7 +275,10 @@ BadWordImpl::~BadWordImpl()
 		{
 			BadWordsImpl::list::iterator it = std::find(badwords->badwords->begin(), badwords->badwords->end(), this);
 			if (it != badwords->badwords->end())
+			{
 				badwords->badwords->erase(it);
+				badwords->dirty = true;
+			}
 		}
 	}
 }
@@ -140,6 +309,7 @@ Serializable* BadWordImpl::Unserialize(Serializable *obj, Serialize::Data &data)
 	BadWordsImpl *bws = ci->Require<BadWordsImpl>("badwords");
 	if (!obj)
 		bws->badwords->push_back(bw);
+	bws->dirty = true;
 
 	return bw;
 }
@@ -31,6 +31,9 @@ struct KickerDataImpl : KickerData
 
 	void Check(ChannelInfo *ci) anope_override
 	{
+		/* Called after every change, and the settings are saved with the channel */
+		ci->QueueUpdate();
+
 		if (amsgs || badwords || bolds || caps || colors || flood || italics || repeat || reverses || underlines || dontkickops || dontkickvoices)
 			return;
 
@@ -966,25 +969,136 @@ struct BanData
 
 struct UserData
 {
-	UserData(Extensible *)
+	User *user;
+
+	/* for flood kicker, the lines sent in the floodsecs long window starting
+	 * at last_start and in the window before it
+	 */
+	time_t last_start;
+	int16_t lines, prev_lines;
+
+	/* for repeat kicker, case insensitive hashes of the last message and
+	 * where it was sent, or 0
+	 */
+	size_t lastline, lasttarget;
+	int16_t times;
+};
+
+/* The UserData of everyone who has talked in a channel, in an open
+ * addressed table keyed by user. Entries are removed when users leave.
+ */
+class UserDataTable
+{
+	std::vector<UserData> slots;
+	size_t count;
+
+	static size_t Hash(const User *u)
+	{
+		return (reinterpret_cast<size_t>(u) >> 4) * 2654435761U;
+	}
+
+	size_t Slot(const User *u) const
 	{
-		last_use = last_start = Anope::CurTime;
-		lines = times = 0;
-		lastline.clear();
+		size_t mask = slots.size() - 1;
+		for (size_t i = Hash(u) & mask;; i = (i + 1) & mask)
+			if (slots[i].user == u || slots[i].user == NULL)
+				return i;
 	}
 
-	/* Data validity */
-	time_t last_use;
+	void Rehash(size_t size)
+	{
+		std::vector<UserData> old(size);
+		old.swap(slots);
+		for (size_t i = 0; i < old.size(); ++i)
+			if (old[i].user)
+				slots[Slot(old[i].user)] = old[i];
+	}
 
-	/* for flood kicker */
-	int16_t lines;
-	time_t last_start;
+ public:
+	UserDataTable(Extensible *) : slots(8), count(0) { }
 
-	/* for repeat kicker */
-	Anope::string lasttarget;
-	int16_t times;
+	bool empty() const { return !count; }
+
+	UserData *Require(User *u)
+	{
+		if ((count + 1) * 4 > slots.size() * 3)
+			Rehash(slots.size() * 2);
+
+		UserData &ud = slots[Slot(u)];
+		if (ud.user == NULL)
+		{
+			ud.user = u;
+			ud.last_start = Anope::CurTime;
+			ud.lines = ud.prev_lines = 0;
+			ud.lastline = ud.lasttarget = 0;
+			ud.times = 0;
+			++count;
+		}
+		return &ud;
+	}
+
+	void Erase(User *u)
+	{
+		size_t mask = slots.size() - 1, i = Slot(u);
+		if (slots[i].user == NULL)
+			return;
+
+		/* Move back the entries after it which would no longer be found */
+		for (size_t j = (i + 1) & mask; slots[j].user; j = (j + 1) & mask)
+		{
+			size_t home = Hash(slots[j].user) & mask;
+			if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j))
+			{
+				slots[i] = slots[j];
+				i = j;
+			}
+		}
+
+		slots[i].user = NULL;
+		--count;
+
+		if (slots.size() > 8 && count * 8 < slots.size())
+			Rehash(slots.size() / 2);
+	}
+};
+
+/* Everything the kickers look at in a message, gathered in one pass over it */
+struct MessageInfo
+{
+	/* Control codes removed by Anope::NormalizeBuffer */
+	static const uint32_t StrippedCodes = (1U << 1) | (1U << 2) | (1U << 3) | (1U << 10) | (1U << 13) | (1U << 22) | (1U << 29) | (1U << 31);
+
+	/* Number of upper and lower case letters */
+	unsigned upper, lower;
+	/* Bit n is set if the message contains the control code n */
+	uint32_t codes;
+
+	MessageInfo(const Anope::string &msg) : upper(0), lower(0), codes(0)
+	{
+		static unsigned char classes[256];
+		static bool init = false;
+		if (!init)
+		{
+			for (unsigned i = 0; i < 256; ++i)
+				classes[i] = (isupper(i) ? 1 : 0) | (islower(i) ? 2 : 0);
+			init = true;
+		}
 
-	Anope::string lastline;
+		const unsigned char *p = reinterpret_cast<const unsigned char *>(msg.data());
+		for (size_t i = 0, len = msg.length(); i < len; ++i)
+		{
+			unsigned char c = p[i], cls = classes[c];
+			upper += cls & 1;
+			lower += cls >> 1;
+			if (c < 32)
+				codes |= 1U << c;
+		}
+	}
+
+	bool Has(char code) const
+	{
+		return codes & (1U << code);
+	}
 };
 
 class BanDataPurger : public Timer
@@ -1014,7 +1128,7 @@ class BanDataPurger : public Timer
 class BSKick : public Module
 {
 	ExtensibleItem<BanData> bandata;
-	ExtensibleItem<UserData> userdata;
+	ExtensibleItem<UserDataTable> userdata;
 	KickerDataImpl::ExtensibleItem kickerdata;
 
 	CommandBSKick commandbskick;
@@ -1042,13 +1156,11 @@ class BSKick : public Module
 
 	UserData *GetUserData(User *u, Channel *c)
 	{
-		ChanUserContainer *uc = c->FindUser(u);
-		if (uc == NULL)
+		if (c->FindUser(u) == NULL)
 			return NULL;
 
-		UserData *ud = userdata.Require(uc);
-		return ud;
-       }
+		return userdata.Require(c)->Require(u);
+	}
 
 	void check_ban(ChannelInfo *ci, User *u, KickerData *kd, int ttbtype)
 	{
@@ -1224,6 +1336,17 @@ class BSKick : public Module
 			info.AddOption(_("Voices protection"));
 	}
 
+	void OnLeaveChannel(User *u, Channel *c) anope_override
+	{
+		UserDataTable *table = userdata.Get(c);
+		if (table)
+		{
+			table->Erase(u);
+			if (table->empty())
+				userdata.Unset(c);
+		}
+	}
+
 	void OnPrivmsg(User *u, Channel *c, Anope::string &msg) anope_override
 	{
 		/* Now we can make kicker stuff. We try to order the checks
@@ -1262,8 +1385,10 @@ class BSKick : public Module
 		if (realbuf.empty())
 			return;
 
+		MessageInfo info(realbuf);
+
 		/* Bolds kicker */
-		if (kd->bolds && realbuf.find(2) != Anope::string::npos)
+		if (kd->bolds && info.Has(2))
 		{
 			check_ban(ci, u, kd, TTB_BOLDS);
 			bot_kick(ci, u, _("Don't use bolds on this channel!"));
@@ -1271,7 +1396,7 @@ class BSKick : public Module
 		}
 
 		/* Color kicker */
-		if (kd->colors && realbuf.find(3) != Anope::string::npos)
+		if (kd->colors && info.Has(3))
 		{
 			check_ban(ci, u, kd, TTB_COLORS);
 			bot_kick(ci, u, _("Don't use colors on this channel!"));
@@ -1279,7 +1404,7 @@ class BSKick : public Module
 		}
 
 		/* Reverses kicker */
-		if (kd->reverses && realbuf.find(22) != Anope::string::npos)
+		if (kd->reverses && info.Has(22))
 		{
 			check_ban(ci, u, kd, TTB_REVERSES);
 			bot_kick(ci, u, _("Don't use reverses on this channel!"));
@@ -1287,7 +1412,7 @@ class BSKick : public Module
 		}
 
 		/* Italics kicker */
-		if (kd->italics && realbuf.find(29) != Anope::string::npos)
+		if (kd->italics && info.Has(29))
 		{
 			check_ban(ci, u, kd, TTB_ITALICS);
 			bot_kick(ci, u, _("Don't use italics on this channel!"));
@@ -1295,7 +1420,7 @@ class BSKick : public Module
 		}
 
 		/* Underlines kicker */
-		if (kd->underlines && realbuf.find(31) != Anope::string::npos)
+		if (kd->underlines && info.Has(31))
 		{
 			check_ban(ci, u, kd, TTB_UNDERLINES);
 			bot_kick(ci, u, _("Don't use underlines on this channel!"));
@@ -1305,15 +1430,7 @@ class BSKick : public Module
 		/* Caps kicker */
 		if (kd->caps && realbuf.length() >= static_cast<unsigned>(kd->capsmin))
 		{
-			int i = 0, l = 0;
-
-			for (unsigned j = 0, end = realbuf.length(); j < end; ++j)
-			{
-				if (isupper(realbuf[j]))
-					++i;
-				else if (islower(realbuf[j]))
-					++l;
-			}
+			int i = info.upper, l = info.lower;
 
 			/* i counts uppercase chars, l counts lowercase chars. Only
 			 * alphabetic chars (so islower || isupper) qualify for the
@@ -1331,88 +1448,26 @@ class BSKick : public Module
 		/* Bad words kicker */
 		if (kd->badwords)
 		{
-			bool mustkick = false;
 			BadWords *badwords = ci->GetExt<BadWords>("badwords");
 
-			/* Normalize the buffer */
-			Anope::string nbuf = Anope::NormalizeBuffer(realbuf);
+			/* Normalize the buffer, if there is anything to remove */
+			bool strip = info.codes & MessageInfo::StrippedCodes;
+			Anope::string normalized = strip ? Anope::NormalizeBuffer(realbuf) : "";
+			const Anope::string &nbuf = strip ? normalized : realbuf;
 			bool casesensitive = Config->GetModule("botserv")->Get<bool>("casesensitive");
 
 			/* Normalize can return an empty string if this only contains control codes etc */
-			if (badwords && !nbuf.empty())
-				for (unsigned i = 0; i < badwords->GetBadWordCount(); ++i)
-				{
-					const BadWord *bw = badwords->GetBadWord(i);
-
-					if (bw->word.empty())
-						continue; // Shouldn't happen
-
-					if (bw->word.length() > nbuf.length())
-						continue; // This can't ever match
-
-					if (bw->type == BW_ANY && ((casesensitive && nbuf.find(bw->word) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(bw->word) != Anope::string::npos)))
-						mustkick = true;
-					else if (bw->type == BW_SINGLE)
-					{
-						size_t len = bw->word.length();
-
-						if ((casesensitive && bw->word.equals_cs(nbuf)) || (!casesensitive && bw->word.equals_ci(nbuf)))
-							mustkick = true;
-						else if (nbuf.find(' ') == len && ((casesensitive && bw->word.equals_cs(nbuf.substr(0, len))) || (!casesensitive && bw->word.equals_ci(nbuf.substr(0, len)))))
-							mustkick = true;
-						else
-						{
-							if (len < nbuf.length() && nbuf.rfind(' ') == nbuf.length() - len - 1 && ((casesensitive && nbuf.find(bw->word) == nbuf.length() - len) || (!casesensitive && nbuf.find_ci(bw->word) == nbuf.length() - len)))
-								mustkick = true;
-							else
-							{
-								Anope::string wordbuf = " " + bw->word + " ";
-
-								if ((casesensitive && nbuf.find(wordbuf) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(wordbuf) != Anope::string::npos))
-									mustkick = true;
-							}
-						}
-					}
-					else if (bw->type == BW_START)
-					{
-						size_t len = bw->word.length();
-
-						if ((casesensitive && nbuf.substr(0, len).equals_cs(bw->word)) || (!casesensitive && nbuf.substr(0, len).equals_ci(bw->word)))
-							mustkick = true;
-						else
-						{
-							Anope::string wordbuf = " " + bw->word;
-
-							if ((casesensitive && nbuf.find(wordbuf) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(wordbuf) != Anope::string::npos))
-								mustkick = true;
-						}
-					}
-					else if (bw->type == BW_END)
-					{
-						size_t len = bw->word.length();
-
-						if ((casesensitive && nbuf.substr(nbuf.length() - len).equals_cs(bw->word)) || (!casesensitive && nbuf.substr(nbuf.length() - len).equals_ci(bw->word)))
-							mustkick = true;
-						else
-						{
-							Anope::string wordbuf = bw->word + " ";
-
-							if ((casesensitive && nbuf.find(wordbuf) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(wordbuf) != Anope::string::npos))
-								mustkick = true;
-						}
-					}
-
-					if (mustkick)
-					{
-						check_ban(ci, u, kd, TTB_BADWORDS);
-						if (Config->GetModule(me)->Get<bool>("gentlebadwordreason"))
-							bot_kick(ci, u, _("Watch your language!"));
-						else
-							bot_kick(ci, u, _("Don't use the word \"%s\" on this channel!"), bw->word.c_str());
+			const BadWord *bw = badwords && !nbuf.empty() ? badwords->FindBadWord(nbuf, casesensitive) : NULL;
+			if (bw)
+			{
+				check_ban(ci, u, kd, TTB_BADWORDS);
+				if (Config->GetModule(me)->Get<bool>("gentlebadwordreason"))
+					bot_kick(ci, u, _("Watch your language!"));
+				else
+					bot_kick(ci, u, _("Don't use the word \"%s\" on this channel!"), bw->word.c_str());
 
-						return;
-					}
-				} /* for */
+				return;
+			}
 		} /* if badwords */
 
 		UserData *ud = GetUserData(u, c);
@@ -1422,14 +1477,24 @@ class BSKick : public Module
 			/* Flood kicker */
 			if (kd->flood)
 			{
-				if (Anope::CurTime - ud->last_start > kd->floodsecs)
+				/* Old databases or a low keepdata can leave this at 0, which would kick on every line */
+				time_t floodsecs = std::max<time_t>(kd->floodsecs, 1);
+
+				time_t elapsed = Anope::CurTime - ud->last_start;
+				if (elapsed >= floodsecs)
 				{
-					ud->last_start = Anope::CurTime;
+					/* The window which just ended still overlaps the last floodsecs */
+					bool adjacent = elapsed < 2 * floodsecs;
+					ud->prev_lines = adjacent ? ud->lines : 0;
+					ud->last_start = adjacent ? ud->last_start + floodsecs : Anope::CurTime;
 					ud->lines = 0;
+					elapsed = Anope::CurTime - ud->last_start;
 				}
 
 				++ud->lines;
-				if (ud->lines >= kd->floodlines)
+
+				/* Lines sent in the last floodsecs, taking the previous window's lines as evenly spread */
+				if (static_cast<time_t>(ud->prev_lines) * (floodsecs - elapsed) + static_cast<time_t>(ud->lines) * floodsecs >= static_cast<time_t>(kd->floodlines) * floodsecs)
 				{
 					check_ban(ci, u, kd, TTB_FLOOD);
 					bot_kick(ci, u, _("Stop flooding!"));
@@ -1437,10 +1502,12 @@ class BSKick : public Module
 				}
 			}
 
+			size_t line = Anope::hash_ci::Hash(realbuf.data(), realbuf.length()), target = Anope::hash_ci()(ci->name);
+
 			/* Repeat kicker */
 			if (kd->repeat)
 			{
-				if (!ud->lastline.equals_ci(realbuf))
+				if (ud->lastline != line)
 					ud->times = 0;
 				else
 					++ud->times;
@@ -1453,7 +1520,13 @@ class BSKick : public Module
 				}
 			}
 
-			if (ud->lastline.equals_ci(realbuf) && !ud->lasttarget.empty() && !ud->lasttarget.equals_ci(ci->name))
+			bool amsg = ud->lastline == line && ud->lasttarget && ud->lasttarget != target;
+
+			/* Kicking may remove ud, so it is updated first */
+			ud->lasttarget = target;
+			ud->lastline = line;
+
+			if (amsg)
 			{
 				for (User::ChanUserList::iterator it = u->chans.begin(); it != u->chans.end();)
 				{
@@ -1467,9 +1540,6 @@ class BSKick : public Module
 					}
 				}
 			}
-
-			ud->lasttarget = ci->name;
-			ud->lastline = realbuf;
 		}
 	}
 };
@@ -131,6 +131,7 @@ class CommandBSSetBanExpire : public Command
 		}
 
 		ci->banexpire = t;
+		ci->QueueUpdate();
 
 		bool override = !access.HasPriv("SET");
 		Log(override ? LOG_OVERRIDE : LOG_COMMAND, source, this, ci) << "to change banexpire to " << ci->banexpire;
@@ -182,11 +183,13 @@ class CommandBSSetPrivate : public Command
 		if (value.equals_ci("ON"))
 		{
 			bi->oper_only = true;
+			bi->QueueUpdate();
 			source.Reply(_("Private mode of bot %s is now \002on\002."), bi->nick.c_str());
 		}
 		else if (value.equals_ci("OFF"))
 		{
 			bi->oper_only = false;
+			bi->QueueUpdate();
 			source.Reply(_("Private mode of bot %s is now \002off\002."), bi->nick.c_str());
 		}
 		else
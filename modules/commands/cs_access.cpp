@@ -897,6 +897,11 @@ class CSAccess : public Module
 		if (group->ci == NULL)
 			return EVENT_CONTINUE;
 
+		/* Special case. Allows a level of -1 to match anyone, and a level of 0 to match anyone identified. */
+		int16_t level = group->ci->GetLevel(priv);
+		if (level != -1 && level != 0)
+			return EVENT_CONTINUE;
+
 		const ChanAccess *highest = group->Highest();
 		if (highest && highest->provider == &accessprovider)
 		{
@@ -909,8 +914,6 @@ class CSAccess : public Module
 				return EVENT_CONTINUE;
 		}
 
-		/* Special case. Allows a level of -1 to match anyone, and a level of 0 to match anyone identified. */
-		int16_t level = group->ci->GetLevel(priv);
 		if (level == -1)
 			return EVENT_ALLOW;
 		else if (level == 0 && group->nc && !group->nc->HasExt("UNCONFIRMED"))
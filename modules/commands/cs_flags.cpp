@@ -498,6 +498,9 @@ class CSFlags : public Module
 
 			defaultFlags[p->name] = value[0];
 		}
+
+		/* Flags entries have to compile their privileges against the new flags */
+		PrivilegeManager::Recompile();
 	}
 };
 
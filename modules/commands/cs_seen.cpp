@@ -454,6 +454,7 @@ class CSSeen : public Module
 		info->nick2 = nick2;
 		info->channel = channel;
 		info->message = message;
+		info->QueueUpdate();
 	}
 };
 
@@ -171,6 +171,7 @@ class CommandCSSetBanType : public Command
 				throw ConvertException("Invalid range");
 			Log(source.AccessFor(ci).HasPriv("SET") ? LOG_COMMAND : LOG_OVERRIDE, source, this, ci) << "to change the ban type to " << new_type;
 			ci->bantype = new_type;
+			ci->QueueUpdate();
 			source.Reply(_("Ban type for channel %s is now #%d."), ci->name.c_str(), ci->bantype);
 		}
 		catch (const ConvertException &)
@@ -235,12 +236,14 @@ class CommandCSSetDescription : public Command
 		if (!param.empty())
 		{
 			ci->desc = param;
+			ci->QueueUpdate();
 			Log(source.AccessFor(ci).HasPriv("SET") ? LOG_COMMAND : LOG_OVERRIDE, source, this, ci) << "to change the description to " << ci->desc;
 			source.Reply(_("Description of %s changed to \002%s\002."), ci->name.c_str(), ci->desc.c_str());
 		}
 		else
 		{
 			ci->desc.clear();
+			ci->QueueUpdate();
 			Log(source.AccessFor(ci).HasPriv("SET") ? LOG_COMMAND : LOG_OVERRIDE, source, this, ci) << "to unset the description";
 			source.Reply(_("Description of %s unset."), ci->name.c_str());
 		}
@@ -1233,7 +1236,12 @@ class CSSet : public Module
 				persist.Set(c->ci, true);
 
 			if (mode->type != MODE_STATUS && !c->syncing && Me->IsSynced() && (!inhabit || !inhabit->HasExt(c)))
+			{
 				c->ci->last_modes = c->GetModes();
+				/* They are only saved with keep modes on */
+				if (keep_modes.HasExt(c->ci))
+					c->ci->QueueUpdate();
+			}
 		}
 
 		return EVENT_CONTINUE;
@@ -1248,7 +1256,11 @@ class CSSet : public Module
 		}
 
 		if (c->ci && mode->type != MODE_STATUS && !c->syncing && Me->IsSynced() && (!inhabit || !inhabit->HasExt(c)))
+		{
 			c->ci->last_modes = c->GetModes();
+			if (keep_modes.HasExt(c->ci))
+				c->ci->QueueUpdate();
+		}
 
 		return EVENT_CONTINUE;
 	}
@@ -135,6 +135,7 @@ class CommandCSTopic : public Command
 		{
 			new_topic = ci->c->topic + " " + topic;
 			ci->last_topic.clear();
+			ci->QueueUpdate();
 		}
 		else
 			new_topic = topic;
@@ -247,6 +248,7 @@ class CSTopic : public Module
 			c->ci->last_topic = c->topic;
 			c->ci->last_topic_setter = c->topic_setter;
 			c->ci->last_topic_time = c->topic_ts;
+			c->ci->QueueUpdate();
 		}
 	}
 
@@ -626,6 +626,9 @@ class CSXOP : public Module
 
 			order.push_back(cname);
 		}
+
+		/* XOP entries have to compile their privileges against the new permissions */
+		PrivilegeManager::Recompile();
 	}
 };
 
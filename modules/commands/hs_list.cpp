@@ -57,6 +57,8 @@ class CommandHSList : public Command
 		ListFormatter list(source.GetAccount());
 		list.AddColumn(_("Number")).AddColumn(_("Nick")).AddColumn(_("Vhost")).AddColumn(_("Creator")).AddColumn(_("Created"));
 
+		const Anope::CompiledMask mask(key);
+
 		for (nickalias_map::const_iterator it = NickAliasList->begin(), it_end = NickAliasList->end(); it != it_end; ++it)
 		{
 			const NickAlias *na = it->second;
@@ -66,7 +68,7 @@ class CommandHSList : public Command
 
 			if (!key.empty() && key[0] != '#')
 			{
-				if ((Anope::Match(na->nick, key) || Anope::Match(na->GetVhostHost(), key)) && display_counter < listmax)
+				if ((mask.Matches(na->nick) || mask.Matches(na->GetVhostHost())) && display_counter < listmax)
 				{
 					++display_counter;
 
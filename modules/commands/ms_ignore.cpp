@@ -44,6 +44,9 @@ class CommandMSIgnore : public Command
 		bool ischan;
 		MemoInfo *mi = MemoInfo::GetMemoInfo(channel, ischan);
 		ChannelInfo *ci = ChannelInfo::Find(channel);
+		/* The ignore list is saved with the channel or account it belongs to */
+		const NickAlias *na = ischan ? NULL : NickAlias::Find(channel);
+		Serializable *target = ischan ? static_cast<Serializable *>(ci) : (na ? static_cast<Serializable *>(na->nc) : NULL);
 		if (!mi)
 			source.Reply(ischan ? CHAN_X_NOT_REGISTERED : _(NICK_X_NOT_REGISTERED), channel.c_str());
 		else if (ischan && !source.AccessFor(ci).HasPriv("MEMO"))
@@ -59,6 +62,7 @@ class CommandMSIgnore : public Command
 			if (std::find(mi->ignores.begin(), mi->ignores.end(), param.ci_str()) == mi->ignores.end())
 			{
 				mi->ignores.push_back(param.ci_str());
+				target->QueueUpdate();
 				source.Reply(_("\002%s\002 added to ignore list."), param.c_str());
 			}
 			else
@@ -71,6 +75,7 @@ class CommandMSIgnore : public Command
 			if (it != mi->ignores.end())
 			{
 				mi->ignores.erase(it);
+				target->QueueUpdate();
 				source.Reply(_("\002%s\002 removed from the ignore list."), param.c_str());
 			}
 			else
@@ -68,7 +68,10 @@ class CommandMSRSend : public Command
 					throw CoreException("NULL mi in ms_rsend");
 				Memo *m = (mi->memos->size() ? mi->GetMemo(mi->memos->size() - 1) : NULL);
 				if (m != NULL)
+				{
 					m->receipt = true;
+					m->QueueUpdate();
+				}
 			}
 		}
 	}
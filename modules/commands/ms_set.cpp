@@ -177,6 +177,10 @@ class CommandMSSet : public Command
 			}
 		}
 		mi->memomax = limit;
+		if (ci)
+			ci->QueueUpdate();
+		else
+			nc->QueueUpdate();
 		if (limit > 0)
 		{
 			if (chan.empty() && nc == source.nc)
@@ -400,6 +400,15 @@ class NSAJoin : public Module
 			IRCD->SendSVSJoin(NickServ, u, entry->channel, key);
 		}
 	}
+
+	void OnChangeCoreDisplay(NickCore *nc, const Anope::string &newdisplay) anope_override
+	{
+		/* Entries are saved with the display of their owner */
+		AJoinList *channels = ajoinlist.Get(nc);
+		if (channels)
+			for (unsigned i = 0; i < (*channels)->size(); ++i)
+				(*channels)->at(i)->QueueUpdate();
+	}
 };
 
 MODULE_INIT(NSAJoin)
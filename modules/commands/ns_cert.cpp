@@ -50,6 +50,7 @@ struct NSCertListImpl : NSCertList
 	{
 		this->certs.push_back(entry);
 		certmap[entry] = nc;
+		nc->QueueUpdate();
 		FOREACH_MOD(OnNickAddCert, (this->nc, entry));
 	}
 
@@ -98,6 +99,7 @@ struct NSCertListImpl : NSCertList
 			FOREACH_MOD(OnNickEraseCert, (this->nc, entry));
 			certmap.erase(entry);
 			this->certs.erase(it);
+			nc->QueueUpdate();
 		}
 	}
 
@@ -31,11 +31,13 @@ class CommandNSGetEMail : public Command
 
 		Log(LOG_ADMIN, source, this) << "on " << email;
 
+		const Anope::CompiledMask mask(email);
+
 		for (nickcore_map::const_iterator it = NickCoreList->begin(), it_end = NickCoreList->end(); it != it_end; ++it)
 		{
 			const NickCore *nc = it->second;
 
-			if (!nc->email.empty() && Anope::Match(nc->email, email))
+			if (!nc->email.empty() && mask.Matches(nc->email))
 			{
 				++j;
 				source.Reply(_("Email matched: \002%s\002 (\002%s\002) to \002%s\002."), nc->display.c_str(), nc->email.c_str(), email.c_str());
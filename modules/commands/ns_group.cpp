@@ -261,6 +261,7 @@ class CommandNSUngroup : public Command
 
 			NickCore *nc = new NickCore(na->nick);
 			na->nc = nc;
+			na->QueueUpdate();
 			nc->aliases->push_back(na);
 
 			nc->pass = oldcore->pass;
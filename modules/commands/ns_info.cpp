@@ -45,6 +45,7 @@ class CommandNSInfo : public Command
 			{
 				nick_online = true;
 				na->last_seen = Anope::CurTime;
+				na->QueueUpdate();
 			}
 
 			if (has_auspex || na->nc == source.GetAccount())
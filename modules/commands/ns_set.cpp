@@ -147,6 +147,7 @@ class CommandNSSetPassword : public Command
 		Log(LOG_COMMAND, source, this) << "to change their password";
 
 		Anope::Encrypt(param, source.nc->pass);
+		source.nc->QueueUpdate();
 		Anope::string tmp_pass;
 		if (Anope::Decrypt(source.nc->pass, tmp_pass) == 1)
 			source.Reply(_("Password for \002%s\002 changed to \002%s\002."), source.nc->display.c_str(), tmp_pass.c_str());
@@ -213,6 +214,7 @@ class CommandNSSASetPassword : public Command
 		Log(LOG_ADMIN, source, this) << "to change the password of " << nc->display;
 
 		Anope::Encrypt(params[1], nc->pass);
+		nc->QueueUpdate();
 		Anope::string tmp_pass;
 		if (Anope::Decrypt(nc->pass, tmp_pass) == 1)
 			source.Reply(_("Password for \002%s\002 changed to \002%s\002."), nc->display.c_str(), tmp_pass.c_str());
@@ -510,12 +512,14 @@ class CommandNSSetEmail : public Command
 			{
 				Log(nc == source.GetAccount() ? LOG_COMMAND : LOG_ADMIN, source, this) << "to change the email of " << nc->display << " to " << param;
 				nc->email = param;
+				nc->QueueUpdate();
 				source.Reply(_("E-mail address for \002%s\002 changed to \002%s\002."), nc->display.c_str(), param.c_str());
 			}
 			else
 			{
 				Log(nc == source.GetAccount() ? LOG_COMMAND : LOG_ADMIN, source, this) << "to unset the email of " << nc->display;
 				nc->email.clear();
+				nc->QueueUpdate();
 				source.Reply(_("E-mail address for \002%s\002 unset."), nc->display.c_str());
 			}
 		}
@@ -830,6 +834,7 @@ class CommandNSSetLanguage : public Command
 		Log(nc == source.GetAccount() ? LOG_COMMAND : LOG_ADMIN, source, this) << "to change the language of " << nc->display << " to " << param;
 
 		nc->language = param;
+		nc->QueueUpdate();
 		if (source.GetAccount() == nc)
 			source.Reply(_("Language changed to \002English\002."));
 		else
@@ -1270,6 +1275,7 @@ class NSSet : public Module
 				if (params[0] == n->second)
 				{
 					uac->email = n->first;
+					uac->QueueUpdate();
 					Log(LOG_COMMAND, source, command) << "to confirm their email address change to " << uac->email;
 					source.Reply(_("Your email address has been changed to \002%s\002."), uac->email.c_str());
 					ns_set_email.Unset(uac);
@@ -1322,13 +1328,23 @@ class NSSet : public Module
 	void OnUserModeSet(const MessageSource &setter, User *u, const Anope::string &mname) anope_override
 	{
 		if (u->IsIdentified() && setter.GetUser() == u)
+		{
 			u->Account()->last_modes = u->GetModeList();
+			/* Only saved for accounts that keep their modes */
+			if (keep_modes.HasExt(u->Account()))
+				u->Account()->QueueUpdate();
+		}
 	}
 
 	void OnUserModeUnset(const MessageSource &setter, User *u, const Anope::string &mname) anope_override
 	{
 		if (u->IsIdentified() && setter.GetUser() == u)
+		{
 			u->Account()->last_modes = u->GetModeList();
+			/* Only saved for accounts that keep their modes */
+			if (keep_modes.HasExt(u->Account()))
+				u->Account()->QueueUpdate();
+		}
 	}
 
 	void OnUserLogin(User *u) anope_override
@@ -123,6 +123,7 @@ class CommandNSSuspend : public Command
 			if (na2 && *na2->nc == *na->nc)
 			{
 				na2->last_quit = reason;
+				na2->QueueUpdate();
 
 				User *u2 = User::Find(na2->nick, true);
 				if (u2)
@@ -273,6 +274,7 @@ class NSSuspend : public Module
 		if (!Anope::NoExpire && s->expires && s->expires < Anope::CurTime)
 		{
 			na->last_seen = Anope::CurTime;
+			na->QueueUpdate();
 			Expire(na);
 		}
 	}
@@ -29,6 +29,7 @@ class CommandNSUpdate : public Command
 		{
 			na->last_realname = u->realname;
 			na->last_seen = Anope::CurTime;
+			na->QueueUpdate();
 		}
 
 		FOREACH_MOD(OnNickUpdate, (u));
@@ -77,9 +77,7 @@ struct DNSZone : Serializable
 		for (unsigned i = 0; i < zones->size(); ++i)
 			if (zones->at(i)->name.equals_ci(name))
 			{
-				DNSZone *z = zones->at(i);
-				z->QueueUpdate();
-				return z;
+				return zones->at(i);
 			}
 		return NULL;
 	}
@@ -114,14 +112,22 @@ class DNSServer : public Serializable
 	const Anope::string &GetName() const { return server_name; }
 	std::vector<Anope::string> &GetIPs() { return ips; }
 	unsigned GetLimit() const { return limit; }
-	void SetLimit(unsigned l) { limit = l; }
+	void SetLimit(unsigned l)
+	{
+		limit = l;
+		this->QueueUpdate();
+	}
 
 	bool Pooled() const { return pooled; }
 	void Pool(bool p)
 	{
 		if (!p)
 			this->SetActive(p);
-		pooled = p;
+		if (pooled != p)
+		{
+			pooled = p;
+			this->QueueUpdate();
+		}
 	}
 
 	bool Active() const { return pooled && active; }
@@ -196,9 +202,7 @@ class DNSServer : public Serializable
 		for (unsigned i = 0; i < dns_servers->size(); ++i)
 			if (dns_servers->at(i)->GetName().equals_ci(s))
 			{
-				DNSServer *serv = dns_servers->at(i);
-				serv->QueueUpdate();
-				return serv;
+				return dns_servers->at(i);
 			}
 		return NULL;
 	}
@@ -320,7 +324,10 @@ class CommandOSDNS : public Command
 		{
 			DNSServer *s = DNSServer::Find(*it);
 			if (s)
+			{
 				s->zones.erase(z->name);
+				s->QueueUpdate();
+			}
 		}
 
 		if (dnsmanager)
@@ -363,6 +370,8 @@ class CommandOSDNS : public Command
 
 				z->servers.insert(s->GetName());
 				s->zones.insert(zone);
+				z->QueueUpdate();
+				s->QueueUpdate();
 
 				if (dnsmanager)
 				{
@@ -411,6 +420,8 @@ class CommandOSDNS : public Command
 
 			z->servers.insert(s->GetName());
 			s->zones.insert(z->name);
+			z->QueueUpdate();
+			s->QueueUpdate();
 
 			if (dnsmanager)
 			{
@@ -457,6 +468,8 @@ class CommandOSDNS : public Command
 
 			z->servers.erase(s->GetName());
 			s->zones.erase(z->name);
+			z->QueueUpdate();
+			s->QueueUpdate();
 			source.Reply(_("Removed server %s from zone %s."), s->GetName().c_str(), z->name.c_str());
 			return;
 		}
@@ -470,7 +483,10 @@ class CommandOSDNS : public Command
 		{
 			DNSZone *z = DNSZone::Find(*it);
 			if (z)
+			{
 				z->servers.erase(s->GetName());
+				z->QueueUpdate();
+			}
 		}
 
 		if (Anope::ReadOnly)
@@ -512,6 +528,7 @@ class CommandOSDNS : public Command
 			source.Reply(READ_ONLY_MODE);
 
 		s->GetIPs().push_back(params[2]);
+		s->QueueUpdate();
 		source.Reply(_("Added IP %s to %s."), params[2].c_str(), s->GetName().c_str());
 		Log(LOG_ADMIN, source, this) << "to add IP " << params[2] << " to " << s->GetName();
 
@@ -540,6 +557,7 @@ class CommandOSDNS : public Command
 			if (params[2].equals_ci(s->GetIPs()[i]))
 			{
 				s->GetIPs().erase(s->GetIPs().begin() + i);
+				s->QueueUpdate();
 				source.Reply(_("Removed IP %s from %s."), params[2].c_str(), s->GetName().c_str());
 				Log(LOG_ADMIN, source, this) << "to remove IP " << params[2] << " from " << s->GetName();
 
@@ -258,6 +258,8 @@ class CommandOSForbid : public Command
 			d->type = ftype;
 			if (created)
 				this->fs->AddForbid(d);
+			else
+				anope_dynamic_static_cast<ForbidDataImpl *>(d)->QueueUpdate();
 
 			if (Anope::ReadOnly)
 				source.Reply(READ_ONLY_MODE);
@@ -96,6 +96,7 @@ class CommandOSLogSearch : public Command
 
 		const Anope::string &logfile_name = Config->GetModule(this->owner)->Get<const Anope::string>("logname");
 		std::vector<Anope::string> matches;
+		const Anope::CompiledMask wildcard_mask(wildcard ? "*" + search_string + "*" : "");
 		for (int d = days - 1; d >= 0; --d)
 		{
 			Anope::string lf_name = CreateLogName(logfile_name, Anope::CurTime - (d * 86400));
@@ -111,7 +112,7 @@ class CommandOSLogSearch : public Command
 				if (regex)
 					match = Anope::Match(buf, search_string, false, true);
 				else if (wildcard)
-					match = Anope::Match(buf, "*" + search_string + "*");
+					match = wildcard_mask.Matches(buf);
 				else
 					match = buf.find_ci(search_string) != Anope::string::npos;
 
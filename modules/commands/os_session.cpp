@@ -355,6 +355,7 @@ class CommandOSException : public Command
 					if (e->limit != limit)
 					{
 						e->limit = limit;
+						e->QueueUpdate();
 						source.Reply(_("Exception for \002%s\002 has been updated to %d."), mask.c_str(), e->limit);
 					}
 					else
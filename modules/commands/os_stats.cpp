@@ -128,6 +128,7 @@ class CommandOSStats : public Command
 	void DoStatsReset(CommandSource &source)
 	{
 		MaxUserCount = UserListByNick.size();
+		MessageTable::ResetStats();
 		source.Reply(_("Statistics reset."));
 		return;
 	}
@@ -153,9 +154,44 @@ class CommandOSStats : public Command
 		source.Reply(_("Uplink server: %s"), Me->GetLinks().front()->GetName().c_str());
 		source.Reply(_("Uplink capab: %s"), buf.c_str());
 		source.Reply(_("Servers found: %d"), stats_count_servers(Me->GetLinks().front()));
+		source.Reply(_("Socket engine: %lu events and %lu registration changes in %lu loops, %u events and %u changes in the last loop"),
+			SocketEngine::TotalEvents, SocketEngine::TotalChanges, SocketEngine::TotalLoops, SocketEngine::LastEvents, SocketEngine::LastChanges);
 		return;
 	}
 
+	void DoStatsMessages(CommandSource &source)
+	{
+		std::vector<const MessageTable::Stats *> stats;
+		MessageTable::GetStats(stats);
+
+		if (stats.empty())
+		{
+			source.Reply(_("No messages have been received from the uplink."));
+			return;
+		}
+
+		ListFormatter list(source.GetAccount());
+		list.AddColumn(_("Command")).AddColumn(_("Count")).AddColumn(_("Total time")).AddColumn(_("Average"));
+		for (unsigned i = 0; i < stats.size(); ++i)
+		{
+			const MessageTable::Stats *st = stats[i];
+
+			ListFormatter::ListEntry entry;
+			entry["Command"] = st->command.upper();
+			entry["Count"] = stringify(st->hits);
+			entry["Total time"] = stringify(st->time / 1000) + "ms";
+			entry["Average"] = stringify(st->time / st->hits) + "us";
+			list.AddEntry(entry);
+		}
+
+		std::vector<Anope::string> replies;
+		list.Process(replies);
+
+		source.Reply(_("Messages received from the uplink:"));
+		for (unsigned i = 0; i < replies.size(); ++i)
+			source.Reply(replies[i]);
+	}
+
 	template<typename T> void GetHashStats(const T& map, size_t& entries, size_t& buckets, size_t& max_chain)
 	{
 		entries = map.size(), buckets = map.bucket_count(), max_chain = 0;
@@ -171,12 +207,18 @@ class CommandOSStats : public Command
 		GetHashStats(UserListByNick, entries, buckets, max_chain);
 		source.Reply(_("Users (nick): %lu entries, %lu buckets, longest chain is %d"), entries, buckets, max_chain);
 
-		if (!UserListByUID.empty())
+		if (!UserListByUID.GetPacked().empty())
 		{
-			GetHashStats(UserListByUID, entries, buckets, max_chain);
+			GetHashStats(UserListByUID.GetPacked(), entries, buckets, max_chain);
 			source.Reply(_("Users (uid): %lu entries, %lu buckets, longest chain is %d"), entries, buckets, max_chain);
 		}
 
+		if (!UserListByUID.GetOther().empty())
+		{
+			GetHashStats(UserListByUID.GetOther(), entries, buckets, max_chain);
+			source.Reply(_("Users (other ids): %lu entries, %lu buckets, longest chain is %d"), entries, buckets, max_chain);
+		}
+
 		GetHashStats(ChannelList, entries, buckets, max_chain);
 		source.Reply(_("Channels: %lu entries, %lu buckets, longest chain is %d"), entries, buckets, max_chain);
 
@@ -194,6 +236,10 @@ class CommandOSStats : public Command
 			GetHashStats(session_service->GetSessions(), entries, buckets, max_chain);
 			source.Reply(_("Sessions: %lu entries, %lu buckets, longest chain is %d"), entries, buckets, max_chain);
 		}
+
+		source.Reply(_("Channel access lookups: %lu from cache, %lu computed"), AccessCache::hits, AccessCache::misses);
+		source.Reply(_("Database updates: %lu sent, %lu coalesced"), Serialize::Counters::updates, Serialize::Counters::updates_suppressed);
+		source.Reply(_("Database type checks: %lu sent, %lu coalesced"), Serialize::Counters::checks, Serialize::Counters::checks_suppressed);
 	}
 
  public:
@@ -201,7 +247,7 @@ class CommandOSStats : public Command
 		akills("XLineManager", "xlinemanager/sgline"), snlines("XLineManager", "xlinemanager/snline"), sqlines("XLineManager", "xlinemanager/sqline")
 	{
 		this->SetDesc(_("Show status of Services and network"));
-		this->SetSyntax("[AKILL | HASH | UPLINK | UPTIME | ALL | RESET]");
+		this->SetSyntax("[AKILL | HASH | MESSAGES | UPLINK | UPTIME | ALL | RESET]");
 	}
 
 	void Execute(CommandSource &source, const std::vector<Anope::string> &params) anope_override
@@ -219,13 +265,16 @@ class CommandOSStats : public Command
 		if (extra.equals_ci("ALL") || extra.equals_ci("HASH"))
 			this->DoStatsHash(source);
 
+		if (extra.equals_ci("ALL") || extra.equals_ci("MESSAGES"))
+			this->DoStatsMessages(source);
+
 		if (extra.equals_ci("ALL") || extra.equals_ci("UPLINK"))
 			this->DoStatsUplink(source);
 
 		if (extra.empty() || extra.equals_ci("ALL") || extra.equals_ci("UPTIME"))
 			this->DoStatsUptime(source);
 
-		if (!extra.empty() && !extra.equals_ci("ALL") && !extra.equals_ci("AKILL") && !extra.equals_ci("HASH") && !extra.equals_ci("UPLINK") && !extra.equals_ci("UPTIME"))
+		if (!extra.empty() && !extra.equals_ci("ALL") && !extra.equals_ci("AKILL") && !extra.equals_ci("HASH") && !extra.equals_ci("MESSAGES") && !extra.equals_ci("UPLINK") && !extra.equals_ci("UPTIME"))
 			source.Reply(_("Unknown STATS option: \002%s\002"), extra.c_str());
 	}
 
@@ -241,12 +290,19 @@ class CommandOSStats : public Command
 				"AKILL list and the current default expiry time.\n"
 				" \n"
 				"The \002RESET\002 option currently resets the maximum user count\n"
-				"to the number of users currently present on the network.\n"
+				"to the number of users currently present on the network, and\n"
+				"clears the per command counts shown by \002MESSAGES\002.\n"
 				" \n"
 				"The \002UPLINK\002 option displays information about the current\n"
-				"server Anope uses as an uplink to the network.\n"
+				"server Anope uses as an uplink to the network, and how many\n"
+				"events the socket engine has processed.\n"
+				" \n"
+				"The \002HASH\002 option displays information about the hash maps,\n"
+				"how many channel access lookups were answered from cache, and\n"
+				"how many database updates and checks were coalesced.\n"
 				" \n"
-				"The \002HASH\002 option displays information about the hash maps.\n"
+				"The \002MESSAGES\002 option displays how many times each command\n"
+				"was received from the uplink and how long it took to process.\n"
 				" \n"
 				"The \002ALL\002 option displays all of the above statistics."));
 		return true;
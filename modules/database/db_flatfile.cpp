@@ -10,108 +10,1410 @@
  */
 
 #include "module.h"
+#include "modules/db_flatfile.h"
 
 #ifndef _WIN32
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #endif
 
+/* A database file mapped into memory, or read into it where mmap is not available */
+class MappedFile
+{
+#ifdef _WIN32
+	std::string buffer;
+#endif
+ public:
+	const char *data;
+	size_t size;
+
+	MappedFile() : data(NULL), size(0) { }
+
+	~MappedFile()
+	{
+		this->Close();
+	}
+
+	bool Open(const Anope::string &path)
+	{
+		this->Close();
+#ifndef _WIN32
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) < 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		this->data = "";
+		this->size = st.st_size;
+		if (this->size)
+		{
+			void *p = mmap(NULL, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED)
+			{
+				this->size = 0;
+				this->data = NULL;
+				close(fd);
+				return false;
+			}
+			this->data = static_cast<const char *>(p);
+		}
+		close(fd);
+#else
+		std::ifstream f(path.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!f.is_open())
+			return false;
+		this->buffer.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+		this->data = this->buffer.data();
+		this->size = this->buffer.size();
+#endif
+		return true;
+	}
+
+	void Close()
+	{
+#ifndef _WIN32
+		if (this->size)
+			munmap(const_cast<char *>(this->data), this->size);
+#else
+		std::string().swap(this->buffer);
+#endif
+		this->data = NULL;
+		this->size = 0;
+	}
+};
+
+/* Reads a value in place from the mapped database */
+class ViewBuf : public std::streambuf
+{
+ public:
+	void Set(const char *d, size_t len)
+	{
+		char *p = const_cast<char *>(d);
+		this->setg(p, p, p + len);
+	}
+};
+
+/* A stream made of fixed size chunks, so what was written to it is never copied as it grows */
+class ChunkStream : public std::iostream
+{
+	class Buf : public std::streambuf
+	{
+		static const size_t ChunkSize = 1024 * 1024;
+
+	 public:
+		std::list<std::string> chunks;
+		/* How much has been written */
+		size_t size;
+
+		Buf() : size(0) { }
+
+	 protected:
+		int_type overflow(int_type c) anope_override
+		{
+			if (traits_type::eq_int_type(c, traits_type::eof()))
+				return traits_type::not_eof(c);
+
+			char ch = traits_type::to_char_type(c);
+			this->xsputn(&ch, 1);
+			return c;
+		}
+
+		std::streamsize xsputn(const char *s, std::streamsize n) anope_override
+		{
+			for (std::streamsize written = 0; written < n;)
+			{
+				if (chunks.empty() || chunks.back().size() == ChunkSize)
+				{
+					chunks.push_back(std::string());
+					chunks.back().reserve(ChunkSize);
+				}
+
+				std::string &chunk = chunks.back();
+				size_t len = std::min<size_t>(n - written, ChunkSize - chunk.size());
+				chunk.append(s + written, len);
+				written += len;
+			}
+			this->size += n;
+			return n;
+		}
+	} buf;
+
+	/* Ranges of what has been written to leave out */
+	std::vector<std::pair<size_t, size_t> > removed;
+
+ public:
+	ChunkStream() : std::iostream(&buf) { }
+
+	/** Get how much has been written */
+	size_t Tell() const { return buf.size; }
+
+	/** Leave out what was written between two offsets from Tell() */
+	void Remove(size_t from, size_t to)
+	{
+		removed.push_back(std::make_pair(from, to));
+	}
+
+	/** Get what has been written, without anything removed */
+	std::list<std::string> &GetChunks()
+	{
+		std::sort(removed.begin(), removed.end());
+		std::vector<std::pair<size_t, size_t> >::const_iterator r = removed.begin(), r_end = removed.end();
+		size_t offset = 0;
+		for (std::list<std::string>::iterator it = buf.chunks.begin(), it_end = buf.chunks.end(); r != r_end && it != it_end; ++it)
+		{
+			std::string &chunk = *it;
+			size_t len = chunk.size(), to = 0;
+			for (size_t from = 0; from < len;)
+			{
+				while (r != r_end && r->second <= offset + from)
+					++r;
+
+				size_t stop = len;
+				if (r != r_end && r->first <= offset + from)
+				{
+					from = std::min(len, r->second - offset);
+					continue;
+				}
+				else if (r != r_end)
+					stop = std::min(len, r->first - offset);
+
+				memmove(&chunk[0] + to, &chunk[0] + from, stop - from);
+				to += stop - from;
+				from = stop;
+			}
+			chunk.resize(to);
+			offset += len;
+		}
+		removed.clear();
+		return buf.chunks;
+	}
+};
+
+/* The records of part of a text database, tokenized in place. A part owns the
+ * objects whose OBJECT line starts in it, even if the rest of the object is past its end.
+ */
+class TextChunk
+{
+ public:
+	struct Field
+	{
+		/* The value follows the key and a space */
+		const char *key;
+		uint32_t keylen, length;
+
+		const char *value() const { return key + keylen + 1; }
+	};
+
+	struct Record
+	{
+		uint64_t id;
+		size_t field;
+		uint32_t count;
+	};
+
+	/* The whole file, and the part of it this chunk starts records in */
+	const char *file_begin, *file_end;
+	const char *begin, *end;
+
+	std::vector<Field> fields;
+	std::map<Anope::string, std::vector<Record> > records;
+
+	TextChunk() : file_begin(NULL), file_end(NULL), begin(NULL), end(NULL) { }
+
+ private:
+	const char *LineEnd(const char *p) const
+	{
+		const char *eol = static_cast<const char *>(memchr(p, '\n', this->file_end - p));
+		return eol ? eol : this->file_end;
+	}
+
+	static bool StartsWith(const char *p, const char *eol, const char *str, size_t len)
+	{
+		return static_cast<size_t>(eol - p) >= len && !memcmp(p, str, len);
+	}
+
+ public:
+	/* Follows the same rules as the old line by line loader: anything other than ID and DATA ends an object */
+	void Tokenize()
+	{
+		const char *p = this->begin;
+		if (p != this->file_begin && p[-1] != '\n')
+			p = std::min(this->LineEnd(p) + 1, this->end);
+
+		Anope::string type;
+		std::vector<Record> *current = NULL;
+
+		while (p < this->end)
+		{
+			const char *eol = this->LineEnd(p);
+			if (!StartsWith(p, eol, "OBJECT ", 7))
+			{
+				p = eol + 1;
+				continue;
+			}
+
+			if (!current || type.length() != static_cast<size_t>(eol - p - 7) || memcmp(type.c_str(), p + 7, type.length()))
+			{
+				type = Anope::string(p + 7, eol - p - 7);
+				current = &this->records[type];
+			}
+
+			Record r;
+			r.id = 0;
+			r.field = this->fields.size();
+			r.count = 0;
+
+			for (p = eol + 1; p < this->file_end; p = eol + 1)
+			{
+				eol = this->LineEnd(p);
+				if (StartsWith(p, eol, "ID ", 3))
+					FlatFile::ParseId(p + 3, eol, r.id);
+				else if (StartsWith(p, eol, "DATA ", 5))
+				{
+					const char *sp = static_cast<const char *>(memchr(p + 5, ' ', eol - p - 5));
+					if (sp == NULL)
+						continue;
+
+					Field f;
+					f.key = p + 5;
+					f.keylen = sp - f.key;
+					f.length = eol - sp - 1;
+					this->fields.push_back(f);
+					++r.count;
+				}
+				else
+					break;
+			}
+
+			current->push_back(r);
+		}
+	}
+};
+
+/* Tokenizes a part of a text database while the main thread does another */
+class TokenizeThread : public Thread
+{
+	TextChunk &chunk;
+
+ public:
+	TokenizeThread(TextChunk &c) : chunk(c) { }
+
+	void Run() anope_override
+	{
+		chunk.Tokenize();
+	}
+};
+
+/* How many threads to tokenize a text database with */
+static unsigned TokenizeThreads()
+{
+#ifndef _WIN32
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	long cpus = si.dwNumberOfProcessors;
+#endif
+	return std::max(1L, std::min(cpus, 8L));
+}
+
 class SaveData : public Serialize::Data
 {
  public:
 	Anope::string last;
-	std::fstream *fs;
+	std::iostream *fs;
+
+	SaveData() : fs(NULL) { }
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		if (key != last)
+		{
+			*fs << "\nDATA " << key << " ";
+			last = key;
+		}
+
+		return *fs;
+	}
+
+	void SetString(const Anope::string &key, const Anope::string_view &value) anope_override
+	{
+		*fs << "\nDATA " << key << " " << value;
+		last.clear();
+	}
+
+	void SetInt(const Anope::string &key, int64_t value) anope_override
+	{
+		char buf[20];
+		this->SetString(key, Serialize::FormatInt(buf, value));
+	}
+
+	void SetUInt(const Anope::string &key, uint64_t value) anope_override
+	{
+		char buf[20];
+		this->SetString(key, Serialize::FormatUInt(buf, value));
+	}
+};
+
+/* An object read from a journal */
+class LoadData : public Serialize::Data
+{
+ public:
+	uint64_t id;
+	std::map<Anope::string, Anope::string> data;
+	std::stringstream ss;
+
+	LoadData() : id(0) { }
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		ss.clear();
+		ss.str(this->data[key].str());
+		return this->ss;
+	}
+
+	Anope::string GetString(const Anope::string &key) anope_override
+	{
+		std::map<Anope::string, Anope::string>::const_iterator it = this->data.find(key);
+		return it != this->data.end() ? it->second : "";
+	}
+
+	int64_t GetInt(const Anope::string &key, int64_t def = 0) anope_override
+	{
+		std::map<Anope::string, Anope::string>::const_iterator it = this->data.find(key);
+		return it != this->data.end() ? Serialize::ParseInt(it->second, def) : def;
+	}
+
+	uint64_t GetUInt(const Anope::string &key, uint64_t def = 0) anope_override
+	{
+		std::map<Anope::string, Anope::string>::const_iterator it = this->data.find(key);
+		return it != this->data.end() ? Serialize::ParseUInt(it->second, def) : def;
+	}
+
+	std::set<Anope::string> KeySet() const anope_override
+	{
+		std::set<Anope::string> keys;
+		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
+			keys.insert(it->first);
+		return keys;
+	}
+
+	void Reset()
+	{
+		id = 0;
+		data.clear();
+	}
+};
+
+class BinarySaveData : public Serialize::Data
+{
+	Anope::string last;
+	std::stringstream ss;
+
+ public:
+	FlatFile::Writer *writer;
+
+	BinarySaveData() : writer(NULL) { }
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		if (key != last)
+		{
+			this->Flush();
+			last = key;
+		}
+
+		return ss;
+	}
+
+	void SetString(const Anope::string &key, const Anope::string_view &value) anope_override
+	{
+		this->Flush();
+		writer->AddField(key.str(), value.data(), value.length());
+	}
+
+	void SetInt(const Anope::string &key, int64_t value) anope_override
+	{
+		char buf[20];
+		this->SetString(key, Serialize::FormatInt(buf, value));
+	}
+
+	void SetUInt(const Anope::string &key, uint64_t value) anope_override
+	{
+		char buf[20];
+		this->SetString(key, Serialize::FormatUInt(buf, value));
+	}
+
+	/* Add the value written so far to the object */
+	void Flush()
+	{
+		if (last.empty())
+			return;
+
+		const std::string &value = ss.str();
+		writer->AddField(last.str(), value.data(), value.length());
+		ss.str("");
+		ss.clear();
+		last.clear();
+	}
+};
+
+class BinaryLoadData : public Serialize::Data
+{
+	ViewBuf buf;
+	std::iostream stream;
+
+ public:
+	const FlatFile::Reader *reader;
+	FlatFile::Reader::Object obj;
+
+	BinaryLoadData() : stream(&buf), reader(NULL) { }
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		const FlatFile::Reader::Field *f = reader->Find(obj, key.c_str(), key.length());
+		if (f)
+			buf.Set(f->value, f->length);
+		else
+			buf.Set("", 0);
+
+		stream.clear();
+		return stream;
+	}
+
+	Anope::string GetString(const Anope::string &key) anope_override
+	{
+		const FlatFile::Reader::Field *f = reader->Find(obj, key.c_str(), key.length());
+		return f ? Anope::string(f->value, f->length) : "";
+	}
+
+	int64_t GetInt(const Anope::string &key, int64_t def = 0) anope_override
+	{
+		const FlatFile::Reader::Field *f = reader->Find(obj, key.c_str(), key.length());
+		return f ? Serialize::ParseInt(Anope::string_view(f->value, f->length), def) : def;
+	}
+
+	uint64_t GetUInt(const Anope::string &key, uint64_t def = 0) anope_override
+	{
+		const FlatFile::Reader::Field *f = reader->Find(obj, key.c_str(), key.length());
+		return f ? Serialize::ParseUInt(Anope::string_view(f->value, f->length), def) : def;
+	}
+
+	std::set<Anope::string> KeySet() const anope_override
+	{
+		std::set<Anope::string> keys;
+		for (unsigned i = 0; i < obj.fields.size(); ++i)
+			keys.insert(reader->GetString(obj.fields[i].key).str());
+		return keys;
+	}
+};
+
+class TextLoadData : public Serialize::Data
+{
+	ViewBuf buf;
+	std::iostream stream;
+
+ public:
+	const TextChunk *chunk;
+	const TextChunk::Record *record;
+
+	TextLoadData() : stream(&buf), chunk(NULL), record(NULL) { }
+
+	/* Find the value of a key, the last one if there are several */
+	const TextChunk::Field *Find(const Anope::string &key) const
+	{
+		for (uint32_t i = record->count; i > 0; --i)
+		{
+			const TextChunk::Field &f = chunk->fields[record->field + i - 1];
+			if (f.keylen == key.length() && !memcmp(f.key, key.c_str(), f.keylen))
+				return &f;
+		}
+		return NULL;
+	}
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		const TextChunk::Field *f = this->Find(key);
+		if (f)
+			buf.Set(f->value(), f->length);
+		else
+			buf.Set("", 0);
+
+		stream.clear();
+		return stream;
+	}
+
+	Anope::string GetString(const Anope::string &key) anope_override
+	{
+		const TextChunk::Field *f = this->Find(key);
+		return f ? Anope::string(f->value(), f->length) : "";
+	}
+
+	int64_t GetInt(const Anope::string &key, int64_t def = 0) anope_override
+	{
+		const TextChunk::Field *f = this->Find(key);
+		return f ? Serialize::ParseInt(Anope::string_view(f->value(), f->length), def) : def;
+	}
+
+	uint64_t GetUInt(const Anope::string &key, uint64_t def = 0) anope_override
+	{
+		const TextChunk::Field *f = this->Find(key);
+		return f ? Serialize::ParseUInt(Anope::string_view(f->value(), f->length), def) : def;
+	}
+
+	std::set<Anope::string> KeySet() const anope_override
+	{
+		std::set<Anope::string> keys;
+		for (uint32_t i = 0; i < record->count; ++i)
+		{
+			const TextChunk::Field &f = chunk->fields[record->field + i];
+			keys.insert(Anope::string(f.key, f.keylen));
+		}
+		return keys;
+	}
+};
+
+/* Builds the journal record of an object */
+class JournalData : public Serialize::Data
+{
+	Anope::string last;
+
+ public:
+	std::stringstream ss;
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		if (key != last)
+		{
+			ss << "\nDATA " << key << " ";
+			last = key;
+		}
+
+		return ss;
+	}
+
+	void SetString(const Anope::string &key, const Anope::string_view &value) anope_override
+	{
+		ss << "\nDATA " << key << " " << value;
+		last.clear();
+	}
+
+	void SetInt(const Anope::string &key, int64_t value) anope_override
+	{
+		char buf[20];
+		this->SetString(key, Serialize::FormatInt(buf, value));
+	}
+
+	void SetUInt(const Anope::string &key, uint64_t value) anope_override
+	{
+		char buf[20];
+		this->SetString(key, Serialize::FormatUInt(buf, value));
+	}
+};
+
+/* Sorts objects by the order their types are loaded in */
+struct TypeOrderLess
+{
+	const std::map<Serialize::Type *, unsigned> &order;
+
+	TypeOrderLess(const std::map<Serialize::Type *, unsigned> &o) : order(o) { }
+
+	unsigned Index(Serializable *obj) const
+	{
+		std::map<Serialize::Type *, unsigned>::const_iterator it = order.find(obj->GetSerializableType());
+		return it != order.end() ? it->second : order.size();
+	}
+
+	bool operator()(Serializable *a, Serializable *b) const
+	{
+		return Index(a) < Index(b);
+	}
+};
+
+class DBFlatFile : public Module, public Pipe
+{
+	class JournalTimer : public Timer
+	{
+		DBFlatFile *db;
+
+	 public:
+		JournalTimer(DBFlatFile *d) : Timer(1, Anope::CurTime, true), db(d) { }
+
+		void Tick(time_t) anope_override
+		{
+			db->TickJournal();
+		}
+	};
+
+	/* Serializes the next slice of a background save each time it is notified */
+	class SaveSlicer : public Pipe
+	{
+		DBFlatFile *db;
+
+	 public:
+		SaveSlicer(DBFlatFile *d) : db(d) { }
+
+		/* Drain the pipe before the slice instead of after, as the slice may notify it again */
+		bool ProcessRead() anope_override
+		{
+			char buf[512];
+			while (this->Read(buf, sizeof(buf)) == sizeof(buf));
+
+			this->OnNotify();
+			return true;
+		}
+
+		void OnNotify() anope_override
+		{
+			db->SaveSlice(false);
+		}
+	};
+
+	/* Writes out the databases serialized by a background save */
+	class SaveThread : public Thread
+	{
+		DBFlatFile *db;
+
+		void WriteDatabase(const Anope::string &db_name, const std::list<std::string> &chunks)
+		{
+			const Anope::string &tmp_name = db_name + ".tmp";
+
+			FILE *f = fopen(tmp_name.c_str(), "wb");
+			bool ok = f != NULL;
+			for (std::list<std::string>::const_iterator it = chunks.begin(), it_end = chunks.end(); ok && it != it_end; ++it)
+				ok = fwrite(it->data(), 1, it->size(), f) == it->size();
+			ok = ok && !fflush(f);
+#ifndef _WIN32
+			ok = ok && !fsync(fileno(f));
+#endif
+			if (f != NULL && fclose(f))
+				ok = false;
+
+			if (!ok)
+			{
+				error += (error.empty() ? "" : ", ") + ("Unable to write database " + db_name + ": " + Anope::LastError());
+				return;
+			}
+
+#ifdef _WIN32
+			/* Windows rename() fails if the file already exists. */
+			remove(db_name.c_str());
+#endif
+			rename(tmp_name.c_str(), db_name.c_str());
+		}
+
+	 public:
+		/* The serialized databases, by path. Binary snapshots are finished here too, as that copies them */
+		std::map<Anope::string, FlatFile::Writer> writers;
+		std::map<Anope::string, ChunkStream *> texts;
+		Anope::string error;
+
+		SaveThread(DBFlatFile *d) : db(d) { }
+
+		~SaveThread()
+		{
+			for (std::map<Anope::string, ChunkStream *>::iterator it = texts.begin(), it_end = texts.end(); it != it_end; ++it)
+				delete it->second;
+		}
+
+		void Run() anope_override
+		{
+			for (std::map<Anope::string, FlatFile::Writer>::iterator it = writers.begin(), it_end = writers.end(); it != it_end; ++it)
+			{
+				std::list<std::string> chunks(1);
+				it->second.Finish(chunks.front());
+				this->WriteDatabase(it->first, chunks);
+			}
+
+			for (std::map<Anope::string, ChunkStream *>::iterator it = texts.begin(), it_end = texts.end(); it != it_end; ++it)
+			{
+				this->WriteDatabase(it->first, it->second->GetChunks());
+				delete it->second;
+				it->second = NULL;
+			}
+		}
+
+		void OnNotify() anope_override
+		{
+			Thread::OnNotify();
+			db->SaveWritten(this);
+		}
+	};
+
+	/* Where an object was saved by a background save */
+	struct SavedRecord
+	{
+		FlatFile::Writer *writer;
+		FlatFile::Writer::Position pos;
+		ChunkStream *text;
+		size_t begin, end;
+	};
+
+	/* The state of a save being serialized a slice at a time. The databases have
+	 * everything as it was when the last slice finished, so objects created during
+	 * the save are saved too, and ones which are deleted or change after they were
+	 * saved are removed again, and saved again if they still exist.
+	 */
+	struct BackgroundSave
+	{
+		/* The next object to save */
+		std::list<Serializable *>::const_iterator pos;
+		size_t count;
+		unsigned slices;
+		uint64_t started;
+		bool binary;
+		std::map<Anope::string, FlatFile::Writer> writers;
+		std::map<Anope::string, ChunkStream *> texts;
+		/* Objects already saved */
+		std::map<Serializable *, SavedRecord> saved;
+		/* Objects which changed after they were saved */
+		std::set<Serializable *> resave;
+		BinarySaveData bdata;
+		SaveData tdata;
+
+		BackgroundSave() : pos(Serializable::GetItems().begin()), count(0), slices(0), started(TimerManager::Now()), binary(false) { }
+
+		~BackgroundSave()
+		{
+			for (std::map<Anope::string, ChunkStream *>::iterator it = texts.begin(), it_end = texts.end(); it != it_end; ++it)
+				delete it->second;
+		}
+	};
+
+	/* Day the last backup was on */
+	int last_day;
+	/* Backup file names */
+	std::map<Anope::string, std::list<Anope::string> > backups;
+	bool loaded;
+	bool shutting_down;
+
+	int child_pid;
+
+	/* Whether changes are appended to the journals instead of waiting for the next full save */
+	bool journal;
+	/* Objects changed since the journals were last written to */
+	std::set<Serializable *> dirty;
+	/* Records waiting to be written to the journal of each database */
+	std::map<Anope::string, Anope::string> pending;
+	/* Open journals, by database name */
+	std::map<Anope::string, FILE *> journals;
+	/* Bytes in the journals since they were last compacted */
+	uint64_t journal_size;
+	/* Set if a write to a journal failed, so a snapshot is needed */
+	bool journal_failed;
+	bool unsynced;
+	time_t last_sync;
+	/* The last id given to an object of each type */
+	std::map<Anope::string, uint64_t> last_ids;
+	/* Whether a database is being loaded */
+	bool loading;
+	/* Objects by id while loading a database which has journals to replay */
+	std::map<Serialize::Type *, std::map<uint64_t, Serializable *> > *loaded_ids;
+	JournalTimer journal_timer;
+
+	BackgroundSave *save;
+	SaveSlicer save_slicer;
+	SaveThread *save_thread;
+
+	/* Get the path of the database objects of types owned by the given module go in */
+	Anope::string GetDatabaseName(Module *owner)
+	{
+		if (owner)
+			return Anope::DataDir + "/module_" + owner->name + ".db";
+		else
+			return Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+	}
+
+	/* Load objects of the given types from a binary snapshot, in the given order */
+	void LoadBinary(const Anope::string &db_name, const MappedFile &file, const std::vector<Serialize::Type *> &types)
+	{
+		FlatFile::Reader reader;
+		std::string error;
+		if (!reader.Open(file.data, file.size, error))
+		{
+			Log(this) << "Unable to load " << db_name << ": " << error;
+			return;
+		}
+
+		const std::vector<FlatFile::Reader::Section> &sections = reader.GetSections();
+		BinaryLoadData ld;
+		ld.reader = &reader;
+
+		for (unsigned i = 0; i < types.size(); ++i)
+		{
+			Serialize::Type *stype = types[i];
+			uint64_t started = TimerManager::Now();
+			unsigned count = 0;
+
+			for (unsigned j = 0; j < sections.size(); ++j)
+			{
+				if (!(reader.GetString(sections[j].type) == stype->GetName().c_str()))
+					continue;
+
+				for (reader.Begin(sections[j], ld.obj); reader.Next(ld.obj, error); ++count)
+				{
+					Serializable *obj = stype->Unserialize(NULL, ld);
+					if (obj != NULL)
+						this->Loaded(stype, obj, ld.obj.id);
+				}
+
+				if (!error.empty())
+				{
+					Log(this) << "Error loading " << stype->GetName() << " objects from " << db_name << ": " << error;
+					error.clear();
+				}
+			}
+
+			this->LoadedType(db_name, stype, count, started);
+		}
+	}
+
+	void LoadedType(const Anope::string &db_name, Serialize::Type *stype, unsigned count, uint64_t started)
+	{
+		if (count)
+			Log(LOG_DEBUG) << "db_flatfile: Loaded " << count << " " << stype->GetName() << " objects from " << db_name << " in " << (TimerManager::Now() - started) << "ms";
+	}
+
+	bool SaveBinary()
+	{
+		bool ok = true;
+		std::map<Module *, FlatFile::Writer> writers;
+
+		/* Every registered type gets a database, so if we have a type with 0 objects, that database will be properly cleared */
+		for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
+			writers[it->second->GetOwner()];
+
+		BinarySaveData data;
+		const std::list<Serializable *> &items = Serializable::GetItems();
+		for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+		{
+			Serializable *base = *it;
+			Serialize::Type *s_type = base->GetSerializableType();
+			if (!s_type)
+				continue;
+
+			data.writer = &writers[s_type->GetOwner()];
+			data.writer->BeginObject(s_type->GetName().str(), base->id);
+			base->Serialize(data);
+			data.Flush();
+			data.writer->EndObject();
+		}
+
+		for (std::map<Module *, FlatFile::Writer>::iterator it = writers.begin(), it_end = writers.end(); it != it_end; ++it)
+		{
+			const Anope::string &db_name = GetDatabaseName(it->first);
+
+			std::string out;
+			it->second.Finish(out);
+
+			std::fstream f((db_name + ".tmp").c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+			f.write(out.data(), out.size());
+
+			if (!f.is_open() || !f.good())
+			{
+				this->Write("Unable to write database " + db_name);
+				ok = false;
+
+				f.close();
+			}
+			else
+			{
+				f.close();
+#ifdef _WIN32
+				/* Windows rename() fails if the file already exists. */
+				remove(db_name.c_str());
+#endif
+				rename((db_name + ".tmp").c_str(), db_name.c_str());
+			}
+		}
+
+		return ok;
+	}
+
+	/* Get the paths of every database a registered type is saved in */
+	std::set<Anope::string> GetDatabaseNames()
+	{
+		std::set<Anope::string> dbs;
+		dbs.insert(GetDatabaseName(NULL));
+		for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
+			dbs.insert(GetDatabaseName(it->second->GetOwner()));
+		return dbs;
+	}
+
+	/* Record the id of an object that was just loaded */
+	void Loaded(Serialize::Type *stype, Serializable *obj, uint64_t id)
+	{
+		if (this->loaded_ids)
+		{
+			std::map<uint64_t, Serializable *> &objects = (*this->loaded_ids)[stype];
+			std::map<uint64_t, Serializable *>::iterator it = objects.find(obj->id);
+			if (obj->id && obj->id != id && it != objects.end() && it->second == obj)
+				objects.erase(it);
+			if (id)
+				objects[id] = obj;
+		}
+
+		obj->id = id;
+
+		uint64_t &last_id = this->last_ids[stype->GetName()];
+		if (id > last_id)
+			last_id = id;
+	}
+
+	/* Apply the records in a journal to the objects of the given types */
+	void ReplayJournal(const Anope::string &journal_name, const std::vector<Serialize::Type *> &types)
+	{
+		std::fstream fd(journal_name.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!fd.is_open())
+			return;
+
+		unsigned count = 0;
+		LoadData ld;
+		Serialize::Type *stype = NULL;
+		bool in_object = false;
+
+		for (Anope::string buf; std::getline(fd, buf.str());)
+		{
+			if (in_object)
+			{
+				if (buf.find("ID ") == 0)
+				{
+					try
+					{
+						ld.id = convertTo<uint64_t>(buf.substr(3));
+					}
+					catch (const ConvertException &) { }
+					continue;
+				}
+				else if (buf.find("DATA ") == 0)
+				{
+					size_t sp = buf.find(' ', 5);
+					if (sp != Anope::string::npos)
+						ld.data[buf.substr(5, sp - 5)] = buf.substr(sp + 1);
+					continue;
+				}
+
+				/* A record is only applied once it is complete, so a partially written one at the end of the journal is ignored */
+				in_object = false;
+				if (buf == "END" && stype && ld.id)
+				{
+					std::map<uint64_t, Serializable *> &objects = (*this->loaded_ids)[stype];
+					std::map<uint64_t, Serializable *>::iterator it = objects.find(ld.id);
+
+					Serializable *obj = stype->Unserialize(it != objects.end() ? it->second : NULL, ld);
+					if (obj != NULL)
+						this->Loaded(stype, obj, ld.id);
+					++count;
+					continue;
+				}
+			}
+
+			if (buf.find("OBJECT ") == 0)
+			{
+				stype = Serialize::Type::Find(buf.substr(7));
+				if (std::find(types.begin(), types.end(), stype) == types.end())
+					stype = NULL;
+				in_object = true;
+				ld.Reset();
+			}
+			else if (buf.find("DELETE ") == 0)
+			{
+				size_t sp = buf.rfind(' ');
+				Serialize::Type *dtype = Serialize::Type::Find(buf.substr(7, sp - 7));
+				if (std::find(types.begin(), types.end(), dtype) == types.end())
+					continue;
+
+				uint64_t id = 0;
+				try
+				{
+					id = convertTo<uint64_t>(buf.substr(sp + 1));
+				}
+				catch (const ConvertException &) { }
+
+				uint64_t &last_id = this->last_ids[dtype->GetName()];
+				if (id > last_id)
+					last_id = id;
+
+				std::map<uint64_t, Serializable *> &objects = (*this->loaded_ids)[dtype];
+				std::map<uint64_t, Serializable *>::iterator it = objects.find(id);
+				if (it != objects.end())
+				{
+					Serializable *obj = it->second;
+					objects.erase(it);
+					delete obj;
+				}
+				++count;
+			}
+		}
+
+		if (count)
+			Log(LOG_DEBUG) << "db_flatfile: Replayed " << count << " records from " << journal_name;
+	}
+
+	/* Load the objects of the given types from a database and its journals */
+	void Load(const Anope::string &db_name, const std::vector<Serialize::Type *> &types)
+	{
+		/* Objects only need to be found by id if there are journal records to apply to them */
+		bool replay = this->journal || Anope::IsFile(db_name + ".journal") || Anope::IsFile(db_name + ".journal.old");
+
+		std::map<Serialize::Type *, std::map<uint64_t, Serializable *> > objects;
+		this->loading = true;
+		this->loaded_ids = replay ? &objects : NULL;
+
+		MappedFile file;
+		if (!file.Open(db_name))
+			Log(this) << "Unable to open " << db_name << " for reading!";
+		else if (FlatFile::IsBinary(file.data, file.size))
+			this->LoadBinary(db_name, file, types);
+		else
+			this->LoadText(db_name, file, types);
+		file.Close();
+
+		if (replay)
+		{
+			/* The old journal is left behind if the last compaction did not finish, and is older than the current one */
+			this->ReplayJournal(db_name + ".journal.old", types);
+			this->ReplayJournal(db_name + ".journal", types);
+		}
+
+		this->loading = false;
+		this->loaded_ids = NULL;
+	}
+
+	/* Load objects of the given types from a text database. The file is split into parts which are
+	 * tokenized at the same time, then the objects are made from them in type order.
+	 */
+	void LoadText(const Anope::string &db_name, const MappedFile &file, const std::vector<Serialize::Type *> &types)
+	{
+		static const size_t min_part = 4 * 1024 * 1024;
+
+		uint64_t started = TimerManager::Now();
+		size_t parts = std::max<size_t>(1, std::min<size_t>(TokenizeThreads(), file.size / min_part));
+
+		std::vector<TextChunk> chunks(parts);
+		for (size_t i = 0; i < parts; ++i)
+		{
+			TextChunk &chunk = chunks[i];
+			chunk.file_begin = file.data;
+			chunk.file_end = file.data + file.size;
+			chunk.begin = file.data + file.size / parts * i;
+			chunk.end = i + 1 < parts ? file.data + file.size / parts * (i + 1) : chunk.file_end;
+		}
+
+		std::vector<TokenizeThread *> threads;
+		for (size_t i = 1; i < parts; ++i)
+		{
+			TokenizeThread *t = new TokenizeThread(chunks[i]);
+			try
+			{
+				t->Start();
+				threads.push_back(t);
+			}
+			catch (const CoreException &ex)
+			{
+				Log(this) << ex.GetReason();
+				delete t;
+				chunks[i].Tokenize();
+			}
+		}
+
+		chunks[0].Tokenize();
+
+		for (unsigned i = 0; i < threads.size(); ++i)
+		{
+			threads[i]->Join();
+			delete threads[i];
+		}
+
+		size_t records = 0;
+		for (size_t i = 0; i < parts; ++i)
+			for (std::map<Anope::string, std::vector<TextChunk::Record> >::const_iterator it = chunks[i].records.begin(), it_end = chunks[i].records.end(); it != it_end; ++it)
+				records += it->second.size();
+		Log(LOG_DEBUG) << "db_flatfile: Tokenized " << records << " objects from " << db_name << " in " << parts << " parts in " << (TimerManager::Now() - started) << "ms";
+
+		TextLoadData ld;
+		for (unsigned i = 0; i < types.size(); ++i)
+		{
+			Serialize::Type *stype = types[i];
+			started = TimerManager::Now();
+			unsigned count = 0;
+
+			for (size_t j = 0; j < parts; ++j)
+			{
+				std::map<Anope::string, std::vector<TextChunk::Record> >::iterator it = chunks[j].records.find(stype->GetName());
+				if (it == chunks[j].records.end())
+					continue;
+
+				ld.chunk = &chunks[j];
+				for (unsigned k = 0; k < it->second.size(); ++k, ++count)
+				{
+					ld.record = &it->second[k];
+
+					Serializable *obj = stype->Unserialize(NULL, ld);
+					if (obj != NULL)
+						this->Loaded(stype, obj, ld.record->id);
+				}
+
+				chunks[j].records.erase(it);
+			}
+
+			this->LoadedType(db_name, stype, count, started);
+		}
+	}
+
+	/* Journal records refer to objects by id, so every object needs one. Objects loaded from a database
+	 * written before the journal was enabled have none, so give them one and write a snapshot with them.
+	 */
+	void CheckIds()
+	{
+		if (!this->journal)
+			return;
+
+		unsigned assigned = 0;
+		const std::list<Serializable *> &items = Serializable::GetItems();
+		for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+		{
+			Serializable *obj = *it;
+			if (obj->GetSerializableType() && !obj->id)
+			{
+				obj->id = ++this->last_ids[obj->GetSerializableType()->GetName()];
+				++assigned;
+			}
+		}
+
+		if (!assigned || Anope::ReadOnly)
+			return;
+
+		Log(this) << "Gave " << assigned << " objects ids for the journal, writing a new snapshot";
+		/* A snapshot still being written would replace this one */
+		this->WaitForSave();
+		if (this->Save())
+			this->RemoveJournals(true);
+	}
+
+	FILE *OpenJournal(const Anope::string &db_name)
+	{
+		FILE *&f = this->journals[db_name];
+		if (f == NULL)
+		{
+			f = fopen((db_name + ".journal").c_str(), "ab");
+			if (f != NULL && !fseek(f, 0, SEEK_END))
+				this->journal_size += ftell(f);
+		}
+		return f;
+	}
+
+	void CloseJournals()
+	{
+		for (std::map<Anope::string, FILE *>::iterator it = this->journals.begin(), it_end = this->journals.end(); it != it_end; ++it)
+			if (it->second)
+				fclose(it->second);
+		this->journals.clear();
+	}
+
+	/* Start new journals before writing a snapshot in the background. The current ones
+	 * are kept until the snapshot is written, as it would not be complete without them.
+	 */
+	void RotateJournals()
+	{
+		this->CloseJournals();
+		this->journal_size = 0;
+		this->journal_failed = false;
+
+		std::set<Anope::string> dbs = this->GetDatabaseNames();
+		for (std::set<Anope::string>::const_iterator it = dbs.begin(), it_end = dbs.end(); it != it_end; ++it)
+		{
+			const Anope::string &journal_name = *it + ".journal", &old_name = journal_name + ".old";
+			if (!Anope::IsFile(journal_name))
+				continue;
+
+			if (!Anope::IsFile(old_name))
+			{
+				rename(journal_name.c_str(), old_name.c_str());
+				continue;
+			}
+
+			/* The last snapshot failed, so the old journal is still needed */
+			std::ifstream in(journal_name.c_str(), std::ios_base::in | std::ios_base::binary);
+			std::ofstream out(old_name.c_str(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+			out << in.rdbuf();
+			in.close();
+			out.close();
+
+			if (out.good())
+				unlink(journal_name.c_str());
+			else
+				Log(this) << "Unable to append " << journal_name << " to " << old_name << ": " << Anope::LastError();
+		}
+	}
+
+	/* Remove journals a snapshot has been written with */
+	void RemoveJournals(bool current)
+	{
+		if (current)
+		{
+			this->CloseJournals();
+			this->journal_size = 0;
+			this->journal_failed = false;
+		}
+
+		std::set<Anope::string> dbs = this->GetDatabaseNames();
+		for (std::set<Anope::string>::const_iterator it = dbs.begin(), it_end = dbs.end(); it != it_end; ++it)
+		{
+			unlink((*it + ".journal.old").c_str());
+			if (current)
+				unlink((*it + ".journal").c_str());
+		}
+	}
+
+	/* Append the objects that changed and were deleted to the journals */
+	void FlushJournal(bool sync)
+	{
+		if (Anope::ReadOnly)
+			return;
+
+		if (!this->dirty.empty())
+		{
+			std::map<Serialize::Type *, unsigned> order;
+			const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+			for (unsigned i = 0; i < type_order.size(); ++i)
+				order[Serialize::Type::Find(type_order[i])] = i;
+
+			/* Objects are written in type order, as ones of later types may depend on ones of earlier types when they are replayed */
+			std::vector<Serializable *> objects(this->dirty.begin(), this->dirty.end());
+			this->dirty.clear();
+			std::stable_sort(objects.begin(), objects.end(), TypeOrderLess(order));
+
+			for (unsigned i = 0; i < objects.size(); ++i)
+			{
+				Serializable *obj = objects[i];
+				Serialize::Type *s_type = obj->GetSerializableType();
+				if (!s_type)
+					continue;
+
+				JournalData data;
+				obj->Serialize(data);
+
+				/* Objects get their id when they are first written, so ones that are deleted before then are never journaled */
+				if (!obj->id)
+					obj->id = ++this->last_ids[s_type->GetName()];
+
+				Anope::string &out = this->pending[GetDatabaseName(s_type->GetOwner())];
+				out += "OBJECT " + s_type->GetName() + "\nID " + stringify(obj->id);
+				out += data.ss.str();
+				out += "\nEND\n";
+			}
+		}
+
+		for (std::map<Anope::string, Anope::string>::iterator it = this->pending.begin(), it_end = this->pending.end(); it != it_end; ++it)
+		{
+			const Anope::string &records = it->second;
+			if (records.empty())
+				continue;
 
-	SaveData() : fs(NULL) { }
+			FILE *f = this->OpenJournal(it->first);
+			if (f == NULL || fwrite(records.c_str(), 1, records.length(), f) != records.length() || fflush(f))
+			{
+				/* Compact as soon as possible, the snapshot will have what did not make it into the journal */
+				Log(this) << "Unable to write to the journal of " << it->first << ": " << Anope::LastError();
+				this->journal_failed = true;
+			}
+			else
+				this->journal_size += records.length();
+			this->unsynced = true;
+		}
+		this->pending.clear();
 
-	std::iostream& operator[](const Anope::string &key) anope_override
-	{
-		if (key != last)
+		if (this->unsynced && (sync || this->last_sync + Config->GetModule(this)->Get<time_t>("journalsync", "5s") <= Anope::CurTime))
 		{
-			*fs << "\nDATA " << key << " ";
-			last = key;
+#ifndef _WIN32
+			for (std::map<Anope::string, FILE *>::iterator it = this->journals.begin(), it_end = this->journals.end(); it != it_end; ++it)
+				if (it->second)
+					fsync(fileno(it->second));
+#endif
+			this->unsynced = false;
+			this->last_sync = Anope::CurTime;
 		}
+	}
 
-		return *fs;
+	bool JournalFull()
+	{
+		return this->journal_failed || this->journal_size >= Config->GetModule(this)->Get<uint64_t>("journalsize", "16384") * 1024;
 	}
-};
 
-class LoadData : public Serialize::Data
-{
- public:
-	std::fstream *fs;
-	unsigned int id;
-	std::map<Anope::string, Anope::string> data;
-	std::stringstream ss;
-	bool read;
+	/* Start serializing every object, a slice at a time */
+	void StartBackgroundSave()
+	{
+		this->save = new BackgroundSave();
+		this->save->binary = Config->GetModule(this)->Get<const Anope::string>("format").equals_ci("binary");
 
-	LoadData() : fs(NULL), id(0), read(false) { }
 
-	std::iostream& operator[](const Anope::string &key) anope_override
-	{
-		if (!read)
+		/* Every registered type gets a database, so if we have a type with 0 objects, that database will be properly cleared */
+		std::set<Anope::string> dbs = this->GetDatabaseNames();
+		for (std::set<Anope::string>::const_iterator it = dbs.begin(), it_end = dbs.end(); it != it_end; ++it)
 		{
-			for (Anope::string token; std::getline(*this->fs, token.str());)
-			{
-				if (token.find("ID ") == 0)
-				{
-					try
-					{
-						this->id = convertTo<unsigned int>(token.substr(3));
-					}
-					catch (const ConvertException &) { }
+			if (this->save->binary)
+				this->save->writers[*it];
+			else
+				this->save->texts[*it] = new ChunkStream();
+		}
 
-					continue;
-				}
-				else if (token.find("DATA ") != 0)
-					break;
+		this->SaveSlice(false);
+	}
 
-				size_t sp = token.find(' ', 5); // Skip DATA
-				if (sp != Anope::string::npos)
-					data[token.substr(5, sp - 5)] = token.substr(sp + 1);
-			}
+	/* Wait for a save in the background to finish */
+	void FinishBackgroundSave()
+	{
+		if (this->save)
+			this->SaveSlice(true);
 
-			read = true;
+		if (this->save_thread)
+		{
+			SaveThread *t = this->save_thread;
+			t->Join();
+			this->SaveWritten(t);
+			delete t;
 		}
-
-		ss.clear();
-		this->ss << this->data[key];
-		return this->ss;
 	}
 
-	std::set<Anope::string> KeySet() const anope_override
+	/* Wait for any save in progress to finish */
+	void WaitForSave()
 	{
-		std::set<Anope::string> keys;
-		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
-			keys.insert(it->first);
-		return keys;
+#ifndef _WIN32
+		if (child_pid > -1)
+			waitpid(child_pid, NULL, 0);
+#endif
+		this->FinishBackgroundSave();
 	}
 
-	size_t Hash() const anope_override
+	void SaveFinished(const Anope::string &error)
 	{
-		size_t hash = 0;
-		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
-			if (!it->second.empty())
-				hash ^= Anope::hash_cs()(it->second);
-		return hash;
+		if (error.empty())
+		{
+			Log(this) << "Finished saving databases";
+			this->RemoveJournals(!this->journal);
+			return;
+		}
+
+		Log(this) << "Error saving databases: " << error;
+
+		if (!Config->GetModule(this)->Get<bool>("nobackupokay"))
+			Anope::Quitting = true;
 	}
 
-	void Reset()
+	bool BackupDue()
 	{
-		id = 0;
-		read = false;
-		data.clear();
+		tm *tm = localtime(&Anope::CurTime);
+		return tm->tm_mday != last_day;
 	}
-};
-
-class DBFlatFile : public Module, public Pipe
-{
-	/* Day the last backup was on */
-	int last_day;
-	/* Backup file names */
-	std::map<Anope::string, std::list<Anope::string> > backups;
-	bool loaded;
-
-	int child_pid;
 
 	void BackupDatabase()
 	{
@@ -172,12 +1474,45 @@ class DBFlatFile : public Module, public Pipe
 	}
 
  public:
-	DBFlatFile(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), last_day(0), loaded(false), child_pid(-1)
+	DBFlatFile(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), last_day(0), loaded(false), shutting_down(false), child_pid(-1),
+		journal(false), journal_size(0), journal_failed(false), unsynced(false), last_sync(0), loading(false), loaded_ids(NULL), journal_timer(this), save(NULL), save_slicer(this), save_thread(NULL)
 	{
 
 	}
 
-#ifndef _WIN32
+	~DBFlatFile()
+	{
+		this->FinishBackgroundSave();
+		if (this->journal && this->loaded && !this->shutting_down)
+			this->FlushJournal(true);
+		this->CloseJournals();
+	}
+
+	void OnReload(Configuration::Conf *conf) anope_override
+	{
+		bool was_journal = this->journal;
+		this->journal = conf->GetModule(this)->Get<bool>("journal");
+
+		if (this->journal == was_journal || !this->loaded)
+			return;
+
+		if (this->journal)
+		{
+			/* Start the journal from a snapshot of everything */
+			this->CheckIds();
+			this->WaitForSave();
+			if (this->Save())
+				this->RemoveJournals(true);
+		}
+		else
+		{
+			/* The journal is only replayed until the next full save */
+			this->FlushJournal(true);
+			this->dirty.clear();
+			this->CloseJournals();
+		}
+	}
+
 	void OnRestart() anope_override
 	{
 		OnShutdown();
@@ -185,6 +1520,13 @@ class DBFlatFile : public Module, public Pipe
 
 	void OnShutdown() anope_override
 	{
+		this->FinishBackgroundSave();
+		if (this->journal && this->loaded)
+			this->FlushJournal(true);
+		this->CloseJournals();
+		this->shutting_down = true;
+
+#ifndef _WIN32
 		if (child_pid > -1)
 		{
 			Log(this) << "Waiting for child to exit...";
@@ -194,8 +1536,8 @@ class DBFlatFile : public Module, public Pipe
 
 			Log(this) << "Done";
 		}
-	}
 #endif
+	}
 
 	void OnNotify() anope_override
 	{
@@ -207,71 +1549,45 @@ class DBFlatFile : public Module, public Pipe
 
 		child_pid = -1;
 
-		if (!*buf)
-		{
-			Log(this) << "Finished saving databases";
-			return;
-		}
-
-		Log(this) << "Error saving databases: " << buf;
-
-		if (!Config->GetModule(this)->Get<bool>("nobackupokay"))
-			Anope::Quitting = true;
+		this->SaveFinished(buf);
 	}
 
 	EventReturn OnLoadDatabase() anope_override
 	{
 		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
-		std::set<Anope::string> tried_dbs;
-
-		const Anope::string &db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
-
-		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
-		if (!fd.is_open())
-		{
-			Log(this) << "Unable to open " << db_name << " for reading!";
-			return EVENT_STOP;
-		}
-
-		std::map<Anope::string, std::vector<std::streampos> > positions;
-
-		for (Anope::string buf; std::getline(fd, buf.str());)
-			if (buf.find("OBJECT ") == 0)
-				positions[buf.substr(7)].push_back(fd.tellg());
-
-		LoadData ld;
-		ld.fs = &fd;
 
+		std::vector<Serialize::Type *> types;
 		for (unsigned i = 0; i < type_order.size(); ++i)
 		{
 			Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
-			if (!stype || stype->GetOwner())
-				continue;
-
-			std::vector<std::streampos> &pos = positions[stype->GetName()];
-
-			for (unsigned j = 0; j < pos.size(); ++j)
-			{
-				fd.clear();
-				fd.seekg(pos[j]);
-
-				Serializable *obj = stype->Unserialize(NULL, ld);
-				if (obj != NULL)
-					obj->id = ld.id;
-				ld.Reset();
-			}
+			if (stype && !stype->GetOwner())
+				types.push_back(stype);
 		}
 
-		fd.close();
+		this->Load(GetDatabaseName(NULL), types);
 
 		loaded = true;
+		this->CheckIds();
 		return EVENT_STOP;
 	}
 
 
 	void OnSaveDatabase() anope_override
 	{
-		if (child_pid > -1)
+		if (this->journal && this->loaded)
+		{
+			this->FlushJournal(true);
+
+			/* Only compact the journal if it is too large, or the day's backup is due */
+			if (Anope::Quitting || (!this->JournalFull() && !this->BackupDue()))
+				return;
+		}
+
+		/* Changes made since a background save started are not in it */
+		if (Anope::Quitting)
+			this->FinishBackgroundSave();
+
+		if (child_pid > -1 || this->save || this->save_thread)
 		{
 			Log(this) << "Database save is already in progress!";
 			return;
@@ -279,6 +1595,15 @@ class DBFlatFile : public Module, public Pipe
 
 		BackupDatabase();
 
+		if (this->journal)
+			this->RotateJournals();
+
+		if (!Anope::Quitting && Config->GetModule(this)->Get<bool>("background"))
+		{
+			this->StartBackgroundSave();
+			return;
+		}
+
 		int i = -1;
 #ifndef _WIN32
 		if (!Anope::Quitting && Config->GetModule(this)->Get<bool>("fork"))
@@ -296,117 +1621,305 @@ class DBFlatFile : public Module, public Pipe
 
 		try
 		{
-			std::map<Module *, std::fstream *> databases;
+			if (this->Save() && i < 0)
+				this->RemoveJournals(!this->journal);
+		}
+		catch (...)
+		{
+			if (i)
+				throw;
+		}
 
-			/* First open the databases of all of the registered types. This way, if we have a type with 0 objects, that database will be properly cleared */
-			for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
-			{
-				Serialize::Type *s_type = it->second;
+		if (!i)
+		{
+			this->Notify();
+			exit(0);
+		}
+	}
 
-				if (databases[s_type->GetOwner()])
-					continue;
+	bool SaveText()
+	{
+		bool ok = true;
+		std::map<Module *, std::fstream *> databases;
 
-				Anope::string db_name;
-				if (s_type->GetOwner())
-					db_name = Anope::DataDir + "/module_" + s_type->GetOwner()->name + ".db";
-				else
-					db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+		/* First open the databases of all of the registered types. This way, if we have a type with 0 objects, that database will be properly cleared */
+		for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
+		{
+			Serialize::Type *s_type = it->second;
 
-				std::fstream *fs = databases[s_type->GetOwner()] = new std::fstream((db_name + ".tmp").c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+			if (databases[s_type->GetOwner()])
+				continue;
 
-				if (!fs->is_open())
-					Log(this) << "Unable to open " << db_name << " for writing";
-			}
+			const Anope::string &db_name = GetDatabaseName(s_type->GetOwner());
 
-			SaveData data;
-			const std::list<Serializable *> &items = Serializable::GetItems();
-			for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
-			{
-				Serializable *base = *it;
-				Serialize::Type *s_type = base->GetSerializableType();
-				if (!s_type)
-					continue;
+			std::fstream *fs = databases[s_type->GetOwner()] = new std::fstream((db_name + ".tmp").c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
 
-				data.fs = databases[s_type->GetOwner()];
-				if (!data.fs || !data.fs->is_open())
-					continue;
+			if (!fs->is_open())
+				Log(this) << "Unable to open " << db_name << " for writing";
+		}
 
-				*data.fs << "OBJECT " << s_type->GetName();
-				if (base->id)
-					*data.fs << "\nID " << base->id;
-				base->Serialize(data);
-				*data.fs << "\nEND\n";
-			}
+		SaveData data;
+		const std::list<Serializable *> &items = Serializable::GetItems();
+		for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+		{
+			Serializable *base = *it;
+			Serialize::Type *s_type = base->GetSerializableType();
+			if (!s_type)
+				continue;
 
-			for (std::map<Module *, std::fstream *>::iterator it = databases.begin(), it_end = databases.end(); it != it_end; ++it)
-			{
-				std::fstream *f = it->second;
-				const Anope::string &db_name = Anope::DataDir + "/" + (it->first ? (it->first->name + ".db") : Config->GetModule(this)->Get<const Anope::string>("database", "anope.db"));
+			std::fstream *fs = databases[s_type->GetOwner()];
+			if (!fs || !fs->is_open())
+				continue;
+			data.fs = fs;
 
-				if (!f->is_open() || !f->good())
-				{
-					this->Write("Unable to write database " + db_name);
+			*data.fs << "OBJECT " << s_type->GetName();
+			if (base->id)
+				*data.fs << "\nID " << base->id;
+			base->Serialize(data);
+			*data.fs << "\nEND\n";
+		}
 
-					f->close();
-				}
-				else
-				{
-					f->close();
+		for (std::map<Module *, std::fstream *>::iterator it = databases.begin(), it_end = databases.end(); it != it_end; ++it)
+		{
+			std::fstream *f = it->second;
+			const Anope::string &db_name = GetDatabaseName(it->first);
+
+			if (!f->is_open() || !f->good())
+			{
+				this->Write("Unable to write database " + db_name);
+				ok = false;
+
+				f->close();
+			}
+			else
+			{
+				f->close();
 #ifdef _WIN32
-					/* Windows rename() fails if the file already exists. */
-					remove(db_name.c_str());
+				/* Windows rename() fails if the file already exists. */
+				remove(db_name.c_str());
 #endif
-					rename((db_name + ".tmp").c_str(), db_name.c_str());
-				}
-
-				delete f;
+				rename((db_name + ".tmp").c_str(), db_name.c_str());
 			}
+
+			delete f;
 		}
-		catch (...)
+
+		return ok;
+	}
+
+	bool Save()
+	{
+		if (Config->GetModule(this)->Get<const Anope::string>("format").equals_ci("binary"))
+			return this->SaveBinary();
+		else
+			return this->SaveText();
+	}
+
+	/* Load just one type. Done if a module is reloaded during runtime */
+	void OnSerializeTypeCreate(Serialize::Type *stype) anope_override
+	{
+		if (!loaded)
+			return;
+
+		this->Load(GetDatabaseName(stype->GetOwner()), std::vector<Serialize::Type *>(1, stype));
+		this->CheckIds();
+	}
+
+	void OnSerializableConstruct(Serializable *obj) anope_override
+	{
+		if (!this->journal || !this->loaded || this->loading || this->shutting_down || !obj->GetSerializableType())
+			return;
+
+		this->dirty.insert(obj);
+	}
+
+	void OnSerializableUpdate(Serializable *obj) anope_override
+	{
+		if (this->save && this->Unsave(obj))
+			this->save->resave.insert(obj);
+
+		if (!this->journal || !this->loaded || this->loading || this->shutting_down || !obj->GetSerializableType())
+			return;
+
+		this->dirty.insert(obj);
+	}
+
+	void OnSerializableDestruct(Serializable *obj) anope_override
+	{
+		Serialize::Type *s_type = obj->GetSerializableType();
+
+		if (this->save)
 		{
-			if (i)
-				throw;
+			/* Skip objects deleted before the background save reached them */
+			if (this->save->pos != Serializable::GetItems().end() && *this->save->pos == obj)
+				++this->save->pos;
+			this->Unsave(obj);
+			this->save->resave.erase(obj);
 		}
 
-		if (!i)
+		if (this->loading)
 		{
-			this->Notify();
-			exit(0);
+			if (this->loaded_ids)
+			{
+				std::map<uint64_t, Serializable *> &objects = (*this->loaded_ids)[s_type];
+				std::map<uint64_t, Serializable *>::iterator it = objects.find(obj->id);
+				if (it != objects.end() && it->second == obj)
+					objects.erase(it);
+			}
+			return;
 		}
+
+		if (!this->journal || this->shutting_down)
+			return;
+
+		this->dirty.erase(obj);
+		if (s_type && obj->id)
+			this->pending[GetDatabaseName(s_type->GetOwner())] += "DELETE " + s_type->GetName() + " " + stringify(obj->id) + "\n";
 	}
 
-	/* Load just one type. Done if a module is reloaded during runtime */
-	void OnSerializeTypeCreate(Serialize::Type *stype) anope_override
+	void TickJournal()
 	{
-		if (!loaded)
+		if (!this->journal || !this->loaded || this->shutting_down)
 			return;
 
-		Anope::string db_name;
-		if (stype->GetOwner())
-			db_name = Anope::DataDir + "/module_" + stype->GetOwner()->name + ".db";
+		this->FlushJournal(false);
+
+		if (child_pid == -1 && !this->save && !this->save_thread && this->JournalFull())
+			this->OnSaveDatabase();
+	}
+
+	/* Remove an object from the background save
+	 * @return Whether it had been saved
+	 */
+	bool Unsave(Serializable *obj)
+	{
+		std::map<Serializable *, SavedRecord>::iterator it = this->save->saved.find(obj);
+		if (it == this->save->saved.end())
+			return false;
+
+		const SavedRecord &rec = it->second;
+		if (rec.writer)
+			rec.writer->Remove(rec.pos);
 		else
-			db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+			rec.text->Remove(rec.begin, rec.end);
+		this->save->saved.erase(it);
+		return true;
+	}
 
-		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
-		if (!fd.is_open())
-		{
-			Log(this) << "Unable to open " << db_name << " for reading!";
+	/* Serialize one object into the background save */
+	void SaveObject(Serializable *base, std::map<Serialize::Type *, Anope::string> &db_names)
+	{
+		BackgroundSave *bs = this->save;
+		Serialize::Type *s_type = base->GetSerializableType();
+		if (!s_type)
 			return;
+
+		/* Objects created since the journal was started get their id now, so the journal's records for them update this one */
+		if (this->journal && !base->id)
+			base->id = ++this->last_ids[s_type->GetName()];
+
+		std::map<Serialize::Type *, Anope::string>::iterator it = db_names.find(s_type);
+		if (it == db_names.end())
+			it = db_names.insert(std::make_pair(s_type, GetDatabaseName(s_type->GetOwner()))).first;
+
+		SavedRecord &rec = bs->saved[base];
+		if (bs->binary)
+		{
+			BinarySaveData &bdata = bs->bdata;
+			bdata.writer = &bs->writers[it->second];
+			bdata.writer->BeginObject(s_type->GetName().str(), base->id);
+			base->Serialize(bdata);
+			bdata.Flush();
+			bdata.writer->EndObject();
+
+			rec.writer = bdata.writer;
+			rec.pos = bdata.writer->GetLast();
+			rec.text = NULL;
+		}
+		else
+		{
+			ChunkStream *&ss = bs->texts[it->second];
+			if (!ss)
+				ss = new ChunkStream();
+			SaveData &tdata = bs->tdata;
+			tdata.fs = ss;
+			tdata.last.clear();
+
+			rec.writer = NULL;
+			rec.text = ss;
+			rec.begin = ss->Tell();
+
+			*ss << "OBJECT " << s_type->GetName();
+			if (base->id)
+				*ss << "\nID " << base->id;
+			base->Serialize(tdata);
+			*ss << "\nEND\n";
+
+			rec.end = ss->Tell();
 		}
+	}
 
-		LoadData ld;
-		ld.fs = &fd;
+	/* Serialize objects for a while, then let other events be handled before continuing
+	 * @param all Whether to serialize all of the remaining objects now
+	 */
+	void SaveSlice(bool all)
+	{
+		BackgroundSave *bs = this->save;
+		if (!bs)
+			return;
 
-		for (Anope::string buf; std::getline(fd, buf.str());)
+		/* How long to serialize objects for at a time, in milliseconds */
+		static const uint64_t slice_length = 10;
+		uint64_t deadline = TimerManager::Now() + slice_length;
+		++bs->slices;
+
+		std::map<Serialize::Type *, Anope::string> db_names;
+		for (const std::list<Serializable *>::const_iterator end = Serializable::GetItems().end(); bs->pos != end; ++bs->pos, ++bs->count)
 		{
-			if (buf == "OBJECT " + stype->GetName())
+			if (!all && !(bs->count % 256) && TimerManager::Now() >= deadline)
 			{
-				stype->Unserialize(NULL, ld);
-				ld.Reset();
+				this->save_slicer.Notify();
+				return;
 			}
+
+			this->SaveObject(*bs->pos, db_names);
+		}
+
+		for (std::set<Serializable *>::const_iterator it = bs->resave.begin(), it_end = bs->resave.end(); it != it_end; ++it)
+			this->SaveObject(*it, db_names);
+
+		/* Everything is serialized, so hand the databases to a thread to write out */
+		SaveThread *t = new SaveThread(this);
+		t->writers.swap(bs->writers);
+		t->texts.swap(bs->texts);
+
+		Log(LOG_DEBUG) << "db_flatfile: Serialized " << bs->count << " objects in " << bs->slices << " slices over " << (TimerManager::Now() - bs->started) << "ms";
+
+		delete bs;
+		this->save = NULL;
+		this->save_thread = t;
+
+		try
+		{
+			t->Start();
+		}
+		catch (const CoreException &ex)
+		{
+			Log(this) << ex.GetReason() << ", writing databases now";
+			t->Run();
+			this->SaveWritten(t);
+			delete t;
 		}
+	}
+
+	/* Called when a SaveThread has written the databases */
+	void SaveWritten(SaveThread *t)
+	{
+		if (this->save_thread != t)
+			return;
 
-		fd.close();
+		this->save_thread = NULL;
+		this->SaveFinished(t->error);
 	}
 };
 
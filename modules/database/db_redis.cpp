@@ -33,6 +33,53 @@ class Data : public Serialize::Data
 		return *stream;
 	}
 
+	void SetString(const Anope::string &key, const Anope::string_view &value) anope_override
+	{
+		std::stringstream* &stream = data[key];
+		if (!stream)
+			stream = new std::stringstream();
+		stream->str(std::string(value.data(), value.length()));
+		stream->clear();
+	}
+
+	void SetInt(const Anope::string &key, int64_t value) anope_override
+	{
+		char buf[20];
+		this->SetString(key, Serialize::FormatInt(buf, value));
+	}
+
+	void SetUInt(const Anope::string &key, uint64_t value) anope_override
+	{
+		char buf[20];
+		this->SetString(key, Serialize::FormatUInt(buf, value));
+	}
+
+	Anope::string GetString(const Anope::string &key) anope_override
+	{
+		std::map<Anope::string, std::stringstream *>::const_iterator it = this->data.find(key);
+		return it != this->data.end() ? it->second->str() : "";
+	}
+
+	int64_t GetInt(const Anope::string &key, int64_t def = 0) anope_override
+	{
+		std::map<Anope::string, std::stringstream *>::const_iterator it = this->data.find(key);
+		if (it == this->data.end())
+			return def;
+
+		const std::string &value = it->second->str();
+		return Serialize::ParseInt(Anope::string_view(value.data(), value.length()), def);
+	}
+
+	uint64_t GetUInt(const Anope::string &key, uint64_t def = 0) anope_override
+	{
+		std::map<Anope::string, std::stringstream *>::const_iterator it = this->data.find(key);
+		if (it == this->data.end())
+			return def;
+
+		const std::string &value = it->second->str();
+		return Serialize::ParseUInt(Anope::string_view(value.data(), value.length()), def);
+	}
+
 	std::set<Anope::string> KeySet() const anope_override
 	{
 		std::set<Anope::string> keys;
@@ -40,15 +87,6 @@ class Data : public Serialize::Data
 			keys.insert(it->first);
 		return keys;
 	}
-
-	size_t Hash() const anope_override
-	{
-		size_t hash = 0;
-		for (std::map<Anope::string, std::stringstream *>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
-			if (!it->second->str().empty())
-				hash ^= Anope::hash_cs()(it->second->str());
-		return hash;
-	}
 };
 
 class TypeLoader : public Interface
@@ -142,14 +180,6 @@ class DatabaseRedis : public Module, public Pipe
 			redis->SendCommand(new IDInterface(this, obj), "INCR id:" + t->GetName());
 		else
 		{
-			Data data;
-			obj->Serialize(data);
-
-			if (obj->IsCached(data))
-				return;
-
-			obj->UpdateCache(data);
-
 			std::vector<Anope::string> args;
 			args.push_back("HGETALL");
 			args.push_back("hash:" + t->GetName() + ":" + stringify(obj->id));
@@ -159,6 +189,12 @@ class DatabaseRedis : public Module, public Pipe
 		}
 	}
 
+	/* An object that was just read from redis does not need writing back */
+	void Loaded(Serializable *obj)
+	{
+		this->updated_items.erase(obj);
+	}
+
 	void OnNotify() anope_override
 	{
 		for (std::set<Serializable *>::iterator it = this->updated_items.begin(), it_end = this->updated_items.end(); it != it_end; ++it)
@@ -310,7 +346,7 @@ void ObjectLoader::OnResult(const Reply &r)
 		const Reply *key = r.multi_bulk[i],
 			*value = r.multi_bulk[i + 1];
 
-		data[key->bulk] << value->bulk;
+		data.SetString(key->bulk, value->bulk);
 	}
 
 	Serializable* &obj = st->objects[this->id];
@@ -318,7 +354,7 @@ void ObjectLoader::OnResult(const Reply &r)
 	if (obj)
 	{
 		obj->id = this->id;
-		obj->UpdateCache(data);
+		me->Loaded(obj);
 	}
 
 	delete this;
@@ -625,14 +661,14 @@ void ModifiedObject::OnResult(const Reply &r)
 		const Reply *key = r.multi_bulk[i],
 			*value = r.multi_bulk[i + 1];
 
-		data[key->bulk] << value->bulk;
+		data.SetString(key->bulk, value->bulk);
 	}
 
 	obj = st->Unserialize(obj, data);
 	if (obj)
 	{
 		obj->id = this->id;
-		obj->UpdateCache(data);
+		me->Loaded(obj);
 
 		/* Insert new object values */
 		typedef std::map<Anope::string, std::stringstream *> items;
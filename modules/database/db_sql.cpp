@@ -40,19 +40,8 @@ class ResultSQLSQLInterface : public SQLSQLInterface
 public:
 	ResultSQLSQLInterface(Module *o, Serializable *ob) : SQLSQLInterface(o), obj(ob) { }
 
-	void OnResult(const Result &r) anope_override
-	{
-		SQLSQLInterface::OnResult(r);
-		if (r.GetID() > 0 && this->obj)
-			this->obj->id = r.GetID();
-		delete this;
-	}
-
-	void OnError(const Result &r) anope_override
-	{
-		SQLSQLInterface::OnError(r);
-		delete this;
-	}
+	void OnResult(const Result &r) anope_override;
+	void OnError(const Result &r) anope_override;
 };
 
 class DBSQL : public Module, public Pipe
@@ -63,6 +52,8 @@ class DBSQL : public Module, public Pipe
 	bool import;
 
 	std::set<Serializable *> updated_items;
+	/* New objects whose id is not known until their insert finishes */
+	std::set<Serializable *> inserting;
 	bool shutting_down;
 	bool loading_databases;
 	bool loaded;
@@ -98,26 +89,37 @@ class DBSQL : public Module, public Pipe
 			throw ModuleException("db_sql can not be loaded after db_sql_live");
 	}
 
+	void Inserted(Serializable *obj)
+	{
+		this->inserting.erase(obj);
+		/* Write what changed while the insert was running */
+		if (this->updated_items.count(obj))
+			this->Notify();
+	}
+
 	void OnNotify() anope_override
 	{
+		std::set<Serializable *> deferred;
 		for (std::set<Serializable *>::iterator it = this->updated_items.begin(), it_end = this->updated_items.end(); it != it_end; ++it)
 		{
 			Serializable *obj = *it;
 
-			if (this->sql)
+			/* Writing it again without its id would insert it twice */
+			if (this->inserting.count(obj))
 			{
-				Data data;
-				obj->Serialize(data);
-
-				if (obj->IsCached(data))
-					continue;
-
-				obj->UpdateCache(data);
+				deferred.insert(obj);
+				continue;
+			}
 
-				/* If we didn't load these objects and we don't want to import just update the cache and continue */
+			if (this->sql)
+			{
+				/* If we didn't load these objects and we don't want to import just continue */
 				if (!this->loaded && !this->imported && !this->import)
 					continue;
 
+				Data data;
+				obj->Serialize(data);
+
 				Serialize::Type *s_type = obj->GetSerializableType();
 				if (!s_type)
 					continue;
@@ -130,6 +132,8 @@ class DBSQL : public Module, public Pipe
 					for (unsigned i = 0; i < create.size(); ++i)
 						this->RunBackground(create[i]);
 
+					if (!obj->id)
+						this->inserting.insert(obj);
 					this->RunBackground(insert, new ResultSQLSQLInterface(this, obj));
 				}
 				else
@@ -147,7 +151,7 @@ class DBSQL : public Module, public Pipe
 			}
 		}
 
-		this->updated_items.clear();
+		this->updated_items.swap(deferred);
 		this->imported = true;
 	}
 
@@ -205,7 +209,6 @@ class DBSQL : public Module, public Pipe
 	{
 		if (this->shutting_down || this->loading_databases)
 			return;
-		obj->UpdateTS();
 		this->updated_items.insert(obj);
 		this->Notify();
 	}
@@ -218,15 +221,13 @@ class DBSQL : public Module, public Pipe
 		if (s_type && obj->id > 0)
 			this->RunBackground("DELETE FROM `" + this->prefix + s_type->GetName() + "` WHERE `id` = " + stringify(obj->id));
 		this->updated_items.erase(obj);
+		this->inserting.erase(obj);
 	}
 
 	void OnSerializableUpdate(Serializable *obj) anope_override
 	{
-		if (this->shutting_down || obj->IsTSCached())
+		if (this->shutting_down)
 			return;
-		if (obj->id == 0)
-			return; /* object is pending creation */
-		obj->UpdateTS();
 		this->updated_items.insert(obj);
 		this->Notify();
 	}
@@ -245,7 +246,7 @@ class DBSQL : public Module, public Pipe
 
 			const std::map<Anope::string, Anope::string> &row = res.Row(j);
 			for (std::map<Anope::string, Anope::string>::const_iterator rit = row.begin(), rit_end = row.end(); rit != rit_end; ++rit)
-				data[rit->first] << rit->second;
+				data.SetString(rit->first, rit->second);
 
 			Serializable *obj = sb->Unserialize(NULL, data);
 			try
@@ -258,19 +259,29 @@ class DBSQL : public Module, public Pipe
 				Log(this) << "Unable to convert id for object #" << j << " of type " << sb->GetName();
 			}
 
+			/* We know this is the most up to date copy, so don't write it back */
 			if (obj)
-			{
-				/* The Unserialize operation is destructive so rebuild the data for UpdateCache.
-				 * Also the old data may contain columns that we don't use, so we reserialize the
-				 * object to know for sure our cache is consistent
-				 */
-
-				Data data2;
-				obj->Serialize(data2);
-				obj->UpdateCache(data2); /* We know this is the most up to date copy */
-			}
+				this->updated_items.erase(obj);
 		}
 	}
 };
 
+void ResultSQLSQLInterface::OnResult(const Result &r)
+{
+	SQLSQLInterface::OnResult(r);
+	if (r.GetID() > 0 && this->obj)
+		this->obj->id = r.GetID();
+	if (this->obj)
+		anope_dynamic_static_cast<DBSQL *>(this->owner)->Inserted(this->obj);
+	delete this;
+}
+
+void ResultSQLSQLInterface::OnError(const Result &r)
+{
+	SQLSQLInterface::OnError(r);
+	if (this->obj)
+		anope_dynamic_static_cast<DBSQL *>(this->owner)->Inserted(this->obj);
+	delete this;
+}
+
 MODULE_INIT(DBSQL)
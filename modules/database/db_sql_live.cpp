@@ -97,11 +97,6 @@ class DBMySQL : public Module, public Pipe
 				Data data;
 				obj->Serialize(data);
 
-				if (obj->IsCached(data))
-					continue;
-
-				obj->UpdateCache(data);
-
 				Serialize::Type *s_type = obj->GetSerializableType();
 				if (!s_type)
 					continue;
@@ -150,7 +145,6 @@ class DBMySQL : public Module, public Pipe
 	{
 		if (!this->CheckInit())
 			return;
-		obj->UpdateTS();
 		this->updated_items.insert(obj);
 		this->Notify();
 	}
@@ -208,7 +202,7 @@ class DBMySQL : public Module, public Pipe
 				Data data;
 
 				for (std::map<Anope::string, Anope::string>::const_iterator it = row.begin(), it_end = row.end(); it != it_end; ++it)
-					data[it->first] << it->second;
+					data.SetString(it->first, it->second);
 
 				Serializable *s = NULL;
 				std::map<uint64_t, Serializable *>::iterator it = obj->objects.find(id);
@@ -224,14 +218,8 @@ class DBMySQL : public Module, public Pipe
 						new_s->id = id;
 						obj->objects[id] = new_s;
 
-						/* The Unserialize operation is destructive so rebuild the data for UpdateCache.
-						 * Also the old data may contain columns that we don't use, so we reserialize the
-						 * object to know for sure our cache is consistent
-						 */
-
-						Data data2;
-						new_s->Serialize(data2);
-						new_s->UpdateCache(data2); /* We know this is the most up to date copy */
+						/* We know this is the most up to date copy, so don't write it back */
+						this->updated_items.erase(new_s);
 					}
 				}
 				else
@@ -253,9 +241,8 @@ class DBMySQL : public Module, public Pipe
 
 	void OnSerializableUpdate(Serializable *obj) anope_override
 	{
-		if (!this->CheckInit() || obj->IsTSCached())
+		if (!this->CheckInit())
 			return;
-		obj->UpdateTS();
 		this->updated_items.insert(obj);
 		this->Notify();
 	}
@@ -930,7 +930,10 @@ class EBCRYPT : public Module
 			}
 
 			if (ModuleManager::FindFirstOf(ENCRYPTION) != this || (hashrounds && hashrounds != rounds))
+			{
 				Anope::Encrypt(req->GetPassword(), nc->pass);
+				nc->QueueUpdate();
+			}
 			req->Success(this);
 		}
 	}
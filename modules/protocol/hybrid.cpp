@@ -399,7 +399,7 @@ struct IRCDMessageEOB : IRCDMessage
 
 struct IRCDMessageJoin : Message::Join
 {
-	IRCDMessageJoin(Module *creator) : Message::Join(creator, "JOIN") { }
+	IRCDMessageJoin(Module *creator) : Message::Join(creator, "JOIN") { SetFlag(IRCDMESSAGE_PARSED); }
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
@@ -411,6 +411,17 @@ struct IRCDMessageJoin : Message::Join
 
 		Message::Join::Run(source, p);
 	}
+
+	void Run(MessageSource &source, const ParsedMessage &message) anope_override
+	{
+		if (message.params.size() < 2)
+			return;
+
+		ParsedMessage p = message;
+		p.params.erase(p.params.begin());
+
+		Message::Join::Run(source, p);
+	}
 };
 
 struct IRCDMessageMetadata : IRCDMessage
@@ -1601,19 +1601,27 @@ struct IRCDMessageFMode : IRCDMessage
 	IRCDMessageFMode(Module *creator) : IRCDMessage(creator, "FMODE", 3) { SetFlag(IRCDMESSAGE_SOFT_LIMIT); }
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
+	{
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &message) anope_override
 	{
 		/* :source FMODE #test 12345678 +nto foo */
 
-		Anope::string modes = params[2];
-		for (unsigned n = 3; n < params.size(); ++n)
-			modes += " " + params[n];
+		Anope::string modes = message.params[2].str();
+		for (unsigned n = 3; n < message.params.size(); ++n)
+		{
+			modes += ' ';
+			modes.append(message.params[n].data(), message.params[n].length());
+		}
 
-		Channel *c = Channel::Find(params[0]);
+		Channel *c = Channel::Find(message.params[0].str());
 		time_t ts;
 
 		try
 		{
-			ts = convertTo<time_t>(params[1]);
+			ts = convertTo<time_t>(message.params[1].str());
 		}
 		catch (const ConvertException &)
 		{
@@ -1703,13 +1711,23 @@ struct IRCDMessageMode : IRCDMessage
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
-		if (IRCD->IsChannelValid(params[0]))
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &message) anope_override
+	{
+		const Anope::string target = message.params[0].str();
+
+		if (IRCD->IsChannelValid(target))
 		{
-			Channel *c = Channel::Find(params[0]);
+			Channel *c = Channel::Find(target);
 
-			Anope::string modes = params[1];
-			for (unsigned n = 2; n < params.size(); ++n)
-				modes += " " + params[n];
+			Anope::string modes = message.params[1].str();
+			for (unsigned n = 2; n < message.params.size(); ++n)
+			{
+				modes += ' ';
+				modes.append(message.params[n].data(), message.params[n].length());
+			}
 
 			if (c)
 				c->SetModesInternal(source, modes);
@@ -1720,9 +1738,9 @@ struct IRCDMessageMode : IRCDMessage
 			   users modes, we have to kludge this
 			   as it slightly breaks RFC1459
 			 */
-			User *u = User::Find(params[0]);
+			User *u = User::Find(target);
 			if (u)
-				u->SetModesInternal(source, "%s", params[1].c_str());
+				u->SetModesInternal(source, "%s", message.params[1].str().c_str());
 		}
 	}
 };
@@ -1733,7 +1751,12 @@ struct IRCDMessageNick : IRCDMessage
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
-		source.GetUser()->ChangeNick(params[0]);
+		this->Run(source, ParsedMessage(params));
+	}
+
+	void Run(MessageSource &source, const ParsedMessage &message) anope_override
+	{
+		source.GetUser()->ChangeNick(message.params[0].str());
 	}
 };
 
@@ -1761,8 +1784,14 @@ struct IRCDMessagePing : IRCDMessage
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
-		if (params[0] == Me->GetSID())
-			IRCD->SendPong(params[0], source.GetServer()->GetSID());
+		this->Run(source, ParsedMessage(params));
+	}
+
+	/* Sent every few seconds by every server, so answered straight from the read buffer */
+	void Run(MessageSource &source, const ParsedMessage &message) anope_override
+	{
+		if (message.params[0] == Me->GetSID())
+			IRCD->SendPong(Me->GetSID(), source.GetServer()->GetSID());
 	}
 };
 
@@ -254,7 +254,7 @@ struct IRCDMessageChaninfo : IRCDMessage
 
 struct IRCDMessageJoin : Message::Join
 {
-	IRCDMessageJoin(Module *creator) : Message::Join(creator, "JOIN") { SetFlag(IRCDMESSAGE_REQUIRE_USER); }
+	IRCDMessageJoin(Module *creator) : Message::Join(creator, "JOIN") { SetFlag(IRCDMESSAGE_REQUIRE_USER); SetFlag(IRCDMESSAGE_PARSED); }
 
 	/*
 	 * <@po||ux> DukeP: RFC 2813, 4.2.1: the JOIN command on server-server links
@@ -290,6 +290,23 @@ struct IRCDMessageJoin : Message::Join
 				c->SetModesInternal(source, modes);
 		}
 	}
+
+	void Run(MessageSource &source, const ParsedMessage &message) anope_override
+	{
+		size_t pos = message.params[0].find('\7');
+		if (pos == Anope::string_view::npos)
+			return Message::Join::Run(source, message);
+
+		ParsedMessage p = message;
+		p.params.resize(1);
+		p.params[0] = message.params[0].substr(0, pos);
+
+		Message::Join::Run(source, p);
+
+		Channel *c = Channel::Find(p.params[0].str());
+		if (c)
+			c->SetModesInternal(source, "+" + message.params[0].substr(pos + 1).str() + " " + source.GetUser()->nick);
+	}
 };
 
 struct IRCDMessageMetadata : IRCDMessage
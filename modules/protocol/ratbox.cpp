@@ -170,7 +170,7 @@ struct IRCDMessageEncap : IRCDMessage
 
 struct IRCDMessageJoin : Message::Join
 {
-	IRCDMessageJoin(Module *creator) : Message::Join(creator, "JOIN") { }
+	IRCDMessageJoin(Module *creator) : Message::Join(creator, "JOIN") { SetFlag(IRCDMESSAGE_PARSED); }
 
 	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
 	{
@@ -185,6 +185,20 @@ struct IRCDMessageJoin : Message::Join
 
 		return Message::Join::Run(source, p);
 	}
+
+	void Run(MessageSource &source, const ParsedMessage &message) anope_override
+	{
+		if (message.params.size() == 1 && message.params[0] == "0")
+			return Message::Join::Run(source, message);
+
+		if (message.params.size() < 2)
+			return;
+
+		ParsedMessage p = message;
+		p.params.erase(p.params.begin());
+
+		return Message::Join::Run(source, p);
+	}
 };
 
 struct IRCDMessagePass : IRCDMessage
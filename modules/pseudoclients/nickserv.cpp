@@ -177,6 +177,7 @@ class NickServCore : public Module, public NickServService
 			na->last_seen = Anope::CurTime;
 			na->last_usermask = u->GetIdent() + "@" + u->GetDisplayedHost();
 			na->last_realname = u->realname;
+			na->QueueUpdate();
 			return;
 		}
 
@@ -513,6 +514,7 @@ class NickServCore : public Module, public NickServService
 		{
 			na->last_seen = Anope::CurTime;
 			na->last_quit = msg;
+			na->QueueUpdate();
 		}
 	}
 
@@ -530,7 +532,10 @@ class NickServCore : public Module, public NickServService
 
 			User *u = User::Find(na->nick, true);
 			if (u && (u->IsIdentified(true) || u->IsRecognized()))
+			{
 				na->last_seen = Anope::CurTime;
+				na->QueueUpdate();
+			}
 
 			bool expire = false;
 
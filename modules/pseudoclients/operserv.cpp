@@ -44,23 +44,46 @@ class SGLineManager : public XLineManager
 			return x->regex->Matches(uh) || x->regex->Matches(nuhr);
 		}
 
-		if (!x->GetNick().empty() && !Anope::Match(u->nick, x->GetNick()))
+		if (!x->GetNick().empty() && !x->GetCompiledNick().Matches(u->nick))
 			return false;
 
-		if (!x->GetUser().empty() && !Anope::Match(u->GetIdent(), x->GetUser()))
+		if (!x->GetUser().empty() && !x->GetCompiledUser().Matches(u->GetIdent()))
 			return false;
 
-		if (!x->GetReal().empty() && !Anope::Match(u->realname, x->GetReal()))
+		if (!x->GetReal().empty() && !x->GetCompiledReal().Matches(u->realname))
 			return false;
 
 		if (x->c && x->c->match(u->ip))
 			return true;
 
-		if (x->GetHost().empty() || Anope::Match(u->host, x->GetHost()) || Anope::Match(u->ip.addr(), x->GetHost()))
+		if (x->GetHost().empty() || x->GetCompiledHost().Matches(u->host) || x->GetCompiledHost().Matches(u->ip.addr()))
 			return true;
 
 		return false;
 	}
+
+	bool GetIndexMask(const XLine *x, Anope::string &mask) anope_override
+	{
+		if (x->regex || x->GetHost().empty())
+			return false;
+
+		mask = x->GetHost();
+		return true;
+	}
+
+	const sockaddrs *GetIndexKeys(User *u, std::vector<Anope::string> &keys) anope_override
+	{
+		keys.push_back(u->host);
+		keys.push_back(u->ip.addr());
+		return &u->ip;
+	}
+
+	void GetRegexKeys(User *u, std::vector<Anope::string> &keys) anope_override
+	{
+		Anope::string uh = u->GetIdent() + "@" + u->host;
+		keys.push_back(uh);
+		keys.push_back(u->nick + "!" + uh + "#" + u->realname);
+	}
 };
 
 class SQLineManager : public XLineManager
@@ -117,7 +140,27 @@ class SQLineManager : public XLineManager
 	{
 		if (x->regex)
 			return x->regex->Matches(u->nick);
-		return Anope::Match(u->nick, x->mask);
+		return x->GetCompiledMask().Matches(u->nick);
+	}
+
+	bool GetIndexMask(const XLine *x, Anope::string &mask) anope_override
+	{
+		if (x->regex)
+			return false;
+
+		mask = x->mask;
+		return true;
+	}
+
+	const sockaddrs *GetIndexKeys(User *u, std::vector<Anope::string> &keys) anope_override
+	{
+		keys.push_back(u->nick);
+		return NULL;
+	}
+
+	void GetRegexKeys(User *u, std::vector<Anope::string> &keys) anope_override
+	{
+		keys.push_back(u->nick);
 	}
 
 	XLine *CheckChannel(Channel *c)
@@ -181,7 +224,31 @@ class SNLineManager : public XLineManager
 	{
 		if (x->regex)
 			return x->regex->Matches(u->realname);
-		return Anope::Match(u->realname, x->mask, false, true);
+		/* Anope::Match tries compiling the regex again, and matches it as a wildcard mask otherwise */
+		if (x->IsRegex())
+			return Anope::Match(u->realname, x->mask, false, true);
+		return x->GetCompiledMask().Matches(u->realname);
+	}
+
+	bool GetIndexMask(const XLine *x, Anope::string &mask) anope_override
+	{
+		/* Masks wrapped in slashes are matched as a regex by Anope::Match */
+		if (x->regex || (x->mask.length() >= 2 && x->mask[0] == '/' && x->mask[x->mask.length() - 1] == '/'))
+			return false;
+
+		mask = x->mask;
+		return true;
+	}
+
+	const sockaddrs *GetIndexKeys(User *u, std::vector<Anope::string> &keys) anope_override
+	{
+		keys.push_back(u->realname);
+		return NULL;
+	}
+
+	void GetRegexKeys(User *u, std::vector<Anope::string> &keys) anope_override
+	{
+		keys.push_back(u->realname);
 	}
 };
 
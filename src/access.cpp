@@ -59,7 +59,12 @@ static struct
 	{"VOICEME", _("Allowed to (de)voice him/herself")}
 };
 
-Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : name(n), desc(d), rank(r)
+/* Ids of every privilege name seen so far. Ids are never reused, so a
+ * privilege keeps its id when it is registered again on rehash.
+ */
+static Anope::hash_map<unsigned> privilege_ids;
+
+Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : name(n), desc(d), rank(r), id(PrivilegeManager::GetPrivilegeId(n))
 {
 	if (this->desc.empty())
 		for (unsigned j = 0; j < sizeof(descriptions) / sizeof(*descriptions); ++j)
@@ -69,10 +74,22 @@ Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : na
 
 bool Privilege::operator==(const Privilege &other) const
 {
-	return this->name.equals_ci(other.name);
+	return this->id == other.id;
 }
 
 std::vector<Privilege> PrivilegeManager::Privileges;
+std::vector<Privilege *> PrivilegeManager::PrivilegesById;
+uint64_t PrivilegeManager::generation = 1;
+
+void PrivilegeManager::Reindex()
+{
+	PrivilegesById.assign(privilege_ids.size(), NULL);
+	/* Later privileges win, like FindPrivilege always did */
+	for (unsigned i = 0; i < Privileges.size(); ++i)
+		PrivilegesById[Privileges[i].id] = &Privileges[i];
+
+	Recompile();
+}
 
 void PrivilegeManager::AddPrivilege(Privilege p)
 {
@@ -86,6 +103,7 @@ void PrivilegeManager::AddPrivilege(Privilege p)
 	}
 
 	Privileges.insert(Privileges.begin() + i, p);
+	Reindex();
 }
 
 void PrivilegeManager::RemovePrivilege(Privilege &p)
@@ -93,20 +111,18 @@ void PrivilegeManager::RemovePrivilege(Privilege &p)
 	std::vector<Privilege>::iterator it = std::find(Privileges.begin(), Privileges.end(), p);
 	if (it != Privileges.end())
 		Privileges.erase(it);
+	Reindex();
 
 	for (registered_channel_map::const_iterator cit = RegisteredChannelList->begin(), cit_end = RegisteredChannelList->end(); cit != cit_end; ++cit)
-	{
-		cit->second->QueueUpdate();
 		cit->second->RemoveLevel(p.name);
-	}
 }
 
 Privilege *PrivilegeManager::FindPrivilege(const Anope::string &name)
 {
-	for (unsigned i = Privileges.size(); i > 0; --i)
-		if (Privileges[i - 1].name.equals_ci(name))
-			return &Privileges[i - 1];
-	return NULL;
+	Anope::hash_map<unsigned>::const_iterator it = privilege_ids.find(name);
+	if (it == privilege_ids.end() || it->second >= PrivilegesById.size())
+		return NULL;
+	return PrivilegesById[it->second];
 }
 
 std::vector<Privilege> &PrivilegeManager::GetPrivileges()
@@ -117,6 +133,25 @@ std::vector<Privilege> &PrivilegeManager::GetPrivileges()
 void PrivilegeManager::ClearPrivileges()
 {
 	Privileges.clear();
+	Reindex();
+}
+
+unsigned PrivilegeManager::GetPrivilegeId(const Anope::string &name)
+{
+	std::pair<Anope::hash_map<unsigned>::iterator, bool> it = privilege_ids.insert(std::make_pair(name, 0));
+	if (it.second)
+		it.first->second = privilege_ids.size() - 1;
+	return it.first->second;
+}
+
+unsigned PrivilegeManager::GetPrivilegeIdCount()
+{
+	return privilege_ids.size();
+}
+
+void PrivilegeManager::Recompile()
+{
+	++generation;
 }
 
 AccessProvider::AccessProvider(Module *o, const Anope::string &n) : Service(o, "AccessProvider", n)
@@ -138,12 +173,17 @@ const std::list<AccessProvider *>& AccessProvider::GetProviders()
 	return Providers;
 }
 
-ChanAccess::ChanAccess(AccessProvider *p) : Serializable("ChanAccess"), provider(p)
+uint64_t AccessCache::last_generation = 0, AccessCache::generation = 0;
+unsigned long AccessCache::hits = 0, AccessCache::misses = 0;
+
+ChanAccess::ChanAccess(AccessProvider *p) : Serializable("ChanAccess"), privs_generation(0), privs_levels_generation(0), provider(p)
 {
 }
 
 ChanAccess::~ChanAccess()
 {
+	AccessCache::Invalidate();
+
 	if (this->ci)
 	{
 		std::vector<ChanAccess *>::iterator it = std::find(this->ci->access->begin(), this->ci->access->end(), this);
@@ -163,6 +203,8 @@ ChanAccess::~ChanAccess()
 
 void ChanAccess::SetMask(const Anope::string &m, ChannelInfo *c)
 {
+	AccessCache::Invalidate();
+
 	if (*nc != NULL)
 		nc->RemoveChannelReference(this->ci);
 	else if (!this->mask.empty())
@@ -174,7 +216,10 @@ void ChanAccess::SetMask(const Anope::string &m, ChannelInfo *c)
 
 	ci = c;
 	mask.clear();
+	compiled_mask = Anope::CompiledMask();
 	nc = NULL;
+	/* Privileges may depend on the channel's levels */
+	privs_generation = 0;
 
 	const NickAlias *na = NickAlias::Find(m);
 	if (na != NULL)
@@ -185,11 +230,14 @@ void ChanAccess::SetMask(const Anope::string &m, ChannelInfo *c)
 	else
 	{
 		mask = m;
+		compiled_mask = Anope::CompiledMask(mask);
 
 		ChannelInfo *targci = ChannelInfo::Find(mask);
 		if (targci != NULL)
 			targci->AddChannelReference(ci->name);
 	}
+
+	this->QueueUpdate();
 }
 
 const Anope::string &ChanAccess::Mask() const
@@ -205,23 +253,42 @@ NickCore *ChanAccess::GetAccount() const
 	return nc;
 }
 
+bool ChanAccess::HasCompiledPriv(const Privilege &priv) const
+{
+	/* Entries may have privileges depending on their channel's levels */
+	const ChannelInfo *chan = this->ci;
+	uint64_t levels_generation = chan ? chan->GetLevelsGeneration() : 0;
+
+	if (this->privs_generation != PrivilegeManager::GetGeneration() || this->privs_levels_generation != levels_generation)
+	{
+		const std::vector<Privilege> &privileges = PrivilegeManager::GetPrivileges();
+
+		this->compiled_privs.assign(PrivilegeManager::GetPrivilegeIdCount(), false);
+		for (unsigned i = 0; i < privileges.size(); ++i)
+			if (this->HasPriv(privileges[i].name))
+				this->compiled_privs[privileges[i].id] = true;
+
+		this->privs_generation = PrivilegeManager::GetGeneration();
+		this->privs_levels_generation = levels_generation;
+	}
+
+	return priv.id < this->compiled_privs.size() && this->compiled_privs[priv.id];
+}
+
 void ChanAccess::Serialize(Serialize::Data &data) const
 {
-	data["provider"] << this->provider->name;
-	data["ci"] << this->ci->name;
-	data["mask"] << this->Mask();
-	data["creator"] << this->creator;
-	data.SetType("last_seen", Serialize::Data::DT_INT); data["last_seen"] << this->last_seen;
-	data.SetType("created", Serialize::Data::DT_INT); data["created"] << this->created;
-	data["data"] << this->AccessSerialize();
+	data.SetString("provider", this->provider->name);
+	data.SetString("ci", this->ci->name);
+	data.SetString("mask", this->Mask());
+	data.SetString("creator", this->creator);
+	data.SetType("last_seen", Serialize::Data::DT_INT); data.SetInt("last_seen", this->last_seen);
+	data.SetType("created", Serialize::Data::DT_INT); data.SetInt("created", this->created);
+	data.SetString("data", this->AccessSerialize());
 }
 
 Serializable* ChanAccess::Unserialize(Serializable *obj, Serialize::Data &data)
 {
-	Anope::string provider, chan;
-
-	data["provider"] >> provider;
-	data["ci"] >> chan;
+	Anope::string provider = data.GetString("provider"), chan = data.GetString("ci");
 
 	ServiceReference<AccessProvider> aprovider("AccessProvider", provider);
 	ChannelInfo *ci = ChannelInfo::Find(chan);
@@ -234,16 +301,12 @@ Serializable* ChanAccess::Unserialize(Serializable *obj, Serialize::Data &data)
 	else
 		access = aprovider->Create();
 	access->ci = ci;
-	Anope::string m;
-	data["mask"] >> m;
-	access->SetMask(m, ci);
-	data["creator"] >> access->creator;
-	data["last_seen"] >> access->last_seen;
-	data["created"] >> access->created;
-
-	Anope::string adata;
-	data["data"] >> adata;
-	access->AccessUnserialize(adata);
+	access->SetMask(data.GetString("mask"), ci);
+	access->creator = data.GetString("creator");
+	access->last_seen = data.GetInt("last_seen", access->last_seen);
+	access->created = data.GetInt("created", access->created);
+	access->AccessUnserialize(data.GetString("data"));
+	access->privs_generation = 0;
 
 	if (!obj)
 		ci->AddAccess(access);
@@ -260,9 +323,9 @@ bool ChanAccess::Matches(const User *u, const NickCore *acc, ChannelInfo* &next)
 	if (u)
 	{
 		bool is_mask = this->mask.find_first_of("!@?*") != Anope::string::npos;
-		if (is_mask && Anope::Match(u->nick, this->mask))
+		if (is_mask && this->compiled_mask.Matches(u->nick))
 			return true;
-		else if (Anope::Match(u->GetDisplayedMask(), this->mask))
+		else if (this->compiled_mask.Matches(u->GetDisplayedMask()))
 			return true;
 	}
 
@@ -271,7 +334,7 @@ bool ChanAccess::Matches(const User *u, const NickCore *acc, ChannelInfo* &next)
 		for (unsigned i = 0; i < acc->aliases->size(); ++i)
 		{
 			const NickAlias *na = acc->aliases->at(i);
-			if (Anope::Match(na->nick, this->mask))
+			if (this->compiled_mask.Matches(na->nick))
 				return true;
 		}
 	}
@@ -289,8 +352,8 @@ bool ChanAccess::operator>(const ChanAccess &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasCompiledPriv(privs[i - 1]),
+			other_p = other.HasCompiledPriv(privs[i - 1]);
 
 		if (!this_p && !other_p)
 			continue;
@@ -306,8 +369,8 @@ bool ChanAccess::operator<(const ChanAccess &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasCompiledPriv(privs[i - 1]),
+			other_p = other.HasCompiledPriv(privs[i - 1]);
 
 		if (!this_p && !other_p)
 			continue;
@@ -335,7 +398,7 @@ AccessGroup::AccessGroup()
 	this->super_admin = this->founder = false;
 }
 
-static bool HasPriv(const ChanAccess::Path &path, const Anope::string &name)
+static bool HasPriv(const ChanAccess::Path &path, const Privilege &priv)
 {
 	if (path.empty())
 		return false;
@@ -345,9 +408,9 @@ static bool HasPriv(const ChanAccess::Path &path, const Anope::string &name)
 		ChanAccess *access = path[i];
 
 		EventReturn MOD_RESULT;
-		FOREACH_RESULT(OnCheckPriv, MOD_RESULT, (access, name));
+		FOREACH_RESULT(OnCheckPriv, MOD_RESULT, (access, priv.name));
 
-		if (MOD_RESULT != EVENT_ALLOW && !access->HasPriv(name))
+		if (MOD_RESULT != EVENT_ALLOW && !access->HasCompiledPriv(priv))
 			return false;
 	}
 
@@ -358,20 +421,37 @@ bool AccessGroup::HasPriv(const Anope::string &name) const
 {
 	if (this->super_admin)
 		return true;
-	else if (!ci || ci->GetLevel(name) == ACCESS_INVALID)
+	else if (!ci)
+		return false;
+
+	const Privilege *priv = PrivilegeManager::FindPrivilege(name);
+	if (priv == NULL)
+	{
+		Log(LOG_DEBUG) << "Unknown privilege " + name;
+		return false;
+	}
+
+	return this->HasPriv(*priv);
+}
+
+bool AccessGroup::HasPriv(const Privilege &priv) const
+{
+	if (this->super_admin)
+		return true;
+	else if (!ci || ci->GetLevel(priv) == ACCESS_INVALID)
 		return false;
 
 	/* Privileges prefixed with auto are understood to be given
 	 * automatically. Sometimes founders want to not automatically
 	 * obtain privileges, so we will let them */
-	bool auto_mode = !name.find("AUTO");
+	bool auto_mode = !priv.name.find("AUTO");
 
 	/* Only grant founder privilege if this isn't an auto mode or if they don't match any entries in this group */
 	if ((!auto_mode || paths.empty()) && this->founder)
 		return true;
 
 	EventReturn MOD_RESULT;
-	FOREACH_RESULT(OnGroupCheckPriv, MOD_RESULT, (this, name));
+	FOREACH_RESULT(OnGroupCheckPriv, MOD_RESULT, (this, priv.name));
 	if (MOD_RESULT != EVENT_CONTINUE)
 		return MOD_RESULT == EVENT_ALLOW;
 
@@ -379,7 +459,7 @@ bool AccessGroup::HasPriv(const Anope::string &name) const
 	{
 		const ChanAccess::Path &path = paths[i - 1];
 
-		if (::HasPriv(path, name))
+		if (::HasPriv(path, priv))
 			return true;
 	}
 
@@ -426,8 +506,8 @@ bool AccessGroup::operator>(const AccessGroup &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPriv(privs[i - 1]),
+			other_p = other.HasPriv(privs[i - 1]);
 
 		if (!this_p && !other_p)
 			continue;
@@ -452,8 +532,8 @@ bool AccessGroup::operator<(const AccessGroup &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPriv(privs[i - 1]),
+			other_p = other.HasPriv(privs[i - 1]);
 
 		if (!this_p && !other_p)
 			continue;
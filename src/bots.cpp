@@ -75,24 +75,19 @@ BotInfo::~BotInfo()
 
 void BotInfo::Serialize(Serialize::Data &data) const
 {
-	data["nick"] << this->nick;
-	data["user"] << this->ident;
-	data["host"] << this->host;
-	data["realname"] << this->realname;
-	data["created"] << this->created;
-	data["oper_only"] << this->oper_only;
+	data.SetString("nick", this->nick);
+	data.SetString("user", this->ident);
+	data.SetString("host", this->host);
+	data.SetString("realname", this->realname);
+	data.SetInt("created", this->created);
+	data.SetInt("oper_only", this->oper_only);
 
 	Extensible::ExtensibleSerialize(this, this, data);
 }
 
 Serializable* BotInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 {
-	Anope::string nick, user, host, realname, flags;
-
-	data["nick"] >> nick;
-	data["user"] >> user;
-	data["host"] >> host;
-	data["realname"] >> realname;
+	Anope::string nick = data.GetString("nick"), user = data.GetString("user"), host = data.GetString("host"), realname = data.GetString("realname");
 
 	BotInfo *bi;
 	if (obj)
@@ -100,8 +95,8 @@ Serializable* BotInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 	else if (!(bi = BotInfo::Find(nick, true)))
 		bi = new BotInfo(nick, user, host, realname);
 
-	data["created"] >> bi->created;
-	data["oper_only"] >> bi->oper_only;
+	bi->created = data.GetInt("created", bi->created);
+	bi->oper_only = data.GetInt("oper_only", bi->oper_only) != 0;
 
 	Extensible::ExtensibleUnserialize(bi, bi, data);
 
@@ -144,6 +139,11 @@ void BotInfo::SetNewNick(const Anope::string &newnick)
 
 	UserListByNick[this->nick] = this;
 	(*BotListByNick)[this->nick] = this;
+
+	/* The channels this bot is assigned to serialize its nick */
+	this->QueueUpdate();
+	for (std::set<ChannelInfo *>::iterator it = this->channels->begin(), it_end = this->channels->end(); it != it_end; ++it)
+		(*it)->QueueUpdate();
 }
 
 const std::set<ChannelInfo *> &BotInfo::GetChannels() const
@@ -162,6 +162,7 @@ void BotInfo::Assign(User *u, ChannelInfo *ci)
 		ci->bi->UnAssign(u, ci);
 
 	ci->bi = this;
+	ci->QueueUpdate();
 	this->channels->insert(ci);
 
 	FOREACH_MOD(OnBotAssign, (u, ci, this));
@@ -183,6 +184,7 @@ void BotInfo::UnAssign(User *u, ChannelInfo *ci)
 	}
 
 	ci->bi = NULL;
+	ci->QueueUpdate();
 	this->channels->erase(ci);
 }
 
@@ -255,11 +257,7 @@ BotInfo* BotInfo::Find(const Anope::string &nick, bool nick_only)
 	{
 		botinfo_map::iterator it = BotListByUID->find(nick);
 		if (it != BotListByUID->end())
-		{
-			BotInfo *bi = it->second;
-			bi->QueueUpdate();
-			return bi;
-		}
+			return it->second;
 
 		if (IRCD->AmbiguousID)
 			return NULL;
@@ -267,11 +265,7 @@ BotInfo* BotInfo::Find(const Anope::string &nick, bool nick_only)
 
 	botinfo_map::iterator it = BotListByNick->find(nick);
 	if (it != BotListByNick->end())
-	{
-		BotInfo *bi = it->second;
-		bi->QueueUpdate();
-		return bi;
-	}
+		return it->second;
 
 	return NULL;
 }
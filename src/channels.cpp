@@ -70,6 +70,7 @@ Channel::~Channel()
 void Channel::Reset()
 {
 	this->modes.clear();
+	this->list_entries.clear();
 
 	for (ChanUserList::const_iterator it = this->users.begin(), it_end = this->users.end(); it != it_end; ++it)
 	{
@@ -160,6 +161,9 @@ void Channel::DeleteUser(User *user)
 
 	FOREACH_MOD(OnLeaveChannel, (user, this));
 
+	if (this->ci)
+		this->ci->ForgetAccess(user);
+
 	ChanUserContainer *cu = user->FindChannel(this);
 	if (!this->users.erase(user))
 		Log(LOG_DEBUG) << "Channel::DeleteUser() tried to delete nonexistent user " << user->nick << " from channel " << this->name;
@@ -303,6 +307,8 @@ void Channel::SetModeInternal(MessageSource &setter, ChannelMode *ocm, const Ano
 		this->modes.erase(cm->name);
 	else if (this->HasMode(cm->name, param))
 		return;
+	else
+		this->list_entries.erase(cm->name);
 
 	this->modes.insert(std::make_pair(cm->name, param));
 
@@ -376,6 +382,7 @@ void Channel::RemoveModeInternal(MessageSource &setter, ChannelMode *ocm, const
 			if (param.equals_ci(it->second))
 			{
 				this->modes.erase(it);
+				this->list_entries.erase(cm->name);
 				break;
 			}
 	}
@@ -728,14 +735,20 @@ bool Channel::MatchesList(User *u, const Anope::string &mode)
 	if (!this->HasMode(mode))
 		return false;
 
-	std::vector<Anope::string> v = this->GetModeList(mode);
-	for (unsigned i = 0; i < v.size(); ++i)
+	std::map<Anope::string, std::vector<Entry> >::iterator it = this->list_entries.find(mode);
+	if (it == this->list_entries.end())
 	{
-		Entry e(mode, v[i]);
-		if (e.Matches(u))
-			return true;
+		it = this->list_entries.insert(std::make_pair(mode, std::vector<Entry>())).first;
+
+		std::vector<Anope::string> v = this->GetModeList(mode);
+		for (unsigned i = 0; i < v.size(); ++i)
+			it->second.push_back(Entry(mode, v[i]));
 	}
 
+	for (unsigned i = 0; i < it->second.size(); ++i)
+		if (it->second[i].Matches(u))
+			return true;
+
 	return false;
 }
 
@@ -199,7 +199,6 @@ Conf::Conf() : Block("")
 		this->DefPrivmsg = std::find(defaults.begin(), defaults.end(), "msg") != defaults.end();
 	}
 	this->DefLanguage = options->Get<const Anope::string>("defaultlanguage");
-	this->TimeoutCheck = options->Get<time_t>("timeoutcheck");
 	this->NickChars = networkinfo->Get<Anope::string>("nick_chars");
 
 	for (int i = 0; i < this->CountBlock("uplink"); ++i)
@@ -565,6 +564,10 @@ void Conf::Post(Conf *old)
 		if (std::find(old->ModulesAutoLoad.begin(), old->ModulesAutoLoad.end(), this->ModulesAutoLoad[i]) == old->ModulesAutoLoad.end())
 			ModuleManager::LoadModule(this->ModulesAutoLoad[i], NULL);
 
+	/* Regexes cached by Anope::Match were compiled with the old regex engine */
+	if (this->GetBlock("options")->Get<const Anope::string>("regexengine") != old->GetBlock("options")->Get<const Anope::string>("regexengine"))
+		Anope::CompiledMask::ClearCache();
+
 	/* Apply opertype changes, as non-conf opers still point to the old oper types */
 	for (unsigned i = Oper::opers.size(); i > 0; --i)
 	{
@@ -20,6 +20,13 @@ ExtensibleBase::~ExtensibleBase()
 	extensible_items.erase(this);
 }
 
+void ExtensibleBase::Changed(Extensible *obj)
+{
+	Serializable *s = dynamic_cast<Serializable *>(obj);
+	if (s)
+		s->QueueUpdate();
+}
+
 Extensible::~Extensible()
 {
 	UnsetExtensibles();
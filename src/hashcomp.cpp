@@ -9,6 +9,7 @@
 #include "services.h"
 #include "hashcomp.h"
 #include "anope.h"
+#include "access.h"
 
 /* Case map in use by Anope */
 std::locale Anope::casemap = std::locale(std::locale(), new Anope::ascii_ctype<char>());
@@ -25,6 +26,9 @@ void Anope::CaseMapRebuild()
 		case_map_upper[i] = ct.toupper(i);
 		case_map_lower[i] = ct.tolower(i);
 	}
+
+	Anope::CompiledMask::ClearCache();
+	AccessCache::Invalidate();
 }
 
 unsigned char Anope::tolower(unsigned char c)
@@ -37,6 +41,49 @@ unsigned char Anope::toupper(unsigned char c)
 	return case_map_upper[c];
 }
 
+size_t Anope::hash_ci::operator()(const Anope::string &s) const
+{
+	return Hash(s.data(), s.length());
+}
+
+size_t Anope::hash_ci::Hash(const char *s, size_t len)
+{
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(s);
+
+	/* FNV-1a, folding and mixing eight characters at a time */
+	uint64_t hash = 14695981039346656037ULL;
+	for (; len >= 8; p += 8, len -= 8)
+	{
+		uint64_t word = 0;
+		for (unsigned i = 0; i < 8; ++i)
+			word |= static_cast<uint64_t>(case_map_lower[p[i]]) << (i * 8);
+		hash = (hash ^ word) * 1099511628211ULL;
+		hash ^= hash >> 32;
+	}
+	for (; len; ++p, --len)
+		hash = (hash ^ case_map_lower[*p]) * 1099511628211ULL;
+
+	return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+bool Anope::compare::operator()(const Anope::string &s1, const Anope::string &s2) const
+{
+	return s1.length() == s2.length() && Equals(s1.data(), s2.data(), s1.length());
+}
+
+bool Anope::compare::Equals(const char *s1, const char *s2, size_t len)
+{
+	/* Lookups are usually made with the same case the key was stored with */
+	if (!memcmp(s1, s2, len))
+		return true;
+
+	const unsigned char *p1 = reinterpret_cast<const unsigned char *>(s1), *p2 = reinterpret_cast<const unsigned char *>(s2);
+	for (size_t i = 0; i < len; ++i)
+		if (case_map_lower[p1[i]] != case_map_lower[p2[i]])
+			return false;
+	return true;
+}
+
 /*
  *
  * This is an implementation of a special string class, ci::string,
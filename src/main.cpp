@@ -155,7 +155,6 @@ int main(int ac, char **av, char **envp)
 	}
 
 	/* Set up timers */
-	time_t last_check = Anope::CurTime;
 	UpdateTimer updateTimer(Config->GetBlock("options")->Get<time_t>("updatetimeout", "5m"));
 	ExpireTimer expireTimer(Config->GetBlock("options")->Get<time_t>("expiretimeout", "30m"));
 
@@ -164,12 +163,11 @@ int main(int ac, char **av, char **envp)
 	{
 		Log(LOG_DEBUG_2) << "Top of main loop";
 
-		/* Process timers */
-		if (Anope::CurTime - last_check >= Config->TimeoutCheck)
-		{
-			TimerManager::TickTimers(Anope::CurTime);
-			last_check = Anope::CurTime;
-		}
+		/* Process timers, the socket engine wakes up in time for the next one */
+		TimerManager::TickTimers(Anope::CurTime);
+
+		/* Hand what changed to the database modules */
+		Serialize::FlushUpdates();
 
 		/* Process the socket engine */
 		SocketEngine::Process();
@@ -178,6 +176,8 @@ int main(int ac, char **av, char **envp)
 			Anope::HandleSignal();
 	}
 
+	Serialize::FlushUpdates();
+
 	if (Anope::Restarting)
 	{
 		FOREACH_MOD(OnRestart, ());
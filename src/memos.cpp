@@ -36,19 +36,17 @@ Memo::~Memo()
 
 void Memo::Serialize(Serialize::Data &data) const
 {
-	data["owner"] << this->owner;
-	data.SetType("time", Serialize::Data::DT_INT); data["time"] << this->time;
-	data["sender"] << this->sender;
-	data["text"] << this->text;
-	data["unread"] << this->unread;
-	data["receipt"] << this->receipt;
+	data.SetString("owner", this->owner);
+	data.SetType("time", Serialize::Data::DT_INT); data.SetInt("time", this->time);
+	data.SetString("sender", this->sender);
+	data.SetString("text", this->text);
+	data.SetInt("unread", this->unread);
+	data.SetInt("receipt", this->receipt);
 }
 
 Serializable* Memo::Unserialize(Serializable *obj, Serialize::Data &data)
 {
-	Anope::string owner;
-
-	data["owner"] >> owner;
+	Anope::string owner = data.GetString("owner");
 
 	bool ischan;
 	MemoInfo *mi = MemoInfo::GetMemoInfo(owner, ischan);
@@ -65,11 +63,11 @@ Serializable* Memo::Unserialize(Serializable *obj, Serialize::Data &data)
 	}
 
 	m->owner = owner;
-	data["time"] >> m->time;
-	data["sender"] >> m->sender;
-	data["text"] >> m->text;
-	data["unread"] >> m->unread;
-	data["receipt"] >> m->receipt;
+	m->time = data.GetInt("time", m->time);
+	m->sender = data.GetString("sender");
+	m->text = data.GetString("text");
+	m->unread = data.GetInt("unread", m->unread) != 0;
+	m->receipt = data.GetInt("receipt", m->receipt) != 0;
 
 	if (obj == NULL)
 		mi->memos->push_back(m);
@@ -84,9 +82,7 @@ Memo *MemoInfo::GetMemo(unsigned index) const
 {
 	if (index >= this->memos->size())
 		return NULL;
-	Memo *m = (*memos)[index];
-	m->QueueUpdate();
-	return m;
+	return (*memos)[index];
 }
 
 unsigned MemoInfo::GetIndex(Memo *m) const
@@ -20,8 +20,19 @@
 #include "servers.h"
 #include "channels.h"
 
+#include <typeinfo>
+
 using namespace Message;
 
+/* Whether the ParsedMessage overload of a core handler may handle a message
+ * itself. Subclasses which only override the vector Run() must still have
+ * it called, so they get the copying IRCDMessage::Run() unless they opt in.
+ */
+template<typename T> static bool UseParsed(const T *m)
+{
+	return typeid(*m) == typeid(T) || m->HasFlag(IRCDMESSAGE_PARSED);
+}
+
 void Away::Run(MessageSource &source, const std::vector<Anope::string> &params)
 {
 	const Anope::string &msg = !params.empty() ? params[0] : "";
@@ -65,18 +76,21 @@ void Invite::Run(MessageSource &source, const std::vector<Anope::string> &params
 	FOREACH_MOD(OnInvite, (source.GetUser(), c, targ));
 }
 
-void Join::Run(MessageSource &source, const std::vector<Anope::string> &params)
+static void RunJoin(MessageSource &source, const ParsedMessage &message)
 {
 	User *user = source.GetUser();
-	const Anope::string &channels = params[0];
-
-	Anope::string channel;
-	commasepstream sep(channels);
+	Anope::string_view channels = message.params[0];
 
-	while (sep.GetToken(channel))
+	while (!channels.empty())
 	{
+		size_t comma = channels.find(',');
+		Anope::string_view token = channels.substr(0, comma);
+		channels.remove_prefix(comma == Anope::string_view::npos ? channels.length() : comma + 1);
+		if (token.empty())
+			continue;
+
 		/* Special case for /join 0 */
-		if (channel == "0")
+		if (token == "0")
 		{
 			for (User::ChanUserList::iterator it = user->chans.begin(), it_end = user->chans.end(); it != it_end; )
 			{
@@ -91,14 +105,28 @@ void Join::Run(MessageSource &source, const std::vector<Anope::string> &params)
 			continue;
 		}
 
-		std::list<SJoinUser> users;
+		std::list<Join::SJoinUser> users;
 		users.push_back(std::make_pair(ChannelStatus(), user));
 
+		Anope::string channel = token.str();
 		Channel *chan = Channel::Find(channel);
-		SJoin(source, channel, chan ? chan->creation_time : Anope::CurTime, "", users);
+		Join::SJoin(source, channel, chan ? chan->creation_time : Anope::CurTime, "", users);
 	}
 }
 
+void Join::Run(MessageSource &source, const std::vector<Anope::string> &params)
+{
+	RunJoin(source, ParsedMessage(params));
+}
+
+void Join::Run(MessageSource &source, const ParsedMessage &message)
+{
+	if (UseParsed(this))
+		RunJoin(source, message);
+	else
+		IRCDMessage::Run(source, message);
+}
+
 void Join::SJoin(MessageSource &source, const Anope::string &chan, time_t ts, const Anope::string &modes, const std::list<SJoinUser> &users)
 {
 	bool created;
@@ -273,17 +301,21 @@ void Notice::Run(MessageSource &source, const std::vector<Anope::string> &params
 	}
 }
 
-void Part::Run(MessageSource &source, const std::vector<Anope::string> &params)
+static void RunPart(MessageSource &source, const ParsedMessage &message)
 {
 	User *u = source.GetUser();
-	const Anope::string &reason = params.size() > 1 ? params[1] : "";
+	const Anope::string reason = message.params.size() > 1 ? message.params[1].str() : "";
 
-	Anope::string channel;
-	commasepstream sep(params[0]);
-
-	while (sep.GetToken(channel))
+	Anope::string_view channels = message.params[0];
+	while (!channels.empty())
 	{
-		Channel *c = Channel::Find(channel);
+		size_t comma = channels.find(',');
+		Anope::string_view token = channels.substr(0, comma);
+		channels.remove_prefix(comma == Anope::string_view::npos ? channels.length() : comma + 1);
+		if (token.empty())
+			continue;
+
+		Channel *c = Channel::Find(token.str());
 
 		if (!c || !u->FindChannel(c))
 			continue;
@@ -295,15 +327,41 @@ void Part::Run(MessageSource &source, const std::vector<Anope::string> &params)
 	}
 }
 
+void Part::Run(MessageSource &source, const std::vector<Anope::string> &params)
+{
+	RunPart(source, ParsedMessage(params));
+}
+
+void Part::Run(MessageSource &source, const ParsedMessage &message)
+{
+	if (UseParsed(this))
+		RunPart(source, message);
+	else
+		IRCDMessage::Run(source, message);
+}
+
+static void RunPing(MessageSource &source, const ParsedMessage &message)
+{
+	IRCD->SendPong(message.params.size() > 1 ? message.params[1].str() : Me->GetSID(), message.params[0].str());
+}
+
 void Ping::Run(MessageSource &source, const std::vector<Anope::string> &params)
 {
-	IRCD->SendPong(params.size() > 1 ? params[1] : Me->GetSID(), params[0]);
+	RunPing(source, ParsedMessage(params));
 }
 
-void Privmsg::Run(MessageSource &source, const std::vector<Anope::string> &params)
+void Ping::Run(MessageSource &source, const ParsedMessage &message)
 {
-	const Anope::string &receiver = params[0];
-	Anope::string message = params[1];
+	if (UseParsed(this))
+		RunPing(source, message);
+	else
+		IRCDMessage::Run(source, message);
+}
+
+static void RunPrivmsg(MessageSource &source, const ParsedMessage &parsed)
+{
+	const Anope::string receiver = parsed.params[0].str();
+	Anope::string message = parsed.params[1].str();
 
 	User *u = source.GetUser();
 
@@ -373,9 +431,22 @@ void Privmsg::Run(MessageSource &source, const std::vector<Anope::string> &param
 	return;
 }
 
-void Quit::Run(MessageSource &source, const std::vector<Anope::string> &params)
+void Privmsg::Run(MessageSource &source, const std::vector<Anope::string> &params)
 {
-	const Anope::string &reason = params[0];
+	RunPrivmsg(source, ParsedMessage(params));
+}
+
+void Privmsg::Run(MessageSource &source, const ParsedMessage &message)
+{
+	if (UseParsed(this))
+		RunPrivmsg(source, message);
+	else
+		IRCDMessage::Run(source, message);
+}
+
+static void RunQuit(MessageSource &source, const ParsedMessage &message)
+{
+	const Anope::string reason = message.params[0].str();
 	User *user = source.GetUser();
 
 	Log(user, "quit") << "quit (Reason: " << (!reason.empty() ? reason : "no reason") << ")";
@@ -383,6 +454,19 @@ void Quit::Run(MessageSource &source, const std::vector<Anope::string> &params)
 	user->Quit(reason);
 }
 
+void Quit::Run(MessageSource &source, const std::vector<Anope::string> &params)
+{
+	RunQuit(source, ParsedMessage(params));
+}
+
+void Quit::Run(MessageSource &source, const ParsedMessage &message)
+{
+	if (UseParsed(this))
+		RunQuit(source, message);
+	else
+		IRCDMessage::Run(source, message);
+}
+
 void SQuit::Run(MessageSource &source, const std::vector<Anope::string> &params)
 {
 	Server *s = Server::Find(params[0]);
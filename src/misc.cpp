@@ -403,38 +403,215 @@ Anope::string Anope::Expires(time_t expires, const NickCore *nc)
 	}
 }
 
+namespace
+{
+	/* A cache which forgets the least recently used value when it is full.
+	 * Values are owned by the cache.
+	 */
+	template<typename T> class LRUCache
+	{
+		typedef std::list<std::pair<std::string, T *> > list_type;
+		list_type entries;
+		TR1NS::unordered_map<std::string, typename list_type::iterator> index;
+		size_t count;
+
+	 public:
+		LRUCache() : count(0) { }
+
+		T *Find(const std::string &key)
+		{
+			typename TR1NS::unordered_map<std::string, typename list_type::iterator>::iterator it = index.find(key);
+			if (it == index.end())
+				return NULL;
+
+			entries.splice(entries.begin(), entries, it->second);
+			return it->second->second;
+		}
+
+		void Insert(const std::string &key, T *value, size_t max)
+		{
+			for (; count && count >= max; --count)
+			{
+				index.erase(entries.back().first);
+				delete entries.back().second;
+				entries.pop_back();
+			}
+
+			entries.push_front(std::make_pair(key, value));
+			index[key] = entries.begin();
+			++count;
+		}
+
+		void Clear()
+		{
+			for (typename list_type::iterator it = entries.begin(); it != entries.end(); ++it)
+				delete it->second;
+			entries.clear();
+			index.clear();
+			count = 0;
+		}
+	};
+
+	LRUCache<Regex> regex_cache;
+}
+
+unsigned Anope::CompiledMask::casemaps = 0;
+
+Anope::CompiledMask::CompiledMask(const Anope::string &m, bool cs) : mask(m), case_sensitive(cs)
+{
+	this->Compile();
+}
+
+void Anope::CompiledMask::Compile() const
+{
+	const Anope::string &m = this->mask;
+	bool cs = this->case_sensitive;
+
+	literal = true;
+	star_start = star_end = false;
+	segments.clear();
+	min_length = 0;
+	casemap = casemaps;
+
+	if (m.find('*') != Anope::string::npos)
+	{
+		literal = false;
+		star_start = m[0] == '*';
+		star_end = m[m.length() - 1] == '*';
+	}
+
+	for (size_t pos = 0; pos <= m.length();)
+	{
+		size_t star = literal ? m.length() : m.find('*', pos);
+		if (star == Anope::string::npos)
+			star = m.length();
+
+		if (star > pos || literal)
+		{
+			Segment seg;
+			seg.text = m.substr(pos, star - pos);
+			if (!cs)
+				for (size_t i = 0; i < seg.text.length(); ++i)
+					seg.text[i] = Anope::tolower(seg.text[i]);
+			seg.wild = seg.text.find('?') != Anope::string::npos;
+
+			segments.push_back(seg);
+			min_length += seg.text.length();
+		}
+
+		pos = star + 1;
+	}
+}
+
+bool Anope::CompiledMask::SegmentAt(const Segment &seg, const char *str) const
+{
+	for (size_t i = 0; i < seg.text.length(); ++i)
+	{
+		char wild = seg.text[i], c = case_sensitive ? str[i] : Anope::tolower(str[i]);
+		if (wild != c && wild != '?')
+			return false;
+	}
+
+	return true;
+}
+
+size_t Anope::CompiledMask::FindSegment(const Segment &seg, const Anope::string &str, size_t pos, size_t end) const
+{
+	size_t len = seg.text.length();
+
+	if (case_sensitive && !seg.wild)
+	{
+		size_t p = str.str().find(seg.text.str(), pos);
+		return p != std::string::npos && p + len <= end ? p : Anope::string::npos;
+	}
+
+	const char *s = str.data();
+	char first = seg.text[0];
+	for (; pos + len <= end; ++pos)
+	{
+		char c = case_sensitive ? s[pos] : Anope::tolower(s[pos]);
+		if ((c == first || first == '?') && SegmentAt(seg, s + pos))
+			return pos;
+	}
+
+	return Anope::string::npos;
+}
+
+bool Anope::CompiledMask::Matches(const Anope::string &str) const
+{
+	if (!case_sensitive && casemap != casemaps)
+		this->Compile();
+
+	size_t len = str.length();
+	if (len < min_length)
+		return false;
+
+	if (literal)
+		return len == min_length && SegmentAt(segments[0], str.data());
+
+	size_t first = 0, last = segments.size(), pos = 0, end = len;
+
+	if (!star_start)
+	{
+		if (!SegmentAt(segments[0], str.data()))
+			return false;
+		pos = segments[0].text.length();
+		++first;
+	}
+
+	if (!star_end)
+	{
+		const Segment &seg = segments[--last];
+		end = len - seg.text.length();
+		if (end < pos || !SegmentAt(seg, str.data() + end))
+			return false;
+	}
+
+	/* Taking the first occurrence of each part leaves the most room for the rest */
+	for (size_t i = first; i < last; ++i)
+	{
+		size_t p = FindSegment(segments[i], str, pos, end);
+		if (p == Anope::string::npos)
+			return false;
+		pos = p + segments[i].text.length();
+	}
+
+	return true;
+}
+
+void Anope::CompiledMask::ClearCache()
+{
+	++casemaps;
+	regex_cache.Clear();
+}
+
 bool Anope::Match(const Anope::string &str, const Anope::string &mask, bool case_sensitive, bool use_regex)
 {
-	size_t s = 0, m = 0, str_len = str.length(), mask_len = mask.length();
+	size_t mask_len = mask.length();
 
 	if (use_regex && mask_len >= 2 && mask[0] == '/' && mask[mask.length() - 1] == '/')
 	{
 		Anope::string stripped_mask = mask.substr(1, mask_len - 2);
-		// This is often called with the same mask multiple times in a row, so cache it
-		static Regex *r = NULL;
+		// This is often called with a few masks in turn, so keep the recently used ones
+		Regex *r = regex_cache.Find(stripped_mask.str());
 
-		if (r == NULL || r->GetExpression() != stripped_mask)
+		if (r == NULL)
 		{
-			ServiceReference<RegexProvider> provider("Regex", Config->GetBlock("options")->Get<const Anope::string>("regexengine"));
+			Configuration::Block *options = Config->GetBlock("options");
+			ServiceReference<RegexProvider> provider("Regex", options->Get<const Anope::string>("regexengine"));
 			if (provider)
 			{
 				try
 				{
-					delete r;
-					r = NULL;
 					// This may throw
 					r = provider->Compile(stripped_mask);
+					regex_cache.Insert(stripped_mask.str(), r, std::max(options->Get<unsigned>("regexcache", "16"), 1U));
 				}
 				catch (const RegexException &ex)
 				{
 					Log(LOG_DEBUG) << ex.GetReason();
 				}
 			}
-			else
-			{
-				delete r;
-				r = NULL;
-			}
 		}
 
 		if (r != NULL && r->Matches(str))
@@ -443,65 +620,32 @@ bool Anope::Match(const Anope::string &str, const Anope::string &mask, bool case
 		// Fall through to non regex match
 	}
 
-	while (s < str_len && m < mask_len && mask[m] != '*')
-	{
-		char string = str[s], wild = mask[m];
-		if (case_sensitive)
-		{
-			if (wild != string && wild != '?')
-				return false;
-		}
-		else
-		{
-			if (Anope::tolower(wild) != Anope::tolower(string) && wild != '?')
-				return false;
-		}
-
-		++m;
-		++s;
-	}
-
-	size_t sp = Anope::string::npos, mp = Anope::string::npos;
+	/* Masks matched many times keep a CompiledMask instead, this avoids compiling one for masks which are only matched once */
+	size_t s = 0, m = 0, str_len = str.length(), sp = Anope::string::npos, mp = Anope::string::npos;
 	while (s < str_len)
 	{
-		char string = str[s], wild = mask[m];
+		char string = str[s], wild = m < mask_len ? mask[m] : 0;
 		if (wild == '*')
 		{
-			if (++m == mask_len)
-				return 1;
-
-			mp = m;
-			sp = s + 1;
+			/* Try matching the rest of the mask here first, and one character later if that fails */
+			mp = ++m;
+			sp = s;
 		}
-		else if (case_sensitive)
+		else if (m < mask_len && (wild == '?' || (case_sensitive ? wild == string : Anope::tolower(wild) == Anope::tolower(string))))
 		{
-			if (wild == string || wild == '?')
-			{
-				++m;
-				++s;
-			}
-			else
-			{
-				m = mp;
-				s = sp++;
-			}
+			++m;
+			++s;
 		}
-		else
+		else if (mp != Anope::string::npos)
 		{
-			if (Anope::tolower(wild) == Anope::tolower(string) || wild == '?')
-			{
-				++m;
-				++s;
-			}
-			else
-			{
-				m = mp;
-				s = sp++;
-			}
+			m = mp;
+			s = ++sp;
 		}
+		else
+			return false;
 	}
 
-	if (m < mask_len && mask[m] == '*')
+	while (m < mask_len && mask[m] == '*')
 		++m;
 
 	return m == mask_len;
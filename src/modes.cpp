@@ -817,6 +817,11 @@ Entry::Entry(const Anope::string &m, const Anope::string &fh) : name(m), mask(fh
 
 	if (this->real.find_first_not_of("*") == Anope::string::npos)
 		this->real.clear();
+
+	this->nick_mask = Anope::CompiledMask(this->nick);
+	this->user_mask = Anope::CompiledMask(this->user);
+	this->host_mask = Anope::CompiledMask(this->host);
+	this->real_mask = Anope::CompiledMask(this->real);
 }
 
 const Anope::string Entry::GetMask() const
@@ -867,10 +872,10 @@ bool Entry::Matches(User *u, bool full) const
 
 	bool ret = true;
 
-	if (!this->nick.empty() && !Anope::Match(u->nick, this->nick))
+	if (!this->nick.empty() && !this->nick_mask.Matches(u->nick))
 		ret = false;
 
-	if (!this->user.empty() && !Anope::Match(u->GetVIdent(), this->user) && (!full || !Anope::Match(u->GetIdent(), this->user)))
+	if (!this->user.empty() && !this->user_mask.Matches(u->GetVIdent()) && (!full || !this->user_mask.Matches(u->GetIdent())))
 		ret = false;
 
 	if (this->cidr_len && full)
@@ -885,11 +890,11 @@ bool Entry::Matches(User *u, bool full) const
 			ret = false;
 		}
 	}
-	else if (!this->host.empty() && !Anope::Match(u->GetDisplayedHost(), this->host) && !Anope::Match(u->GetCloakedHost(), this->host) &&
-		(!full || (!Anope::Match(u->host, this->host) && !Anope::Match(u->ip.addr(), this->host))))
+	else if (!this->host.empty() && !this->host_mask.Matches(u->GetDisplayedHost()) && !this->host_mask.Matches(u->GetCloakedHost()) &&
+		(!full || (!this->host_mask.Matches(u->host) && !this->host_mask.Matches(u->ip.addr()))))
 		ret = false;
 
-	if (!this->real.empty() && !Anope::Match(u->realname, this->real))
+	if (!this->real.empty() && !this->real_mask.Matches(u->realname))
 		ret = false;
 
 	return ret;
@@ -11,6 +11,9 @@
 #include "users.h"
 #include "regchannel.h"
 #include "config.h"
+#include "protocol.h"
+#include "access.h"
+#include "xline.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -278,6 +281,9 @@ ModuleReturn ModuleManager::LoadModule(const Anope::string &modname, User *u)
 
 	m->Prioritize();
 
+	/* The module may have added messages or aliases for the protocol module's */
+	MessageTable::Invalidate();
+
 	FOREACH_MOD(OnModuleLoad, (u, m));
 
 	return MOD_ERR_OK;
@@ -382,6 +388,13 @@ ModuleReturn ModuleManager::DeleteModule(Module *m)
 	else
 		destroy_func(m); /* Let the module delete it self, just in case */
 
+	MessageTable::Invalidate();
+	/* The cached regexes may have been compiled by this module */
+	Anope::CompiledMask::ClearCache();
+	XLineManager::DropRegexes();
+	/* Access matching depends on the protocol module */
+	AccessCache::Invalidate();
+
 	if (dlclose(handle))
 		Log() << dlerror();
 
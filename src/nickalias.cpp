@@ -17,6 +17,7 @@
 #include "users.h"
 #include "servers.h"
 #include "config.h"
+#include "access.h"
 
 Serialize::Checker<nickalias_map> NickAliasList("NickAlias");
 
@@ -31,6 +32,8 @@ NickAlias::NickAlias(const Anope::string &nickname, NickCore* nickcore) : Serial
 	this->nick = nickname;
 	this->nc = nickcore;
 	nickcore->aliases->push_back(this);
+	/* Access entries match accounts by their nicks */
+	AccessCache::Invalidate();
 
 	size_t old = NickAliasList->size();
 	(*NickAliasList)[this->nick] = this;
@@ -76,6 +79,7 @@ NickAlias::~NickAlias()
 
 	/* Remove us from the aliases list */
 	NickAliasList->erase(this->nick);
+	AccessCache::Invalidate();
 }
 
 void NickAlias::SetVhost(const Anope::string &ident, const Anope::string &host, const Anope::string &creator, time_t created)
@@ -84,6 +88,7 @@ void NickAlias::SetVhost(const Anope::string &ident, const Anope::string &host,
 	this->vhost_host = host;
 	this->vhost_creator = creator;
 	this->vhost_created = created;
+	this->QueueUpdate();
 }
 
 void NickAlias::RemoveVhost()
@@ -92,6 +97,7 @@ void NickAlias::RemoveVhost()
 	this->vhost_host.clear();
 	this->vhost_creator.clear();
 	this->vhost_created = 0;
+	this->QueueUpdate();
 }
 
 bool NickAlias::HasVhost() const
@@ -123,31 +129,28 @@ NickAlias *NickAlias::Find(const Anope::string &nick)
 {
 	nickalias_map::const_iterator it = NickAliasList->find(nick);
 	if (it != NickAliasList->end())
-	{
-		it->second->QueueUpdate();
 		return it->second;
-	}
 
 	return NULL;
 }
 
 void NickAlias::Serialize(Serialize::Data &data) const
 {
-	data["nick"] << this->nick;
-	data["last_quit"] << this->last_quit;
-	data["last_realname"] << this->last_realname;
-	data["last_usermask"] << this->last_usermask;
-	data["last_realhost"] << this->last_realhost;
-	data.SetType("time_registered", Serialize::Data::DT_INT); data["time_registered"] << this->time_registered;
-	data.SetType("last_seen", Serialize::Data::DT_INT); data["last_seen"] << this->last_seen;
-	data["nc"] << this->nc->display;
+	data.SetString("nick", this->nick);
+	data.SetString("last_quit", this->last_quit);
+	data.SetString("last_realname", this->last_realname);
+	data.SetString("last_usermask", this->last_usermask);
+	data.SetString("last_realhost", this->last_realhost);
+	data.SetType("time_registered", Serialize::Data::DT_INT); data.SetInt("time_registered", this->time_registered);
+	data.SetType("last_seen", Serialize::Data::DT_INT); data.SetInt("last_seen", this->last_seen);
+	data.SetString("nc", this->nc->display);
 
 	if (this->HasVhost())
 	{
-		data["vhost_ident"] << this->GetVhostIdent();
-		data["vhost_host"] << this->GetVhostHost();
-		data["vhost_creator"] << this->GetVhostCreator();
-		data["vhost_time"] << this->GetVhostCreated();
+		data.SetString("vhost_ident", this->GetVhostIdent());
+		data.SetString("vhost_host", this->GetVhostHost());
+		data.SetString("vhost_creator", this->GetVhostCreator());
+		data.SetInt("vhost_time", this->GetVhostCreated());
 	}
 
 	Extensible::ExtensibleSerialize(this, this, data);
@@ -155,10 +158,7 @@ void NickAlias::Serialize(Serialize::Data &data) const
 
 Serializable* NickAlias::Unserialize(Serializable *obj, Serialize::Data &data)
 {
-	Anope::string snc, snick;
-
-	data["nc"] >> snc;
-	data["nick"] >> snick;
+	Anope::string snc = data.GetString("nc"), snick = data.GetString("nick");
 
 	NickCore *core = NickCore::Find(snc);
 	if (core == NULL)
@@ -183,32 +183,22 @@ Serializable* NickAlias::Unserialize(Serializable *obj, Serialize::Data &data)
 
 		na->nc = core;
 		core->aliases->push_back(na);
+		AccessCache::Invalidate();
 	}
 
-	data["last_quit"] >> na->last_quit;
-	data["last_realname"] >> na->last_realname;
-	data["last_usermask"] >> na->last_usermask;
-	data["last_realhost"] >> na->last_realhost;
-	data["time_registered"] >> na->time_registered;
-	data["last_seen"] >> na->last_seen;
-
-	Anope::string vhost_ident, vhost_host, vhost_creator;
-	time_t vhost_time;
-
-	data["vhost_ident"] >> vhost_ident;
-	data["vhost_host"] >> vhost_host;
-	data["vhost_creator"] >> vhost_creator;
-	data["vhost_time"] >> vhost_time;
+	na->last_quit = data.GetString("last_quit");
+	na->last_realname = data.GetString("last_realname");
+	na->last_usermask = data.GetString("last_usermask");
+	na->last_realhost = data.GetString("last_realhost");
+	na->time_registered = data.GetInt("time_registered", na->time_registered);
+	na->last_seen = data.GetInt("last_seen", na->last_seen);
 
-	na->SetVhost(vhost_ident, vhost_host, vhost_creator, vhost_time);
+	na->SetVhost(data.GetString("vhost_ident"), data.GetString("vhost_host"), data.GetString("vhost_creator"), data.GetInt("vhost_time"));
 
 	Extensible::ExtensibleUnserialize(na, na, data);
 
 	/* compat */
-	bool b;
-	b = false;
-	data["extensible:NO_EXPIRE"] >> b;
-	if (b)
+	if (data.GetInt("extensible:NO_EXPIRE"))
 		na->Extend<bool>("NS_NO_EXPIRE");
 	/* end compat */
 
@@ -13,6 +13,7 @@
 #include "modules.h"
 #include "account.h"
 #include "config.h"
+#include "access.h"
 #include <climits>
 
 Serialize::Checker<nickcore_map> NickCoreList("NickCore");
@@ -60,6 +61,8 @@ NickCore::~NickCore()
 	NickCoreList->erase(this->display);
 	if (this->id)
 		NickCoreIdList.erase(this->id);
+	/* A new account may be allocated at this one's address */
+	AccessCache::Invalidate();
 
 	this->ClearAccess();
 
@@ -73,16 +76,26 @@ NickCore::~NickCore()
 
 void NickCore::Serialize(Serialize::Data &data) const
 {
-	data["display"] << this->display;
-	data["uniqueid"] << this->id;
-	data["pass"] << this->pass;
-	data["email"] << this->email;
-	data["language"] << this->language;
-	for (unsigned i = 0; i < this->access.size(); ++i)
-		data["access"] << this->access[i] << " ";
-	data["memomax"] << this->memos.memomax;
-	for (unsigned i = 0; i < this->memos.ignores.size(); ++i)
-		data["memoignores"] << this->memos.ignores[i] << " ";
+	data.SetString("display", this->display);
+	data.SetUInt("uniqueid", this->id);
+	data.SetString("pass", this->pass);
+	data.SetString("email", this->email);
+	data.SetString("language", this->language);
+	{
+		Anope::string buf;
+		for (unsigned i = 0; i < this->access.size(); ++i)
+			buf += this->access[i] + " ";
+		if (!buf.empty())
+			data.SetString("access", buf);
+	}
+	data.SetInt("memomax", this->memos.memomax);
+	{
+		Anope::string buf;
+		for (unsigned i = 0; i < this->memos.ignores.size(); ++i)
+			buf += this->memos.ignores[i] + " ";
+		if (!buf.empty())
+			data.SetString("memoignores", buf);
+	}
 	Extensible::ExtensibleSerialize(this, this, data);
 }
 
@@ -90,33 +103,28 @@ Serializable* NickCore::Unserialize(Serializable *obj, Serialize::Data &data)
 {
 	NickCore *nc;
 
-	Anope::string sdisplay;
-	data["display"] >> sdisplay;
-
-	uint64_t sid = 0;
-	data["uniqueid"] >> sid;
+	Anope::string sdisplay = data.GetString("display");
+	uint64_t sid = data.GetUInt("uniqueid");
 
 	if (obj)
 		nc = anope_dynamic_static_cast<NickCore *>(obj);
 	else
 		nc = new NickCore(sdisplay, sid);
 
-	data["pass"] >> nc->pass;
-	data["email"] >> nc->email;
-	data["language"] >> nc->language;
+	nc->pass = data.GetString("pass");
+	nc->email = data.GetString("email");
+	nc->language = data.GetString("language");
 	{
 		Anope::string buf;
-		data["access"] >> buf;
-		spacesepstream sep(buf);
+		spacesepstream sep(data.GetString("access"));
 		nc->access.clear();
 		while (sep.GetToken(buf))
 			nc->access.push_back(buf);
 	}
-	data["memomax"] >> nc->memos.memomax;
+	nc->memos.memomax = data.GetInt("memomax", nc->memos.memomax);
 	{
 		Anope::string buf;
-		data["memoignores"] >> buf;
-		spacesepstream sep(buf);
+		spacesepstream sep(data.GetString("memoignores"));
 		nc->memos.ignores.clear();
 		while (sep.GetToken(buf))
 			nc->memos.ignores.push_back(buf);
@@ -125,38 +133,21 @@ Serializable* NickCore::Unserialize(Serializable *obj, Serialize::Data &data)
 	Extensible::ExtensibleUnserialize(nc, nc, data);
 
 	/* compat */
-	bool b;
-	b = false;
-	data["extensible:SECURE"] >> b;
-	if (b)
+	if (data.GetInt("extensible:SECURE"))
 		nc->Extend<bool>("NS_SECURE");
-	b = false;
-	data["extensible:PRIVATE"] >> b;
-	if (b)
+	if (data.GetInt("extensible:PRIVATE"))
 		nc->Extend<bool>("NS_PRIVATE");
-	b = false;
-	data["extensible:AUTOOP"] >> b;
-	if (b)
+	if (data.GetInt("extensible:AUTOOP"))
 		nc->Extend<bool>("AUTOOP");
-	b = false;
-	data["extensible:HIDE_EMAIL"] >> b;
-	if (b)
+	if (data.GetInt("extensible:HIDE_EMAIL"))
 		nc->Extend<bool>("HIDE_EMAIL");
-	b = false;
-	data["extensible:HIDE_QUIT"] >> b;
-	if (b)
+	if (data.GetInt("extensible:HIDE_QUIT"))
 		nc->Extend<bool>("HIDE_QUIT");
-	b = false;
-	data["extensible:MEMO_RECEIVE"] >> b;
-	if (b)
+	if (data.GetInt("extensible:MEMO_RECEIVE"))
 		nc->Extend<bool>("MEMO_RECEIVE");
-	b = false;
-	data["extensible:MEMO_SIGNON"] >> b;
-	if (b)
+	if (data.GetInt("extensible:MEMO_SIGNON"))
 		nc->Extend<bool>("MEMO_SIGNON");
-	b = false;
-	data["extensible:KILLPROTECT"] >> b;
-	if (b)
+	if (data.GetInt("extensible:KILLPROTECT"))
 		nc->Extend<bool>("KILLPROTECT");
 	/* end compat */
 
@@ -170,14 +161,26 @@ void NickCore::SetDisplay(const NickAlias *na)
 
 	FOREACH_MOD(OnChangeCoreDisplay, (this, na->nick));
 
-	/* this affects the serialized aliases */
+	/* this affects the serialized aliases, and the channels, access entries, and akicks naming this account */
 	for (unsigned i = 0; i < aliases->size(); ++i)
 		aliases->at(i)->QueueUpdate();
+	for (std::map<ChannelInfo *, int>::iterator it = this->chanaccess->begin(), it_end = this->chanaccess->end(); it != it_end; ++it)
+	{
+		ChannelInfo *ci = it->first;
+		ci->QueueUpdate();
+		for (unsigned i = 0; i < ci->GetAccessCount(); ++i)
+			if (ci->GetAccess(i)->GetAccount() == this)
+				ci->GetAccess(i)->QueueUpdate();
+		for (unsigned i = 0; i < ci->GetAkickCount(); ++i)
+			if (ci->GetAkick(i)->nc == this)
+				ci->GetAkick(i)->QueueUpdate();
+	}
 
 	/* Remove the core from the list */
 	NickCoreList->erase(this->display);
 
 	this->display = na->nick;
+	this->QueueUpdate();
 
 	(*NickCoreList)[this->display] = this;
 }
@@ -190,6 +193,7 @@ bool NickCore::IsServicesOper() const
 void NickCore::AddAccess(const Anope::string &entry)
 {
 	this->access.push_back(entry);
+	this->QueueUpdate();
 	FOREACH_MOD(OnNickAddAccess, (this, entry));
 }
 
@@ -221,6 +225,7 @@ void NickCore::EraseAccess(const Anope::string &entry)
 		{
 			FOREACH_MOD(OnNickEraseAccess, (this, entry));
 			this->access.erase(this->access.begin() + i);
+			this->QueueUpdate();
 			break;
 		}
 }
@@ -229,6 +234,7 @@ void NickCore::ClearAccess()
 {
 	FOREACH_MOD(OnNickClearAccess, (this));
 	this->access.clear();
+	this->QueueUpdate();
 }
 
 bool NickCore::IsOnAccess(const User *u) const
@@ -271,10 +277,7 @@ NickCore* NickCore::Find(const Anope::string &nick)
 {
 	nickcore_map::const_iterator it = NickCoreList->find(nick);
 	if (it != NickCoreList->end())
-	{
-		it->second->QueueUpdate();
 		return it->second;
-	}
 
 	return NULL;
 }
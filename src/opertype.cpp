@@ -51,62 +51,117 @@ OperType *OperType::Find(const Anope::string &name)
 	return NULL;
 }
 
-OperType::OperType(const Anope::string &nname) : name(nname)
+void OperType::CompiledList::Compile(const std::list<Anope::string> &list)
 {
+	this->Clear();
+
+	size_t pos = 0;
+	for (std::list<Anope::string>::const_iterator it = list.begin(), it_end = list.end(); it != it_end; ++it, ++pos)
+	{
+		bool grant = it->find('~');
+		const Anope::string &mask = grant ? *it : it->substr(1);
+
+		if (mask.find_first_of("*?") == Anope::string::npos)
+			/* Only the first entry for a name can decide */
+			this->exact.insert(std::make_pair(mask, std::make_pair(pos, grant)));
+		else
+		{
+			Wildcard w;
+			w.pos = pos;
+			w.grant = grant;
+			w.mask = Anope::CompiledMask(mask);
+			this->wildcards.push_back(w);
+		}
+	}
+
+	this->compiled = true;
 }
 
-bool OperType::HasCommand(const Anope::string &cmdstr) const
+void OperType::CompiledList::Clear()
 {
-	for (std::list<Anope::string>::const_iterator it = this->commands.begin(), it_end = this->commands.end(); it != it_end; ++it)
-	{
-		const Anope::string &s = *it;
+	this->compiled = false;
+	this->exact.clear();
+	this->wildcards.clear();
+	this->results.clear();
+}
 
-		if (!s.find('~') && Anope::Match(cmdstr, s.substr(1)))
-			return false;
-		else if (Anope::Match(cmdstr, s))
-			return true;
-	}
-	for (std::set<OperType *>::const_iterator iit = this->inheritances.begin(), iit_end = this->inheritances.end(); iit != iit_end; ++iit)
-	{
-		OperType *ot = *iit;
+int OperType::CompiledList::Decide(const Anope::string &str) const
+{
+	size_t end = static_cast<size_t>(-1);
+	int decision = -1;
 
-		if (ot->HasCommand(cmdstr))
-			return true;
+	Anope::hash_map<std::pair<size_t, bool> >::const_iterator it = this->exact.find(str);
+	if (it != this->exact.end())
+	{
+		end = it->second.first;
+		decision = it->second.second;
 	}
 
-	return false;
+	/* A wildcard entry only decides if it comes before the exact one */
+	for (unsigned i = 0; i < this->wildcards.size() && this->wildcards[i].pos < end; ++i)
+		if (this->wildcards[i].mask.Matches(str))
+			return this->wildcards[i].grant;
+
+	return decision;
 }
 
-bool OperType::HasPriv(const Anope::string &privstr) const
+OperType::OperType(const Anope::string &nname) : name(nname)
 {
-	for (std::list<Anope::string>::const_iterator it = this->privs.begin(), it_end = this->privs.end(); it != it_end; ++it)
-	{
-		const Anope::string &s = *it;
+}
 
-		if (!s.find('~') && Anope::Match(privstr, s.substr(1)))
-			return false;
-		else if (Anope::Match(privstr, s))
-			return true;
-	}
-	for (std::set<OperType *>::const_iterator iit = this->inheritances.begin(), iit_end = this->inheritances.end(); iit != iit_end; ++iit)
-	{
-		OperType *ot = *iit;
+bool OperType::Check(bool is_command, const Anope::string &str) const
+{
+	CompiledList &list = is_command ? this->compiled_commands : this->compiled_privs;
+
+	Anope::hash_map<bool>::const_iterator it = list.results.find(str);
+	if (it != list.results.end())
+		return it->second;
+
+	if (!list.compiled)
+		list.Compile(is_command ? this->commands : this->privs);
+
+	int decision = list.Decide(str);
+	bool result = decision > 0;
+	if (decision < 0)
+		for (std::set<OperType *>::const_iterator iit = this->inheritances.begin(), iit_end = this->inheritances.end(); iit != iit_end; ++iit)
+		{
+			OperType *ot = *iit;
+
+			if (is_command ? ot->HasCommand(str) : ot->HasPriv(str))
+			{
+				result = true;
+				break;
+			}
+		}
+
+	/* Only a few names are ever checked, but don't let anything grow this forever */
+	if (list.results.size() >= 1024)
+		list.results.clear();
+	list.results[str] = result;
+
+	return result;
+}
 
-		if (ot->HasPriv(privstr))
-			return true;
-	}
+bool OperType::HasCommand(const Anope::string &cmdstr) const
+{
+	return this->Check(true, cmdstr);
+}
 
-	return false;
+bool OperType::HasPriv(const Anope::string &privstr) const
+{
+	return this->Check(false, privstr);
 }
 
 void OperType::AddCommand(const Anope::string &cmdstr)
 {
 	this->commands.push_back(cmdstr);
+	this->compiled_commands.Clear();
 }
 
 void OperType::AddPriv(const Anope::string &privstr)
 {
 	this->privs.push_back(privstr);
+	this->compiled_privs.Clear();
 }
 
 const Anope::string &OperType::GetName() const
@@ -117,7 +172,11 @@ const Anope::string &OperType::GetName() const
 void OperType::Inherits(OperType *ot)
 {
 	if (ot != this)
+	{
 		this->inheritances.insert(ot);
+		this->compiled_commands.results.clear();
+		this->compiled_privs.results.clear();
+	}
 }
 
 const std::list<Anope::string> OperType::GetCommands() const
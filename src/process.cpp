@@ -16,90 +16,296 @@
 #include "users.h"
 #include "regchannel.h"
 
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
 void Anope::Process(const Anope::string &buffer)
 {
-	/* If debugging, log the buffer */
-	Log(LOG_RAWIO) << "Received: " << buffer;
-
-	if (buffer.empty())
-		return;
+	Anope::Process(Anope::string_view(buffer));
+}
 
-	Anope::map<Anope::string> tags;
-	Anope::string source, command;
-	std::vector<Anope::string> params;
+namespace
+{
+	/* The message being processed, reused for every line so that once the
+	 * vectors have grown parsing does not allocate. Lines processed from
+	 * within a handler get their own.
+	 */
+	ParsedMessage current_message;
+	bool processing = false;
 
-	if (!IRCD->Parse(buffer, tags, source, command, params))
-		return;
+	class ProcessingGuard
+	{
+		bool &flag;
+	 public:
+		ProcessingGuard(bool &f) : flag(f) { flag = true; }
+		~ProcessingGuard() { flag = false; }
+	};
+}
 
+static void ProcessMessage(const Anope::string_view &buffer, ParsedMessage &message)
+{
 	if (Anope::ProtocolDebug)
 	{
-		if (tags.empty())
+		if (message.tags.empty())
 			Log() << "No tags";
 		else
-			for (Anope::map<Anope::string>::const_iterator it = tags.begin(); it != tags.end(); ++it)
-				Log() << "tags " << it->first << ": " << it->second;
+			for (unsigned i = 0; i < message.tags.size(); ++i)
+				Log() << "tags " << message.tags[i].name << ": " << message.tags[i].value;
 
-		Log() << "Source : " << (source.empty() ? "No source" : source);
-		Log() << "Command: " << command;
+		if (message.source.empty())
+			Log() << "Source : No source";
+		else
+			Log() << "Source : " << message.source;
+		Log() << "Command: " << message.command;
 
-		if (params.empty())
+		if (message.params.empty())
 			Log() << "No params";
 		else
-			for (unsigned i = 0; i < params.size(); ++i)
-				Log() << "params " << i << ": " << params[i];
+			for (unsigned i = 0; i < message.params.size(); ++i)
+				Log() << "params " << i << ": " << message.params[i];
 	}
 
-	static const Anope::string proto_name = ModuleManager::FindFirstOf(PROTOCOL) ? ModuleManager::FindFirstOf(PROTOCOL)->name : "";
-
+	Anope::string source = message.source.str();
 	MessageSource src(source);
 
-	EventReturn MOD_RESULT;
-	FOREACH_RESULT(OnMessage, MOD_RESULT, (src, command, params));
-	if (MOD_RESULT == EVENT_STOP)
-		return;
+	/* OnMessage handlers may rewrite the command and parameters, so they only
+	 * get copied into strings when something is hooked into it.
+	 */
+	Anope::string command;
+	std::vector<Anope::string> params;
+	if (!ModuleManager::EventHandlers[I_OnMessage].empty())
+	{
+		command = message.command.str();
+		message.GetParams(params);
+
+		EventReturn MOD_RESULT;
+		FOREACH_RESULT(OnMessage, MOD_RESULT, (src, command, params));
+		if (MOD_RESULT == EVENT_STOP)
+			return;
 
-	ServiceReference<IRCDMessage> m("IRCDMessage", proto_name + "/" + command.lower());
+		message.command = command;
+		message.params.assign(params.begin(), params.end());
+	}
+
+	MessageTable::Stats *stats;
+	IRCDMessage *m = MessageTable::Find(message.command, stats);
 	if (!m)
 	{
 		Log(LOG_DEBUG) << "unknown message from server (" << buffer << ")";
 		return;
 	}
 
-	if (m->HasFlag(IRCDMESSAGE_SOFT_LIMIT) ? (params.size() < m->GetParamCount()) : (params.size() != m->GetParamCount()))
-		Log(LOG_DEBUG) << "invalid parameters for " << command << ": " << params.size() << " != " << m->GetParamCount();
+	if (m->HasFlag(IRCDMESSAGE_SOFT_LIMIT) ? (message.params.size() < m->GetParamCount()) : (message.params.size() != m->GetParamCount()))
+		Log(LOG_DEBUG) << "invalid parameters for " << message.command << ": " << message.params.size() << " != " << m->GetParamCount();
 	else if (m->HasFlag(IRCDMESSAGE_REQUIRE_USER) && !src.GetUser())
-		Log(LOG_DEBUG) << "unexpected non-user source " << source << " for " << command;
+		Log(LOG_DEBUG) << "unexpected non-user source " << source << " for " << message.command;
 	else if (m->HasFlag(IRCDMESSAGE_REQUIRE_SERVER) && !source.empty() && !src.GetServer())
-		Log(LOG_DEBUG) << "unexpected non-server source " << source << " for " << command;
+		Log(LOG_DEBUG) << "unexpected non-server source " << source << " for " << message.command;
 	else
-		m->Run(src, params, tags);
+	{
+		timeval start, end;
+		gettimeofday(&start, NULL);
+
+		m->Run(src, message);
+
+		gettimeofday(&end, NULL);
+		++stats->hits;
+		stats->time += (end.tv_sec - start.tv_sec) * 1000000LL + (end.tv_usec - start.tv_usec);
+	}
+}
+
+void Anope::Process(const Anope::string_view &buffer)
+{
+	/* If debugging, log the buffer */
+	Log(LOG_RAWIO) << "Received: " << buffer;
+
+	if (buffer.empty())
+		return;
+
+	if (processing)
+	{
+		ParsedMessage message;
+		if (IRCD->Parse(buffer, message))
+			ProcessMessage(buffer, message);
+		return;
+	}
+
+	ProcessingGuard guard(processing);
+	current_message.clear();
+	if (IRCD->Parse(buffer, current_message))
+		ProcessMessage(buffer, current_message);
+}
+
+namespace
+{
+	struct MessageSlot
+	{
+		IRCDMessage *message;
+		MessageTable::Stats *stats;
+
+		MessageSlot() : message(NULL), stats(NULL) { }
+	};
+
+	/* Open addressed with linear probing, the size is a power of two and at
+	 * least twice the number of commands so probes stay short.
+	 */
+	std::vector<MessageSlot> message_slots;
+	bool message_slots_valid = false;
+	/* Never erased from, so the table can point into it */
+	std::map<Anope::string, MessageTable::Stats> message_stats;
+
+	size_t HashCommand(const Anope::string_view &command)
+	{
+		/* FNV-1a */
+		size_t hash = 2166136261u;
+		for (Anope::string_view::const_iterator it = command.begin(); it != command.end(); ++it)
+		{
+			hash ^= static_cast<unsigned char>(Anope::tolower(*it));
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	bool StatsSorter(const MessageTable::Stats *a, const MessageTable::Stats *b)
+	{
+		return a->hits > b->hits;
+	}
+
+	void BuildMessageTable()
+	{
+		message_slots.clear();
+		message_slots_valid = true;
+
+		Module *protocol = ModuleManager::FindFirstOf(PROTOCOL);
+		if (!protocol)
+			return;
+
+		const Anope::string prefix = protocol->name + "/";
+		std::vector<Anope::string> keys = Service::GetServiceKeys("IRCDMessage"), aliases = Service::GetAliasKeys("IRCDMessage");
+		keys.insert(keys.end(), aliases.begin(), aliases.end());
+
+		size_t size = 16;
+		while (size < keys.size() * 2)
+			size <<= 1;
+		message_slots.resize(size);
+
+		for (unsigned i = 0; i < keys.size(); ++i)
+		{
+			const Anope::string &key = keys[i];
+			if (key.length() <= prefix.length() || key.find(prefix) != 0)
+				continue;
+
+			IRCDMessage *m = static_cast<IRCDMessage *>(Service::FindService("IRCDMessage", key));
+			if (!m)
+				continue;
+
+			MessageTable::Stats &stats = message_stats[key.substr(prefix.length())];
+			stats.command = key.substr(prefix.length());
+
+			for (size_t h = HashCommand(stats.command);; ++h)
+			{
+				MessageSlot &slot = message_slots[h & (size - 1)];
+				if (slot.message == NULL)
+				{
+					slot.message = m;
+					slot.stats = &stats;
+					break;
+				}
+				/* Registered and aliased under the same name */
+				if (slot.stats == &stats)
+					break;
+			}
+		}
+	}
+}
+
+IRCDMessage *MessageTable::Find(const Anope::string_view &command, Stats *&stats)
+{
+	if (!message_slots_valid)
+		BuildMessageTable();
+	if (message_slots.empty())
+		return NULL;
+
+	for (size_t h = HashCommand(command);; ++h)
+	{
+		const MessageSlot &slot = message_slots[h & (message_slots.size() - 1)];
+		if (slot.message == NULL)
+			return NULL;
+		if (command.equals_ci(slot.stats->command))
+		{
+			stats = slot.stats;
+			return slot.message;
+		}
+	}
+}
+
+void MessageTable::Invalidate()
+{
+	message_slots_valid = false;
+}
+
+void MessageTable::GetStats(std::vector<const Stats *> &stats)
+{
+	for (std::map<Anope::string, Stats>::const_iterator it = message_stats.begin(); it != message_stats.end(); ++it)
+		if (it->second.hits)
+			stats.push_back(&it->second);
+	std::sort(stats.begin(), stats.end(), StatsSorter);
+}
+
+void MessageTable::ResetStats()
+{
+	for (std::map<Anope::string, Stats>::iterator it = message_stats.begin(); it != message_stats.end(); ++it)
+		it->second.hits = it->second.time = 0;
 }
 
 bool IRCDProto::Parse(const Anope::string &buffer, Anope::map<Anope::string> &tags, Anope::string &source, Anope::string &command, std::vector<Anope::string> &params)
+{
+	ParsedMessage message;
+	if (!this->Parse(Anope::string_view(buffer), message))
+		return false;
+
+	message.GetTags(tags);
+	source = message.source.str();
+	command = message.command.str();
+	message.GetParams(params);
+	return true;
+}
+
+bool IRCDProto::Parse(const Anope::string_view &buffer, ParsedMessage &message)
 {
 	MessageTokenizer tokens(buffer);
 
 	// This will always exist because of the check in Anope::Process.
-	Anope::string token;
+	Anope::string_view token;
 	tokens.GetMiddle(token);
 
 	if (token[0] == '@')
 	{
 		// The line begins with message tags.
-		sepstream tagstream(token.substr(1), ';');
-		while (tagstream.GetToken(token))
+		Anope::string_view tagstream = token.substr(1);
+		while (!tagstream.empty())
 		{
-			const Anope::string::size_type valsep = token.find('=');
-			if (valsep == Anope::string::npos)
+			Anope::string_view::size_type tagsep = tagstream.find(';');
+			Anope::string_view tag = tagstream.substr(0, tagsep);
+			tagstream.remove_prefix(tagsep == Anope::string_view::npos ? tagstream.length() : tagsep + 1);
+			if (tag.empty())
+				continue;
+
+			ParsedMessage::Tag t;
+			const Anope::string_view::size_type valsep = tag.find('=');
+			if (valsep == Anope::string_view::npos)
 			{
 				// Tag has no value.
-				tags[token];
+				t.name = tag;
 			}
 			else
 			{
 				// Tag has a value
-				tags[token.substr(0, valsep)] = token.substr(valsep + 1);
+				t.name = tag.substr(0, valsep);
+				t.value = tag.substr(valsep + 1);
 			}
+			message.tags.push_back(t);
 		}
 
 		if (!tokens.GetMiddle(token))
@@ -108,17 +314,17 @@ bool IRCDProto::Parse(const Anope::string &buffer, Anope::map<Anope::string> &ta
 
 	if (token[0] == ':')
 	{
-		source = token.substr(1);
+		message.source = token.substr(1);
 		if (!tokens.GetMiddle(token))
 			return false;
 	}
 
 	// Store the command name.
-	command = token;
+	message.command = token;
 
 	// Retrieve all of the parameters.
 	while (tokens.GetTrailing(token))
-		params.push_back(token);
+		message.params.push_back(token);
 
 	return true;
 }
@@ -131,24 +337,40 @@ Anope::string IRCDProto::Format(const Anope::string &source, const Anope::string
 		return message;
 }
 
-MessageTokenizer::MessageTokenizer(const Anope::string &msg)
+MessageTokenizer::MessageTokenizer(const Anope::string_view &msg)
 	: message(msg)
 	, position(0)
 {
 }
 
 bool MessageTokenizer::GetMiddle(Anope::string &token)
+{
+	Anope::string_view view;
+	bool ret = GetMiddle(view);
+	token = view.str();
+	return ret;
+}
+
+bool MessageTokenizer::GetTrailing(Anope::string &token)
+{
+	Anope::string_view view;
+	bool ret = GetTrailing(view);
+	token = view.str();
+	return ret;
+}
+
+bool MessageTokenizer::GetMiddle(Anope::string_view &token)
 {
 	// If we are past the end of the string we can't do anything.
 	if (position >= message.length())
 	{
-		token.clear();
+		token = Anope::string_view();
 		return false;
 	}
 
 	// If we can't find another separator this is the last token in the message.
-	Anope::string::size_type separator = message.find(' ', position);
-	if (separator == Anope::string::npos)
+	Anope::string_view::size_type separator = message.find(' ', position);
+	if (separator == Anope::string_view::npos)
 	{
 		token = message.substr(position);
 		position = message.length();
@@ -156,16 +378,17 @@ bool MessageTokenizer::GetMiddle(Anope::string &token)
 	}
 
 	token = message.substr(position, separator - position);
-	position = message.find_first_not_of(' ', separator);
+	for (position = separator; position < message.length() && message[position] == ' '; ++position)
+		;
 	return true;
 }
 
-bool MessageTokenizer::GetTrailing(Anope::string &token)
+bool MessageTokenizer::GetTrailing(Anope::string_view &token)
 {
 	// If we are past the end of the string we can't do anything.
 	if (position >= message.length())
 	{
-		token.clear();
+		token = Anope::string_view();
 		return false;
 	}
 
@@ -501,6 +501,12 @@ Server *MessageSource::GetServer() const
 
 IRCDMessage::IRCDMessage(Module *o, const Anope::string &n, unsigned p) : Service(o, "IRCDMessage", o->name + "/" + n.lower()), name(n), param_count(p)
 {
+	MessageTable::Invalidate();
+}
+
+IRCDMessage::~IRCDMessage()
+{
+	MessageTable::Invalidate();
 }
 
 unsigned IRCDMessage::GetParamCount() const
@@ -514,3 +520,51 @@ void IRCDMessage::Run(MessageSource &source, const std::vector<Anope::string> &p
 	Run(source, params);
 }
 
+void IRCDMessage::Run(MessageSource &source, const ParsedMessage &message)
+{
+	std::vector<Anope::string> params;
+	message.GetParams(params);
+
+	/* Most messages have no tags, so don't build a map for them */
+	static const Anope::map<Anope::string> no_tags;
+	if (message.tags.empty())
+	{
+		Run(source, params, no_tags);
+		return;
+	}
+
+	Anope::map<Anope::string> tags;
+	message.GetTags(tags);
+
+	Run(source, params, tags);
+}
+
+ParsedMessage::ParsedMessage()
+{
+}
+
+ParsedMessage::ParsedMessage(const std::vector<Anope::string> &p) : params(p.begin(), p.end())
+{
+}
+
+void ParsedMessage::clear()
+{
+	this->tags.clear();
+	this->source = this->command = Anope::string_view();
+	this->params.clear();
+}
+
+void ParsedMessage::GetParams(std::vector<Anope::string> &p) const
+{
+	p.clear();
+	p.reserve(this->params.size());
+	for (unsigned i = 0; i < this->params.size(); ++i)
+		p.push_back(this->params[i].str());
+}
+
+void ParsedMessage::GetTags(Anope::map<Anope::string> &t) const
+{
+	for (unsigned i = 0; i < this->tags.size(); ++i)
+		t[this->tags[i].name.str()] = this->tags[i].value.str();
+}
+
@@ -40,23 +40,20 @@ AutoKick::~AutoKick()
 
 void AutoKick::Serialize(Serialize::Data &data) const
 {
-	data["ci"] << this->ci->name;
+	data.SetString("ci", this->ci->name);
 	if (this->nc)
-		data["nc"] << this->nc->display;
+		data.SetString("nc", this->nc->display);
 	else
-		data["mask"] << this->mask;
-	data["reason"] << this->reason;
-	data["creator"] << this->creator;
-	data.SetType("addtime", Serialize::Data::DT_INT); data["addtime"] << this->addtime;
-	data.SetType("last_used", Serialize::Data::DT_INT); data["last_used"] << this->last_used;
+		data.SetString("mask", this->mask);
+	data.SetString("reason", this->reason);
+	data.SetString("creator", this->creator);
+	data.SetType("addtime", Serialize::Data::DT_INT); data.SetInt("addtime", this->addtime);
+	data.SetType("last_used", Serialize::Data::DT_INT); data.SetInt("last_used", this->last_used);
 }
 
 Serializable* AutoKick::Unserialize(Serializable *obj, Serialize::Data &data)
 {
-	Anope::string sci, snc;
-
-	data["ci"] >> sci;
-	data["nc"] >> snc;
+	Anope::string sci = data.GetString("ci"), snc = data.GetString("nc");
 
 	ChannelInfo *ci = ChannelInfo::Find(sci);
 	if (!ci)
@@ -67,24 +64,17 @@ Serializable* AutoKick::Unserialize(Serializable *obj, Serialize::Data &data)
 	if (obj)
 	{
 		ak = anope_dynamic_static_cast<AutoKick *>(obj);
-		data["creator"] >> ak->creator;
-		data["reason"] >> ak->reason;
+		ak->creator = data.GetString("creator");
+		ak->reason = data.GetString("reason");
 		ak->nc = NickCore::Find(snc);
-		data["mask"] >> ak->mask;
-		data["addtime"] >> ak->addtime;
-		data["last_used"] >> ak->last_used;
+		ak->mask = data.GetString("mask");
+		ak->addtime = data.GetInt("addtime", ak->addtime);
+		ak->last_used = data.GetInt("last_used", ak->last_used);
 	}
 	else
 	{
-		time_t addtime, lastused;
-		data["addtime"] >> addtime;
-		data["last_used"] >> lastused;
-
-		Anope::string screator, sreason, smask;
-
-		data["creator"] >> screator;
-		data["reason"] >> sreason;
-		data["mask"] >> smask;
+		time_t addtime = data.GetInt("addtime"), lastused = data.GetInt("last_used");
+		Anope::string screator = data.GetString("creator"), sreason = data.GetString("reason"), smask = data.GetString("mask");
 
 		if (nc)
 			ak = ci->AddAkick(screator, nc, sreason, addtime, lastused);
@@ -112,6 +102,8 @@ ChannelInfo::ChannelInfo(const Anope::string &chname) : Serializable("ChannelInf
 
 	this->name = chname;
 
+	this->levels_generation = AccessCache::NewGeneration();
+	this->compiled_generation = this->compiled_levels_generation = 0;
 	this->bantype = 2;
 	this->memos.memomax = 0;
 	this->last_used = this->time_registered = Anope::CurTime;
@@ -121,6 +113,9 @@ ChannelInfo::ChannelInfo(const Anope::string &chname) : Serializable("ChannelInf
 	if (old == RegisteredChannelList->size())
 		Log(LOG_DEBUG) << "Duplicate channel " << this->name << " in registered channel table?";
 
+	/* Access entries may nest this channel */
+	AccessCache::Invalidate();
+
 	FOREACH_MOD(OnCreateChan, (this));
 }
 
@@ -132,8 +127,12 @@ ChannelInfo::ChannelInfo(const ChannelInfo &ci) : Serializable("ChannelInfo"),
 	if (this->founder)
 		++this->founder->channelcount;
 
+	this->levels_generation = AccessCache::NewGeneration();
+
 	this->access->clear();
 	this->akick->clear();
+	this->user_access.clear();
+	this->account_access.clear();
 
 	FOREACH_MOD(OnCreateChan, (this));
 }
@@ -163,6 +162,7 @@ ChannelInfo::~ChannelInfo()
 	}
 
 	RegisteredChannelList->erase(this->name);
+	AccessCache::Invalidate();
 
 	this->SetFounder(NULL);
 	this->SetSuccessor(NULL);
@@ -180,43 +180,44 @@ ChannelInfo::~ChannelInfo()
 
 void ChannelInfo::Serialize(Serialize::Data &data) const
 {
-	data["name"] << this->name;
+	data.SetString("name", this->name);
 	if (this->founder)
-		data["founder"] << this->founder->display;
+		data.SetString("founder", this->founder->display);
 	if (this->successor)
-		data["successor"] << this->successor->display;
-	data["description"] << this->desc;
-	data.SetType("time_registered", Serialize::Data::DT_INT); data["time_registered"] << this->time_registered;
-	data.SetType("last_used", Serialize::Data::DT_INT); data["last_used"] << this->last_used;
-	data["last_topic"] << this->last_topic;
-	data["last_topic_setter"] << this->last_topic_setter;
-	data.SetType("last_topic_time", Serialize::Data::DT_INT); data["last_topic_time"] << this->last_topic_time;
-	data.SetType("bantype", Serialize::Data::DT_INT); data["bantype"] << this->bantype;
+		data.SetString("successor", this->successor->display);
+	data.SetString("description", this->desc);
+	data.SetType("time_registered", Serialize::Data::DT_INT); data.SetInt("time_registered", this->time_registered);
+	data.SetType("last_used", Serialize::Data::DT_INT); data.SetInt("last_used", this->last_used);
+	data.SetString("last_topic", this->last_topic);
+	data.SetString("last_topic_setter", this->last_topic_setter);
+	data.SetType("last_topic_time", Serialize::Data::DT_INT); data.SetInt("last_topic_time", this->last_topic_time);
+	data.SetType("bantype", Serialize::Data::DT_INT); data.SetInt("bantype", this->bantype);
 	{
 		Anope::string levels_buffer;
+		char buf[20];
 		for (Anope::map<int16_t>::const_iterator it = this->levels.begin(), it_end = this->levels.end(); it != it_end; ++it)
-			levels_buffer += it->first + " " + stringify(it->second) + " ";
-		data["levels"] << levels_buffer;
+			levels_buffer += it->first + " " + Serialize::FormatInt(buf, it->second).str() + " ";
+		data.SetString("levels", levels_buffer);
 	}
 	if (this->bi)
-		data["bi"] << this->bi->nick;
-	data.SetType("banexpire", Serialize::Data::DT_INT); data["banexpire"] << this->banexpire;
-	data["memomax"] << this->memos.memomax;
-	for (unsigned i = 0; i < this->memos.ignores.size(); ++i)
-		data["memoignores"] << this->memos.ignores[i] << " ";
+		data.SetString("bi", this->bi->nick);
+	data.SetType("banexpire", Serialize::Data::DT_INT); data.SetInt("banexpire", this->banexpire);
+	data.SetInt("memomax", this->memos.memomax);
+	{
+		Anope::string buf;
+		for (unsigned i = 0; i < this->memos.ignores.size(); ++i)
+			buf += this->memos.ignores[i] + " ";
+		if (!buf.empty())
+			data.SetString("memoignores", buf);
+	}
 
 	Extensible::ExtensibleSerialize(this, this, data);
 }
 
 Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 {
-	Anope::string sname, sfounder, ssuccessor, slevels, sbi;
-
-	data["name"] >> sname;
-	data["founder"] >> sfounder;
-	data["successor"] >> ssuccessor;
-	data["levels"] >> slevels;
-	data["bi"] >> sbi;
+	Anope::string sname = data.GetString("name"), sfounder = data.GetString("founder"), ssuccessor = data.GetString("successor"),
+		slevels = data.GetString("levels"), sbi = data.GetString("bi");
 
 	ChannelInfo *ci;
 	if (obj)
@@ -227,13 +228,13 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 	ci->SetFounder(NickCore::Find(sfounder));
 	ci->SetSuccessor(NickCore::Find(ssuccessor));
 
-	data["description"] >> ci->desc;
-	data["time_registered"] >> ci->time_registered;
-	data["last_used"] >> ci->last_used;
-	data["last_topic"] >> ci->last_topic;
-	data["last_topic_setter"] >> ci->last_topic_setter;
-	data["last_topic_time"] >> ci->last_topic_time;
-	data["bantype"] >> ci->bantype;
+	ci->desc = data.GetString("description");
+	ci->time_registered = data.GetInt("time_registered", ci->time_registered);
+	ci->last_used = data.GetInt("last_used", ci->last_used);
+	ci->last_topic = data.GetString("last_topic");
+	ci->last_topic_setter = data.GetString("last_topic_setter");
+	ci->last_topic_time = data.GetInt("last_topic_time", ci->last_topic_time);
+	ci->bantype = data.GetInt("bantype", ci->bantype);
 	{
 		std::vector<Anope::string> v;
 		spacesepstream(slevels).GetTokens(v);
@@ -243,6 +244,7 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 				ci->levels[v[i]] = convertTo<int16_t>(v[i + 1]);
 			}
 			catch (const ConvertException &) { }
+		ci->levels_generation = AccessCache::NewGeneration();
 	}
 	BotInfo *bi = BotInfo::Find(sbi, true);
 	if (*ci->bi != bi)
@@ -252,12 +254,11 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 		else if (ci->bi)
 			ci->bi->UnAssign(NULL, ci);
 	}
-	data["banexpire"] >> ci->banexpire;
-	data["memomax"] >> ci->memos.memomax;
+	ci->banexpire = data.GetInt("banexpire", ci->banexpire);
+	ci->memos.memomax = data.GetInt("memomax", ci->memos.memomax);
 	{
 		Anope::string buf;
-		data["memoignores"] >> buf;
-		spacesepstream sep(buf);
+		spacesepstream sep(data.GetString("memoignores"));
 		ci->memos.ignores.clear();
 		while (sep.GetToken(buf))
 			ci->memos.ignores.push_back(buf);
@@ -266,50 +267,27 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 	Extensible::ExtensibleUnserialize(ci, ci, data);
 
 	/* compat */
-	bool b;
-	b = false;
-	data["extensible:SECURE"] >> b;
-	if (b)
+	if (data.GetInt("extensible:SECURE"))
 		ci->Extend<bool>("CS_SECURE");
-	b = false;
-	data["extensible:PRIVATE"] >> b;
-	if (b)
+	if (data.GetInt("extensible:PRIVATE"))
 		ci->Extend<bool>("CS_PRIVATE");
-	b = false;
-	data["extensible:NO_EXPIRE"] >> b;
-	if (b)
+	if (data.GetInt("extensible:NO_EXPIRE"))
 		ci->Extend<bool>("CS_NO_EXPIRE");
-	b = false;
-	data["extensible:FANTASY"] >> b;
-	if (b)
+	if (data.GetInt("extensible:FANTASY"))
 		ci->Extend<bool>("BS_FANTASY");
-	b = false;
-	data["extensible:GREET"] >> b;
-	if (b)
+	if (data.GetInt("extensible:GREET"))
 		ci->Extend<bool>("BS_GREET");
-	b = false;
-	data["extensible:PEACE"] >> b;
-	if (b)
+	if (data.GetInt("extensible:PEACE"))
 		ci->Extend<bool>("PEACE");
-	b = false;
-	data["extensible:SECUREFOUNDER"] >> b;
-	if (b)
+	if (data.GetInt("extensible:SECUREFOUNDER"))
 		ci->Extend<bool>("SECUREFOUNDER");
-	b = false;
-	data["extensible:RESTRICTED"] >> b;
-	if (b)
+	if (data.GetInt("extensible:RESTRICTED"))
 		ci->Extend<bool>("RESTRICTED");
-	b = false;
-	data["extensible:KEEPTOPIC"] >> b;
-	if (b)
+	if (data.GetInt("extensible:KEEPTOPIC"))
 		ci->Extend<bool>("KEEPTOPIC");
-	b = false;
-	data["extensible:SIGNKICK"] >> b;
-	if (b)
+	if (data.GetInt("extensible:SIGNKICK"))
 		ci->Extend<bool>("SIGNKICK");
-	b = false;
-	data["extensible:SIGNKICK_LEVEL"] >> b;
-	if (b)
+	if (data.GetInt("extensible:SIGNKICK_LEVEL"))
 		ci->Extend<bool>("SIGNKICK_LEVEL");
 	/* end compat */
 
@@ -332,6 +310,8 @@ void ChannelInfo::SetFounder(NickCore *nc)
 		++this->founder->channelcount;
 		this->founder->AddChannelReference(this);
 	}
+
+	this->QueueUpdate();
 }
 
 NickCore *ChannelInfo::GetFounder() const
@@ -346,6 +326,7 @@ void ChannelInfo::SetSuccessor(NickCore *nc)
 	this->successor = nc;
 	if (this->successor)
 		this->successor->AddChannelReference(this);
+	this->QueueUpdate();
 }
 
 NickCore *ChannelInfo::GetSuccessor() const
@@ -371,6 +352,7 @@ BotInfo *ChannelInfo::WhoSends() const
 void ChannelInfo::AddAccess(ChanAccess *taccess)
 {
 	this->access->push_back(taccess);
+	AccessCache::Invalidate();
 }
 
 ChanAccess *ChannelInfo::GetAccess(unsigned index) const
@@ -378,9 +360,7 @@ ChanAccess *ChannelInfo::GetAccess(unsigned index) const
 	if (this->access->empty() || index >= this->access->size())
 		return NULL;
 
-	ChanAccess *acc = (*this->access)[index];
-	acc->QueueUpdate();
-	return acc;
+	return (*this->access)[index];
 }
 
 static void FindMatchesRecurse(ChannelInfo *ci, const User *u, const NickCore *account, unsigned int depth, std::vector<ChanAccess::Path> &paths, ChanAccess::Path &path)
@@ -416,6 +396,32 @@ static void FindMatches(AccessGroup &group, ChannelInfo *ci, const User *u, cons
 	FindMatchesRecurse(ci, u, account, 0, group.paths, path);
 }
 
+template<typename T> static bool FindMemoizedMatches(TR1NS::unordered_map<const T *, ChannelInfo::MemoizedAccess> &memos, size_t max_memos, AccessGroup &group, ChannelInfo *ci, const T *key, uint64_t user_generation, const User *u, const NickCore *account)
+{
+	typename TR1NS::unordered_map<const T *, ChannelInfo::MemoizedAccess>::iterator it = memos.find(key);
+	if (it != memos.end() && it->second.generation == AccessCache::Generation() && it->second.user_generation == user_generation)
+	{
+		++AccessCache::hits;
+		group.paths = it->second.paths;
+		return true;
+	}
+
+	++AccessCache::misses;
+	FindMatches(group, ci, u, account);
+
+	if (it == memos.end())
+	{
+		/* Entries of users who have gone away are never looked up again */
+		if (memos.size() >= max_memos)
+			memos.clear();
+		it = memos.insert(std::make_pair(key, ChannelInfo::MemoizedAccess())).first;
+	}
+	it->second.generation = AccessCache::Generation();
+	it->second.user_generation = user_generation;
+	it->second.paths = group.paths;
+	return false;
+}
+
 AccessGroup ChannelInfo::AccessFor(const User *u, bool updateLastUsed)
 {
 	AccessGroup group;
@@ -436,19 +442,28 @@ AccessGroup ChannelInfo::AccessFor(const User *u, bool updateLastUsed)
 	group.ci = this;
 	group.nc = nc;
 
-	FindMatches(group, this, u, u->Account());
+	/* Let the access list reload if it has changed in the database */
+	this->access->size();
+	FindMemoizedMatches(this->user_access, 64 + 2 * (this->c ? this->c->users.size() : 0), group, this, u, u->access_generation, u, u->Account());
 
 	if (group.founder || !group.paths.empty())
 	{
-		if (updateLastUsed)
+		if (updateLastUsed && this->last_used != Anope::CurTime)
+		{
 			this->last_used = Anope::CurTime;
+			this->QueueUpdate();
+		}
 
 		for (unsigned i = 0; i < group.paths.size(); ++i)
 		{
 			ChanAccess::Path &p = group.paths[i];
 
 			for (unsigned int j = 0; j < p.size(); ++j)
-				p[j]->last_seen = Anope::CurTime;
+				if (p[j]->last_seen != Anope::CurTime)
+				{
+					p[j]->last_seen = Anope::CurTime;
+					p[j]->QueueUpdate();
+				}
 		}
 	}
 
@@ -463,17 +478,25 @@ AccessGroup ChannelInfo::AccessFor(const NickCore *nc, bool updateLastUsed)
 	group.ci = this;
 	group.nc = nc;
 
-	FindMatches(group, this, NULL, nc);
+	this->access->size();
+	FindMemoizedMatches(this->account_access, 64, group, this, nc, 0, NULL, nc);
 
-	if (group.founder || !group.paths.empty())
-		if (updateLastUsed)
-			this->last_used = Anope::CurTime;
+	if ((group.founder || !group.paths.empty()) && updateLastUsed && this->last_used != Anope::CurTime)
+	{
+		this->last_used = Anope::CurTime;
+		this->QueueUpdate();
+	}
 
 	/* don't update access last seen here, this isn't the user requesting access */
 
 	return group;
 }
 
+void ChannelInfo::ForgetAccess(const User *u)
+{
+	this->user_access.erase(u);
+}
+
 unsigned ChannelInfo::GetAccessCount() const
 {
 	return this->access->size();
@@ -516,6 +539,7 @@ ChanAccess *ChannelInfo::EraseAccess(unsigned index)
 
 	ChanAccess *ca = this->access->at(index);
 	this->access->erase(this->access->begin() + index);
+	AccessCache::Invalidate();
 	return ca;
 }
 
@@ -563,9 +587,7 @@ AutoKick *ChannelInfo::GetAkick(unsigned index) const
 	if (this->akick->empty() || index >= this->akick->size())
 		return NULL;
 
-	AutoKick *ak = (*this->akick)[index];
-	ak->QueueUpdate();
-	return ak;
+	return (*this->akick)[index];
 }
 
 unsigned ChannelInfo::GetAkickCount() const
@@ -594,16 +616,35 @@ const Anope::map<int16_t> &ChannelInfo::GetLevelEntries()
 
 int16_t ChannelInfo::GetLevel(const Anope::string &priv) const
 {
-	if (PrivilegeManager::FindPrivilege(priv) == NULL)
+	const Privilege *p = PrivilegeManager::FindPrivilege(priv);
+	if (p == NULL)
 	{
 		Log(LOG_DEBUG) << "Unknown privilege " + priv;
 		return ACCESS_INVALID;
 	}
 
-	Anope::map<int16_t>::const_iterator it = this->levels.find(priv);
-	if (it == this->levels.end())
-		return 0;
-	return it->second;
+	return this->GetLevel(*p);
+}
+
+int16_t ChannelInfo::GetLevel(const Privilege &priv) const
+{
+	if (this->compiled_generation != PrivilegeManager::GetGeneration() || this->compiled_levels_generation != this->levels_generation)
+	{
+		const std::vector<Privilege> &privileges = PrivilegeManager::GetPrivileges();
+
+		/* Privileges which aren't registered are invalid */
+		this->compiled_levels.assign(PrivilegeManager::GetPrivilegeIdCount(), ACCESS_INVALID);
+		for (unsigned i = 0; i < privileges.size(); ++i)
+		{
+			Anope::map<int16_t>::const_iterator it = this->levels.find(privileges[i].name);
+			this->compiled_levels[privileges[i].id] = it != this->levels.end() ? it->second : 0;
+		}
+
+		this->compiled_generation = PrivilegeManager::GetGeneration();
+		this->compiled_levels_generation = this->levels_generation;
+	}
+
+	return priv.id < this->compiled_levels.size() ? this->compiled_levels[priv.id] : ACCESS_INVALID;
 }
 
 void ChannelInfo::SetLevel(const Anope::string &priv, int16_t level)
@@ -615,16 +656,24 @@ void ChannelInfo::SetLevel(const Anope::string &priv, int16_t level)
 	}
 
 	this->levels[priv] = level;
+	this->levels_generation = AccessCache::NewGeneration();
+	this->QueueUpdate();
 }
 
 void ChannelInfo::RemoveLevel(const Anope::string &priv)
 {
-	this->levels.erase(priv);
+	if (this->levels.erase(priv))
+	{
+		this->levels_generation = AccessCache::NewGeneration();
+		this->QueueUpdate();
+	}
 }
 
 void ChannelInfo::ClearLevels()
 {
 	this->levels.clear();
+	this->levels_generation = AccessCache::NewGeneration();
+	this->QueueUpdate();
 }
 
 Anope::string ChannelInfo::GetIdealBan(User *u) const
@@ -650,10 +699,7 @@ ChannelInfo* ChannelInfo::Find(const Anope::string &name)
 {
 	registered_channel_map::const_iterator it = RegisteredChannelList->find(name);
 	if (it != RegisteredChannelList->end())
-	{
-		it->second->QueueUpdate();
 		return it->second;
-	}
 
 	return NULL;
 }
@@ -24,6 +24,15 @@ using namespace Serialize;
 std::vector<Anope::string> Type::TypeOrder;
 std::map<Anope::string, Type *> Serialize::Type::Types;
 std::list<Serializable *> *Serializable::SerializableItems;
+std::list<Serializable *> *Serializable::DirtyItems;
+
+/* How deep we are in Type::Unserialize, objects are not marked as changed while loading them */
+static unsigned unserializing = 0;
+
+/* The current loop iteration, types are only checked once in each */
+static unsigned long iteration = 1;
+
+unsigned long Serialize::Counters::updates = 0, Serialize::Counters::updates_suppressed = 0, Serialize::Counters::checks = 0, Serialize::Counters::checks_suppressed = 0;
 
 void Serialize::RegisterTypes()
 {
@@ -41,7 +50,104 @@ void Serialize::CheckTypes()
 	}
 }
 
-Serializable::Serializable(const Anope::string &serialize_type) : last_commit(0), last_commit_time(0), id(0), redis_ignore(0)
+void Serialize::FlushUpdates()
+{
+	std::list<Serializable *> *dirty = Serializable::DirtyItems;
+	while (dirty != NULL && !dirty->empty())
+	{
+		Serializable *s = dirty->front();
+		dirty->pop_front();
+		s->dirty = false;
+
+		++Counters::updates;
+		FOREACH_MOD(OnSerializableUpdate, (s));
+	}
+
+	++iteration;
+}
+
+static const uint64_t uint64_max = static_cast<uint64_t>(-1);
+static const uint64_t int64_max = uint64_max >> 1;
+
+static bool ParseDigits(const char *&p, const char *end, bool &negative, uint64_t &value, bool &overflow)
+{
+	negative = false;
+	if (p != end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	value = 0;
+	overflow = false;
+	const char *start = p;
+	for (; p != end && *p >= '0' && *p <= '9'; ++p)
+	{
+		unsigned digit = *p - '0';
+		if (value > (uint64_max - digit) / 10)
+			overflow = true;
+		else
+			value = value * 10 + digit;
+	}
+	return p != start;
+}
+
+int64_t Serialize::ParseInt(const Anope::string_view &value, int64_t def)
+{
+	const char *p = value.data(), *end = p + value.length();
+	while (p != end && isspace(static_cast<unsigned char>(*p)))
+		++p;
+	if (p == end)
+		return def;
+
+	bool negative, overflow;
+	uint64_t i;
+	if (!ParseDigits(p, end, negative, i, overflow))
+		return 0;
+
+	if (negative)
+		return overflow || i > int64_max ? -static_cast<int64_t>(int64_max) - 1 : -static_cast<int64_t>(i);
+	return overflow || i > int64_max ? static_cast<int64_t>(int64_max) : static_cast<int64_t>(i);
+}
+
+uint64_t Serialize::ParseUInt(const Anope::string_view &value, uint64_t def)
+{
+	const char *p = value.data(), *end = p + value.length();
+	while (p != end && isspace(static_cast<unsigned char>(*p)))
+		++p;
+	if (p == end)
+		return def;
+
+	bool negative, overflow;
+	uint64_t i;
+	if (!ParseDigits(p, end, negative, i, overflow))
+		return 0;
+
+	if (overflow)
+		return uint64_max;
+	/* Like a stream, a negative number wraps around */
+	return negative ? 0 - i : i;
+}
+
+Anope::string_view Serialize::FormatUInt(char *buf, uint64_t value)
+{
+	char *end = buf + 20, *p = end;
+	do
+		*--p = '0' + value % 10;
+	while (value /= 10);
+	return Anope::string_view(p, end - p);
+}
+
+Anope::string_view Serialize::FormatInt(char *buf, int64_t value)
+{
+	if (value >= 0)
+		return FormatUInt(buf, value);
+
+	/* The magnitude of INT64_MIN has 19 digits, leaving room for the sign */
+	Anope::string_view digits = FormatUInt(buf, 0 - static_cast<uint64_t>(value));
+	char *p = const_cast<char *>(digits.data()) - 1;
+	*p = '-';
+	return Anope::string_view(p, digits.length() + 1);
+}
+
+Serializable::Serializable(const Anope::string &serialize_type) : dirty(false), id(0), redis_ignore(0)
 {
 	if (SerializableItems == NULL)
 		SerializableItems = new std::list<Serializable *>();
@@ -55,7 +161,7 @@ Serializable::Serializable(const Anope::string &serialize_type) : last_commit(0)
 	FOREACH_MOD(OnSerializableConstruct, (this));
 }
 
-Serializable::Serializable(const Serializable &other) : last_commit(0), last_commit_time(0), id(0), redis_ignore(0)
+Serializable::Serializable(const Serializable &other) : dirty(false), id(0), redis_ignore(0)
 {
 	SerializableItems->push_back(this);
 	this->s_iter = SerializableItems->end();
@@ -71,6 +177,8 @@ Serializable::~Serializable()
 	FOREACH_MOD(OnSerializableDestruct, (this));
 
 	SerializableItems->erase(this->s_iter);
+	if (this->dirty)
+		DirtyItems->erase(this->d_iter);
 }
 
 Serializable &Serializable::operator=(const Serializable &)
@@ -80,31 +188,19 @@ Serializable &Serializable::operator=(const Serializable &)
 
 void Serializable::QueueUpdate()
 {
-	/* Schedule updater */
-	FOREACH_MOD(OnSerializableUpdate, (this));
-
-	/* Check for modifications now - this can delete this object! */
-	FOREACH_MOD(OnSerializeCheck, (this->GetSerializableType()));
-}
-
-bool Serializable::IsCached(Serialize::Data &data)
-{
-	return this->last_commit == data.Hash();
-}
-
-void Serializable::UpdateCache(Serialize::Data &data)
-{
-	this->last_commit = data.Hash();
-}
+	if (unserializing)
+		return;
 
-bool Serializable::IsTSCached()
-{
-	return this->last_commit_time == Anope::CurTime;
-}
+	if (this->dirty || ModuleManager::EventHandlers[I_OnSerializableUpdate].empty())
+	{
+		++Serialize::Counters::updates_suppressed;
+		return;
+	}
 
-void Serializable::UpdateTS()
-{
-	this->last_commit_time = Anope::CurTime;
+	if (DirtyItems == NULL)
+		DirtyItems = new std::list<Serializable *>();
+	this->d_iter = DirtyItems->insert(DirtyItems->end(), this);
+	this->dirty = true;
 }
 
 const std::list<Serializable *> &Serializable::GetItems()
@@ -112,7 +208,7 @@ const std::list<Serializable *> &Serializable::GetItems()
 	return *SerializableItems;
 }
 
-Type::Type(const Anope::string &n, unserialize_func f, Module *o)  : name(n), unserialize(f), owner(o), timestamp(0)
+Type::Type(const Anope::string &n, unserialize_func f, Module *o)  : name(n), unserialize(f), owner(o), timestamp(0), checked(0)
 {
 	TypeOrder.push_back(this->name);
 	Types[this->name] = this;
@@ -140,11 +236,33 @@ Type::~Type()
 
 Serializable *Type::Unserialize(Serializable *obj, Serialize::Data &data)
 {
-	return this->unserialize(obj, data);
+	/* What is loaded is already in the database */
+	++unserializing;
+	try
+	{
+		obj = this->unserialize(obj, data);
+	}
+	catch (...)
+	{
+		--unserializing;
+		throw;
+	}
+	--unserializing;
+	return obj;
 }
 
 void Type::Check()
 {
+	/* This is called on every access through a Reference or Checker, so only the first one in a loop iteration is passed on */
+	if (this->checked == iteration || ModuleManager::EventHandlers[I_OnSerializeCheck].empty())
+	{
+		++Counters::checks_suppressed;
+		return;
+	}
+
+	/* Set first, the modules may access objects of this type while checking it */
+	this->checked = iteration;
+	++Counters::checks;
 	FOREACH_MOD(OnSerializeCheck, (this));
 }
 
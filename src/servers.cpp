@@ -23,7 +23,7 @@
 Server *Me = NULL;
 
 Anope::map<Server *> Servers::ByName;
-Anope::map<Server *> Servers::ByID;
+Anope::id_map<Server *> Servers::ByID;
 
 std::set<Anope::string> Servers::Capab;
 
@@ -335,16 +335,14 @@ void Server::Notice(BotInfo *source, const Anope::string &message)
 
 Server *Server::Find(const Anope::string &name, bool name_only)
 {
-	Anope::map<Server *>::iterator it;
-
 	if (!name_only)
 	{
-		it = Servers::ByID.find(name);
-		if (it != Servers::ByID.end())
-			return it->second;
+		Server *s = Servers::ByID.Find(name);
+		if (s)
+			return s;
 	}
 
-	it = Servers::ByName.find(name);
+	Anope::map<Server *>::iterator it = Servers::ByName.find(name);
 	if (it != Servers::ByName.end())
 		return it->second;
 
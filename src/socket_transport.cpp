@@ -13,7 +13,141 @@
 #include "sockets.h"
 #include "socketengine.h"
 
-BufferedSocket::BufferedSocket()
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+/* How many chunks are given to one writev() */
+static const int MaxIOVecs = 16;
+
+SendQueue::SendQueue() : spare(NULL), length(0)
+{
+}
+
+SendQueue::~SendQueue()
+{
+	for (unsigned i = 0; i < this->chunks.size(); ++i)
+		delete this->chunks[i];
+	delete this->spare;
+}
+
+void SendQueue::Append(const char *data, size_t len)
+{
+	this->length += len;
+
+	while (len)
+	{
+		Chunk *c = this->chunks.empty() ? NULL : this->chunks.back();
+		if (c == NULL || c->end == ChunkSize)
+		{
+			if (this->spare != NULL)
+			{
+				c = this->spare;
+				this->spare = NULL;
+			}
+			else
+				c = new Chunk();
+			c->start = c->end = 0;
+			this->chunks.push_back(c);
+		}
+
+		size_t n = std::min(len, ChunkSize - c->end);
+		memcpy(c->data + c->end, data, n);
+		c->end += n;
+		data += n;
+		len -= n;
+	}
+}
+
+const char *SendQueue::GetBlock(size_t index, size_t &len) const
+{
+	if (index >= this->chunks.size())
+	{
+		len = 0;
+		return NULL;
+	}
+
+	const Chunk *c = this->chunks[index];
+	len = c->end - c->start;
+	return c->data + c->start;
+}
+
+void SendQueue::Consume(size_t len)
+{
+	len = std::min(len, this->length);
+	this->length -= len;
+
+	while (len)
+	{
+		Chunk *c = this->chunks.front();
+		size_t n = std::min(len, c->end - c->start);
+		c->start += n;
+		len -= n;
+
+		if (c->start == c->end)
+		{
+			this->chunks.pop_front();
+			if (this->spare == NULL)
+				this->spare = c;
+			else
+				delete c;
+		}
+	}
+}
+
+int SendQueue::Flush(Socket *s)
+{
+#ifndef _WIN32
+	/* Other SocketIOs (SSL) only know how to send one buffer at a time */
+	if (s->io == &NormalSocketIO)
+	{
+		iovec iov[MaxIOVecs];
+		int count = 0;
+		for (size_t len; count < MaxIOVecs && (iov[count].iov_base = const_cast<char *>(this->GetBlock(count, len))) != NULL; ++count)
+			iov[count].iov_len = len;
+
+		if (!count)
+			return 0;
+
+		size_t want = 0;
+		for (int j = 0; j < count; ++j)
+			want += iov[j].iov_len;
+
+		ssize_t i = writev(s->GetFD(), iov, count);
+		s->flags[SF_WRITE_BLOCKED] = i < 0 || static_cast<size_t>(i) < want;
+		if (i > 0)
+		{
+			TotalWritten += i;
+			this->Consume(i);
+		}
+		return i;
+	}
+#endif
+
+	int total = 0;
+	size_t len;
+	s->flags[SF_WRITE_BLOCKED] = false;
+	for (const char *block; (block = this->GetBlock(0, len)) != NULL;)
+	{
+		int i = s->io->Send(s, block, len);
+		if (i <= 0)
+		{
+			s->flags[SF_WRITE_BLOCKED] = i < 0;
+			return total ? total : i;
+		}
+
+		total += i;
+		this->Consume(i);
+		if (static_cast<size_t>(i) < len)
+		{
+			s->flags[SF_WRITE_BLOCKED] = true;
+			break;
+		}
+	}
+	return total;
+}
+
+BufferedSocket::BufferedSocket() : read_offset(0), read_end(0), recv_len(0), write_high_water(0)
 {
 }
 
@@ -23,18 +157,35 @@ BufferedSocket::~BufferedSocket()
 
 bool BufferedSocket::ProcessRead()
 {
-	char tbuffer[NET_BUFSIZE];
-
 	this->recv_len = 0;
 
-	int len = this->io->Recv(this, tbuffer, sizeof(tbuffer) - 1);
+	if (this->read_offset == this->read_end)
+		this->read_offset = this->read_end = 0;
+	else if (this->read_offset > this->read_buffer.size() / 2)
+	{
+		memmove(&this->read_buffer[0], &this->read_buffer[this->read_offset], this->read_end - this->read_offset);
+		this->read_end -= this->read_offset;
+		this->read_offset = 0;
+	}
+
+	if (this->read_buffer.size() - this->read_end < NET_BUFSIZE - 1)
+		this->read_buffer.resize(this->read_end + NET_BUFSIZE - 1);
+
+	int len = this->io->Recv(this, &this->read_buffer[this->read_end], NET_BUFSIZE - 1);
 	if (len == 0)
 		return false;
 	if (len < 0)
+	{
+		this->flags[SF_READ_BLOCKED] = true;
 		return SocketEngine::IgnoreErrno();
+	}
 
-	tbuffer[len] = 0;
-	this->read_buffer.append(tbuffer);
+	/* A short read from the kernel means it was drained, however other
+	 * SocketIOs (SSL) may still have data buffered, so those read until
+	 * they would block.
+	 */
+	this->flags[SF_READ_BLOCKED] = this->io == &NormalSocketIO && len < NET_BUFSIZE - 1;
+	this->read_end += len;
 	this->recv_len = len;
 
 	return true;
@@ -42,13 +193,19 @@ bool BufferedSocket::ProcessRead()
 
 bool BufferedSocket::ProcessWrite()
 {
-	int count = this->io->Send(this, this->write_buffer);
+	if (this->write_buffer.empty())
+	{
+		this->flags[SF_WRITE_BLOCKED] = false;
+		SocketEngine::Change(this, false, SF_WRITABLE);
+		return true;
+	}
+
+	int count = this->write_buffer.Flush(this);
 	if (count == 0)
 		return false;
 	if (count < 0)
 		return SocketEngine::IgnoreErrno();
 
-	this->write_buffer = this->write_buffer.substr(count);
 	if (this->write_buffer.empty())
 		SocketEngine::Change(this, false, SF_WRITABLE);
 
@@ -57,19 +214,59 @@ bool BufferedSocket::ProcessWrite()
 
 const Anope::string BufferedSocket::GetLine()
 {
-	size_t s = this->read_buffer.find('\n');
-	if (s == Anope::string::npos)
+	Anope::string_view line;
+	if (!this->GetLine(line))
 		return "";
-	Anope::string str = this->read_buffer.substr(0, s + 1);
-	this->read_buffer.erase(0, s + 1);
-	this->read_buffer.ltrim("\r\n");
-	return str.trim("\r\n");
+	return line.str();
+}
+
+bool BufferedSocket::GetLine(Anope::string_view &line)
+{
+	while (this->read_offset < this->read_end)
+	{
+		const char *begin = &this->read_buffer[this->read_offset];
+		const char *nl = static_cast<const char *>(memchr(begin, '\n', this->read_end - this->read_offset));
+		if (nl == NULL)
+			return false;
+
+		this->read_offset += nl - begin + 1;
+
+		/* Blank lines (and so any extra \r or \n) are skipped */
+		const char *end = nl;
+		while (end > begin && end[-1] == '\r')
+			--end;
+		while (begin < end && *begin == '\r')
+			++begin;
+		if (begin == end)
+			continue;
+
+		line = Anope::string_view(begin, end - begin);
+		return true;
+	}
+
+	return false;
+}
+
+size_t BufferedSocket::ReadLines(std::vector<Anope::string_view> &lines)
+{
+	size_t count = 0;
+	for (Anope::string_view line; this->GetLine(line); ++count)
+		lines.push_back(line);
+	return count;
 }
 
 void BufferedSocket::Write(const char *buffer, size_t l)
 {
-	this->write_buffer += buffer + Anope::string("\r\n");
+	this->write_buffer.Append(buffer, l);
+	this->write_buffer.Append("\r\n", 2);
 	SocketEngine::Change(this, true, SF_WRITABLE);
+
+	/* This leaves the socket marked writable, so errors (and subclasses
+	 * which close once everything is sent) are still handled by
+	 * ProcessWrite() when the socket engine next calls it.
+	 */
+	if (this->IsWriteBufferFull() && !this->flags[SF_CONNECTING] && !this->flags[SF_ACCEPTING])
+		this->write_buffer.Flush(this);
 }
 
 void BufferedSocket::Write(const char *message, ...)
@@ -84,7 +281,10 @@ void BufferedSocket::Write(const char *message, ...)
 	int len = vsnprintf(tbuffer, sizeof(tbuffer), message, vi);
 	va_end(vi);
 
-	this->Write(tbuffer, std::min(len, static_cast<int>(sizeof(tbuffer))));
+	if (len < 0)
+		return;
+
+	this->Write(tbuffer, std::min(len, static_cast<int>(sizeof(tbuffer) - 1)));
 }
 
 void BufferedSocket::Write(const Anope::string &message)
@@ -99,23 +299,21 @@ int BufferedSocket::ReadBufferLen() const
 
 int BufferedSocket::WriteBufferLen() const
 {
-	return this->write_buffer.length();
+	return this->write_buffer.size();
 }
 
-
-BinarySocket::DataBlock::DataBlock(const char *b, size_t l)
+void BufferedSocket::SetWriteHighWater(size_t len)
 {
-	this->orig = this->buf = new char[l];
-	memcpy(this->buf, b, l);
-	this->len = l;
+	this->write_high_water = len;
 }
 
-BinarySocket::DataBlock::~DataBlock()
+bool BufferedSocket::IsWriteBufferFull() const
 {
-	delete [] this->orig;
+	return this->write_high_water && this->write_buffer.size() > this->write_high_water;
 }
 
-BinarySocket::BinarySocket()
+
+BinarySocket::BinarySocket() : write_high_water(0)
 {
 }
 
@@ -128,9 +326,16 @@ bool BinarySocket::ProcessRead()
 	char tbuffer[NET_BUFSIZE];
 
 	int len = this->io->Recv(this, tbuffer, sizeof(tbuffer));
-	if (len <= 0)
+	if (len == 0)
 		return false;
+	if (len < 0)
+	{
+		this->flags[SF_READ_BLOCKED] = true;
+		return SocketEngine::IgnoreErrno();
+	}
 
+	/* See BufferedSocket::ProcessRead() */
+	this->flags[SF_READ_BLOCKED] = this->io == &NormalSocketIO && static_cast<size_t>(len) < sizeof(tbuffer);
 	return this->Read(tbuffer, len);
 }
 
@@ -138,25 +343,14 @@ bool BinarySocket::ProcessWrite()
 {
 	if (this->write_buffer.empty())
 	{
+		this->flags[SF_WRITE_BLOCKED] = false;
 		SocketEngine::Change(this, false, SF_WRITABLE);
 		return true;
 	}
 
-	DataBlock *d = this->write_buffer.front();
-
-	int len = this->io->Send(this, d->buf, d->len);
-	if (len <= -1)
-		return false;
-	else if (static_cast<size_t>(len) == d->len)
-	{
-		delete d;
-		this->write_buffer.pop_front();
-	}
-	else
-	{
-		d->buf += len;
-		d->len -= len;
-	}
+	int len = this->write_buffer.Flush(this);
+	if (len < 0)
+		return SocketEngine::IgnoreErrno();
 
 	if (this->write_buffer.empty())
 		SocketEngine::Change(this, false, SF_WRITABLE);
@@ -168,8 +362,11 @@ void BinarySocket::Write(const char *buffer, size_t l)
 {
 	if (l == 0)
 		return;
-	this->write_buffer.push_back(new DataBlock(buffer, l));
+	this->write_buffer.Append(buffer, l);
 	SocketEngine::Change(this, true, SF_WRITABLE);
+
+	if (this->IsWriteBufferFull() && !this->flags[SF_CONNECTING] && !this->flags[SF_ACCEPTING])
+		this->write_buffer.Flush(this);
 }
 
 void BinarySocket::Write(const char *message, ...)
@@ -184,7 +381,10 @@ void BinarySocket::Write(const char *message, ...)
 	int len = vsnprintf(tbuffer, sizeof(tbuffer), message, vi);
 	va_end(vi);
 
-	this->Write(tbuffer, std::min(len, static_cast<int>(sizeof(tbuffer))));
+	if (len < 0)
+		return;
+
+	this->Write(tbuffer, std::min(len, static_cast<int>(sizeof(tbuffer) - 1)));
 }
 
 void BinarySocket::Write(const Anope::string &message)
@@ -196,3 +396,13 @@ bool BinarySocket::Read(const char *buffer, size_t l)
 {
 	return true;
 }
+
+void BinarySocket::SetWriteHighWater(size_t len)
+{
+	this->write_high_water = len;
+}
+
+bool BinarySocket::IsWriteBufferFull() const
+{
+	return this->write_high_water && this->write_buffer.size() > this->write_high_water;
+}
@@ -14,13 +14,76 @@
 #include "sockets.h"
 #include "socketengine.h"
 #include "config.h"
+#include "timers.h"
 
 #include <sys/epoll.h>
 #include <ulimit.h>
 #include <errno.h>
 
+/* State of each file descriptor, indexed by fd.
+ *
+ * Buffered and binary sockets are moved to edge triggered registration the
+ * first time they are dispatched, after which toggling SF_READABLE or
+ * SF_WRITABLE never calls epoll_ctl(). As edges are only reported once, the
+ * engine remembers which directions are ready and keeps dispatching the
+ * socket, without waiting in epoll_wait, until ProcessRead() or
+ * ProcessWrite() report that it would block (SF_READ_BLOCKED and
+ * SF_WRITE_BLOCKED).
+ * Every other socket (listeners, pipes, DNS) stays level triggered.
+ */
+struct EpollSlot
+{
+	Socket *sock;
+	/* Bumped every time the fd is registered, stored in epoll_event.data so
+	 * events for a closed and reused fd are recognised as stale.
+	 */
+	uint32_t generation;
+	bool edge;
+	bool read_ready, write_ready;
+	/* Whether the fd is already in the ready list */
+	bool queued;
+
+	EpollSlot() : sock(NULL), generation(0), edge(false), read_ready(false), write_ready(false), queued(false) { }
+};
+
 static int EngineHandle;
 static std::vector<epoll_event> events;
+static std::vector<EpollSlot> slots;
+/* Sockets with an outstanding edge, dispatched by the next Process() */
+static std::vector<int> ready, dispatching;
+/* epoll_ctl calls made and events dispatched since the end of the last Process() */
+static unsigned changes, dispatched;
+
+static EpollSlot &Slot(int fd)
+{
+	if (static_cast<size_t>(fd) >= slots.size())
+		slots.resize(fd + 1);
+	return slots[fd];
+}
+
+static void Control(int mod, int fd, uint32_t mask)
+{
+	epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+
+	ev.events = mask;
+	ev.data.u64 = (static_cast<uint64_t>(Slot(fd).generation) << 32) | static_cast<uint32_t>(fd);
+
+	++changes;
+	if (epoll_ctl(EngineHandle, mod, fd, &ev) == -1)
+		throw SocketException("Unable to epoll_ctl() fd " + stringify(fd) + " to epoll: " + Anope::LastError());
+}
+
+static void Queue(int fd)
+{
+	EpollSlot &slot = Slot(fd);
+	if (!slot.queued)
+	{
+		slot.queued = true;
+		ready.push_back(fd);
+	}
+}
 
 void SocketEngine::Init()
 {
@@ -49,25 +112,80 @@ void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
 
 	bool now_registered = s->flags[SF_READABLE] || s->flags[SF_WRITABLE];
 
-	epoll_event ev;
+	int fd = s->GetFD();
 
-	memset(&ev, 0, sizeof(ev));
-
-	ev.events = (s->flags[SF_READABLE] ? EPOLLIN : 0) | (s->flags[SF_WRITABLE] ? EPOLLOUT : 0);
-	ev.data.fd = s->GetFD();
-
-	int mod;
 	if (!before_registered && now_registered)
-		mod = EPOLL_CTL_ADD;
+	{
+		EpollSlot &slot = Slot(fd);
+		slot.sock = s;
+		++slot.generation;
+		slot.edge = slot.read_ready = slot.write_ready = false;
+		Control(EPOLL_CTL_ADD, fd, (s->flags[SF_READABLE] ? EPOLLIN : 0) | (s->flags[SF_WRITABLE] ? EPOLLOUT : 0));
+	}
 	else if (before_registered && !now_registered)
-		mod = EPOLL_CTL_DEL;
+	{
+		Control(EPOLL_CTL_DEL, fd, 0);
+		/* Anything still in the ready list for this fd is dropped when it comes up */
+		Slot(fd).sock = NULL;
+	}
 	else if (before_registered && now_registered)
-		mod = EPOLL_CTL_MOD;
-	else
-		return;
+	{
+		EpollSlot &slot = Slot(fd);
+		if (!slot.edge)
+			Control(EPOLL_CTL_MOD, fd, (s->flags[SF_READABLE] ? EPOLLIN : 0) | (s->flags[SF_WRITABLE] ? EPOLLOUT : 0));
+		/* Already told the fd is ready, so no new edge is coming for it */
+		else if (set && ((flag == SF_WRITABLE && slot.write_ready) || (flag == SF_READABLE && slot.read_ready)))
+			Queue(fd);
+	}
+}
+
+/* Dispatch the events for one socket, returns false if it was deleted.
+ * Slots are looked up again after every callback, as creating sockets
+ * may grow the table.
+ */
+static bool Dispatch(Socket *s, int fd, bool readable, bool writable)
+{
+	if (!s->Process())
+	{
+		if (s->flags[SF_DEAD])
+		{
+			delete s;
+			return false;
+		}
+
+		/* Still connecting or accepting, the next step arrives as a new edge */
+		EpollSlot &slot = Slot(fd);
+		if (slot.edge && !s->flags[SF_CONNECTED] && !s->flags[SF_ACCEPTED])
+			slot.read_ready = slot.write_ready = false;
+		return true;
+	}
+
+	/* Sockets which do not say otherwise wait for the next edge */
+	if (readable)
+	{
+		s->flags[SF_READ_BLOCKED] = true;
+		if (!s->ProcessRead())
+			s->flags[SF_DEAD] = true;
+		if (s->flags[SF_READ_BLOCKED])
+			Slot(fd).read_ready = false;
+	}
+
+	if (writable && !s->flags[SF_DEAD])
+	{
+		s->flags[SF_WRITE_BLOCKED] = true;
+		if (!s->ProcessWrite())
+			s->flags[SF_DEAD] = true;
+		if (s->flags[SF_WRITE_BLOCKED])
+			Slot(fd).write_ready = false;
+	}
+
+	if (s->flags[SF_DEAD])
+	{
+		delete s;
+		return false;
+	}
 
-	if (epoll_ctl(EngineHandle, mod, ev.data.fd, &ev) == -1)
-		 throw SocketException("Unable to epoll_ctl() fd " + stringify(ev.data.fd) + " to epoll: " + Anope::LastError());
+	return true;
 }
 
 void SocketEngine::Process()
@@ -75,7 +193,7 @@ void SocketEngine::Process()
 	if (Sockets.size() > events.size())
 		events.resize(events.size() * 2);
 
-	int total = epoll_wait(EngineHandle, &events.front(), events.size(), Config->ReadTimeout * 1000);
+	int total = epoll_wait(EngineHandle, &events.front(), events.size(), ready.empty() ? TimerManager::GetTimeout(Config->ReadTimeout * 1000) : 0);
 	Anope::CurTime = time(NULL);
 
 	/* EINTR can be given if the read timeout expires */
@@ -83,39 +201,77 @@ void SocketEngine::Process()
 	{
 		if (errno != EINTR)
 			Log() << "SockEngine::Process(): error: " << Anope::LastError();
-		return;
+		total = 0;
 	}
 
 	for (int i = 0; i < total; ++i)
 	{
 		epoll_event &ev = events[i];
 
-		std::map<int, Socket *>::iterator it = Sockets.find(ev.data.fd);
-		if (it == Sockets.end())
+		int fd = static_cast<int>(ev.data.u64 & 0xFFFFFFFF);
+		EpollSlot &slot = Slot(fd);
+		if (slot.sock == NULL || slot.generation != ev.data.u64 >> 32)
 			continue;
-		Socket *s = it->second;
+		Socket *s = slot.sock;
 
 		if (ev.events & (EPOLLHUP | EPOLLERR))
 		{
+			++dispatched;
 			s->ProcessError();
 			delete s;
 			continue;
 		}
 
-		if (!s->Process())
+		if (slot.edge)
 		{
-			if (s->flags[SF_DEAD])
-				delete s;
+			slot.read_ready |= (ev.events & EPOLLIN) != 0;
+			slot.write_ready |= (ev.events & EPOLLOUT) != 0;
+			Queue(fd);
 			continue;
 		}
 
-		if ((ev.events & EPOLLIN) && !s->ProcessRead())
-			s->flags[SF_DEAD] = true;
+		++dispatched;
+		if (!Dispatch(s, fd, ev.events & EPOLLIN, ev.events & EPOLLOUT))
+			continue;
 
-		if ((ev.events & EPOLLOUT) && !s->ProcessWrite())
-			s->flags[SF_DEAD] = true;
+		/* Slot may have moved if a new socket was created while dispatching */
+		EpollSlot &current = Slot(fd);
+		if (current.sock == s && !current.edge && (dynamic_cast<BufferedSocket *>(s) || dynamic_cast<BinarySocket *>(s)))
+		{
+			/* Re-registering reports the current state as a new edge */
+			current.edge = true;
+			Control(EPOLL_CTL_MOD, fd, EPOLLIN | EPOLLOUT | EPOLLET);
+		}
+	}
 
-		if (s->flags[SF_DEAD])
-			delete s;
+	dispatching.swap(ready);
+	for (unsigned i = 0; i < dispatching.size(); ++i)
+	{
+		int fd = dispatching[i];
+		Slot(fd).queued = false;
+
+		Socket *s = Slot(fd).sock;
+		if (s == NULL)
+			continue;
+
+		bool readable = Slot(fd).read_ready && s->flags[SF_READABLE], writable = Slot(fd).write_ready && s->flags[SF_WRITABLE];
+		if (!readable && !writable)
+			continue;
+
+		++dispatched;
+		if (!Dispatch(s, fd, readable, writable))
+			continue;
+
+		EpollSlot &slot = Slot(fd);
+		if ((slot.read_ready && s->flags[SF_READABLE]) || (slot.write_ready && s->flags[SF_WRITABLE]))
+			Queue(fd);
 	}
+	dispatching.clear();
+
+	LastEvents = dispatched;
+	LastChanges = changes;
+	TotalEvents += dispatched;
+	TotalChanges += changes;
+	++TotalLoops;
+	dispatched = changes = 0;
 }
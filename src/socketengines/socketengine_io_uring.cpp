@@ -0,0 +1,658 @@
+/*
+ *
+ * (C) 2003-2024 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ *
+ * Based on the original code of Epona by Lara.
+ * Based on the original code of Services by Andy Church.
+ */
+
+#include "services.h"
+#include "anope.h"
+#include "sockets.h"
+#include "socketengine.h"
+#include "config.h"
+#include "timers.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+
+/* The ring is sized for a burst of requests; if it fills up
+ * mid-iteration the pending entries are flushed to the kernel early.
+ */
+static const unsigned RingSize = 256;
+
+/* user_data of the removal and cancel requests we submit, their completions are ignored */
+static const uint64_t RemoveTag = 0;
+
+/* The low bits of user_data say what a request is. Polls carry a sequence
+ * number and fd above them, receives and sends the RingSocketIO they are for.
+ */
+enum RequestType
+{
+	RT_POLL,
+	RT_RECV,
+	RT_SEND,
+	RT_MASK = 3
+};
+
+struct SubmissionRing
+{
+	unsigned *head, *tail, *mask, *array;
+	io_uring_sqe *sqes;
+	unsigned pending;
+};
+
+struct CompletionRing
+{
+	unsigned *head, *tail, *mask;
+	io_uring_cqe *cqes;
+};
+
+/* The I/O of a connected buffered or binary socket using plain sockets, done
+ * through the ring instead of with recv() and send(). A receive is kept
+ * outstanding into a buffer which Recv() hands out, and Send() copies data into
+ * a buffer which is sent in one request once the socket has been dispatched, so
+ * busy sockets cost no syscalls of their own. Sockets using another SocketIO
+ * (SSL) are polled for readiness instead.
+ *
+ * This belongs to its socket until the socket is destroyed, and then to the
+ * engine until its last request has completed.
+ */
+class RingSocketIO : public SocketIO
+{
+ public:
+	static const size_t SendSize = 65536;
+
+	Socket *sock;
+	int fd;
+	/* Whether it is in the ready list */
+	bool queued;
+
+	char recv_buf[NET_BUFSIZE - 1];
+	/* Received data not handed out yet */
+	size_t recv_pos, recv_end;
+	bool receiving, recv_eof;
+	/* errno of a failed receive */
+	int recv_error;
+
+	char send_buf[SendSize];
+	/* Data not sent yet. Whatever is being sent stays put, more is only added after it */
+	size_t send_pos, send_end;
+	bool sending;
+	/* errno of a failed send */
+	int send_error;
+
+	RingSocketIO(Socket *s) : sock(s), fd(s->GetFD()), queued(false), recv_pos(0), recv_end(0), receiving(false), recv_eof(false), recv_error(0),
+		send_pos(0), send_end(0), sending(false), send_error(0) { }
+
+	int Recv(Socket *s, char *buf, size_t sz) anope_override;
+	int Send(Socket *s, const char *buf, size_t sz) anope_override;
+	void Destroy() anope_override;
+
+	bool HasInput() const
+	{
+		return this->recv_pos < this->recv_end || this->recv_eof || this->recv_error;
+	}
+};
+
+/* Poll state of each file descriptor. Polls are armed one shot, and are
+ * rearmed in bulk after their completions have been dispatched, so every
+ * loop iteration costs a single io_uring_enter() regardless of how many
+ * sockets were ready.
+ */
+struct PollSlot
+{
+	/* user_data of the poll currently armed, or RemoveTag */
+	uint64_t user_data;
+	/* Events the armed poll is waiting for */
+	unsigned mask;
+	/* Set once the socket's I/O is done through the ring */
+	RingSocketIO *ring;
+
+	PollSlot() : user_data(RemoveTag), mask(0), ring(NULL) { }
+};
+
+static int EngineHandle = -1;
+static void *sq_ptr, *cq_ptr;
+static size_t sq_len, cq_len, sqes_len;
+static SubmissionRing sq;
+static CompletionRing cq;
+static std::vector<PollSlot> slots;
+/* Poll completions waiting to be dispatched */
+static std::vector<io_uring_cqe> completions;
+/* Sockets with ring I/O to dispatch, and the ones being dispatched */
+static std::vector<RingSocketIO *> ready, dispatching;
+/* Sequence used to tell apart polls armed for a reused fd */
+static uint32_t sequence;
+/* Requests queued and events dispatched since the end of the last Process() */
+static unsigned changes, dispatched;
+
+static int Enter(unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, EngineHandle, to_submit, min_complete, flags, arg, argsz);
+}
+
+static void Flush()
+{
+	while (sq.pending)
+	{
+		int submitted = Enter(sq.pending, 0, 0, NULL, 0);
+		if (submitted < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				continue;
+			throw SocketException("Unable to submit to io_uring: " + Anope::LastError());
+		}
+		sq.pending -= submitted;
+	}
+}
+
+static io_uring_sqe *GetSQE()
+{
+	if (*sq.tail - __atomic_load_n(sq.head, __ATOMIC_ACQUIRE) >= RingSize)
+		Flush();
+
+	unsigned index = *sq.tail & *sq.mask;
+	io_uring_sqe *sqe = &sq.sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sq.array[index] = index;
+	__atomic_store_n(sq.tail, *sq.tail + 1, __ATOMIC_RELEASE);
+	++sq.pending;
+	++changes;
+	return sqe;
+}
+
+static PollSlot &Slot(int fd)
+{
+	if (static_cast<size_t>(fd) >= slots.size())
+		slots.resize(fd + 1);
+	return slots[fd];
+}
+
+static unsigned WantedEvents(Socket *s)
+{
+	return (s->flags[SF_READABLE] ? POLLIN : 0) | (s->flags[SF_WRITABLE] ? POLLOUT : 0);
+}
+
+static void Arm(Socket *s)
+{
+	PollSlot &slot = Slot(s->GetFD());
+	slot.mask = WantedEvents(s);
+	if (!slot.mask)
+		return;
+
+	if (++sequence == 0)
+		++sequence;
+	slot.user_data = ((static_cast<uint64_t>(sequence) << 32) | static_cast<uint32_t>(s->GetFD())) << 2 | RT_POLL;
+
+	io_uring_sqe *sqe = GetSQE();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = s->GetFD();
+	sqe->poll32_events = slot.mask;
+	sqe->user_data = slot.user_data;
+}
+
+static void Disarm(PollSlot &slot)
+{
+	if (slot.user_data == RemoveTag)
+		return;
+
+	io_uring_sqe *sqe = GetSQE();
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = slot.user_data;
+	sqe->user_data = RemoveTag;
+
+	slot.user_data = RemoveTag;
+	slot.mask = 0;
+}
+
+static uint64_t UserData(RingSocketIO *io, RequestType type)
+{
+	return reinterpret_cast<uintptr_t>(io) | type;
+}
+
+static void Queue(RingSocketIO *io)
+{
+	if (!io->queued)
+	{
+		io->queued = true;
+		ready.push_back(io);
+	}
+}
+
+/* Free the I/O of a destroyed socket once the kernel is done with it */
+static void Release(RingSocketIO *io)
+{
+	if (!io->sock && !io->receiving && !io->sending && !io->queued)
+		delete io;
+}
+
+static void Receive(RingSocketIO *io)
+{
+	if (!io->sock || !io->sock->flags[SF_READABLE] || io->receiving || io->HasInput())
+		return;
+
+	io_uring_sqe *sqe = GetSQE();
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = io->fd;
+	sqe->addr = reinterpret_cast<uintptr_t>(io->recv_buf);
+	sqe->len = sizeof(io->recv_buf);
+	sqe->user_data = UserData(io, RT_RECV);
+
+	io->recv_pos = io->recv_end = 0;
+	io->receiving = true;
+}
+
+/* Send what has been queued, if nothing is being sent already */
+static void SubmitSend(RingSocketIO *io)
+{
+	if (io->sending || io->send_pos == io->send_end)
+		return;
+
+	io_uring_sqe *sqe = GetSQE();
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = io->fd;
+	sqe->addr = reinterpret_cast<uintptr_t>(io->send_buf + io->send_pos);
+	sqe->len = io->send_end - io->send_pos;
+	sqe->user_data = UserData(io, RT_SEND);
+
+	io->sending = true;
+}
+
+/* Take the results of finished requests off the completion ring. Receives and
+ * sends are applied to their sockets' buffers straight away, so this can be
+ * done while waiting for a blocking socket, and poll completions are kept for
+ * Process() to dispatch.
+ */
+static void Reap()
+{
+	unsigned head = *cq.head, tail = __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; ++head)
+	{
+		const io_uring_cqe &cqe = cq.cqes[head & *cq.mask];
+		if (cqe.user_data == RemoveTag)
+			continue;
+
+		RingSocketIO *io = reinterpret_cast<RingSocketIO *>(static_cast<uintptr_t>(cqe.user_data & ~static_cast<uint64_t>(RT_MASK)));
+		switch (cqe.user_data & RT_MASK)
+		{
+			case RT_POLL:
+				completions.push_back(cqe);
+				continue;
+			case RT_RECV:
+				io->receiving = false;
+				if (cqe.res > 0)
+					io->recv_end = cqe.res;
+				else if (cqe.res == 0)
+					io->recv_eof = true;
+				else if (cqe.res != -EAGAIN && cqe.res != -EINTR && cqe.res != -ECANCELED)
+					io->recv_error = -cqe.res;
+				break;
+			case RT_SEND:
+				io->sending = false;
+				if (cqe.res < 0)
+				{
+					io->send_error = -cqe.res;
+					break;
+				}
+
+				io->send_pos += cqe.res;
+				if (io->send_pos == io->send_end)
+					io->send_pos = io->send_end = 0;
+				else
+				{
+					/* Move what is left to the front, as nothing is being sent from the buffer now */
+					memmove(io->send_buf, io->send_buf + io->send_pos, io->send_end - io->send_pos);
+					io->send_end -= io->send_pos;
+					io->send_pos = 0;
+					SubmitSend(io);
+				}
+				break;
+		}
+
+		if (io->sock)
+			Queue(io);
+		else
+			Release(io);
+	}
+	__atomic_store_n(cq.head, head, __ATOMIC_RELEASE);
+}
+
+int RingSocketIO::Recv(Socket *s, char *buf, size_t sz)
+{
+	/* Blocking sockets (m_redis) expect to wait for data here */
+	if (!this->HasInput() && !(fcntl(this->fd, F_GETFL, 0) & O_NONBLOCK))
+	{
+		SubmitSend(this);
+		Receive(this);
+		while (this->receiving)
+		{
+			int submitted = Enter(sq.pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+			if (submitted >= 0)
+				sq.pending -= std::min(sq.pending, static_cast<unsigned>(submitted));
+			else if (errno != EINTR)
+				break;
+			Reap();
+		}
+	}
+
+	if (this->recv_pos < this->recv_end)
+	{
+		size_t len = std::min(sz, this->recv_end - this->recv_pos);
+		memcpy(buf, this->recv_buf + this->recv_pos, len);
+		this->recv_pos += len;
+		TotalRead += len;
+		return len;
+	}
+
+	if (this->recv_eof)
+		return 0;
+
+	SocketEngine::SetLastError(this->recv_error ? this->recv_error : EAGAIN);
+	return -1;
+}
+
+int RingSocketIO::Send(Socket *s, const char *buf, size_t sz)
+{
+	if (this->send_error || this->send_end == SendSize)
+	{
+		SocketEngine::SetLastError(this->send_error ? this->send_error : EAGAIN);
+		return -1;
+	}
+
+	size_t len = std::min(sz, SendSize - this->send_end);
+	memcpy(this->send_buf + this->send_end, buf, len);
+	this->send_end += len;
+	TotalWritten += len;
+	return len;
+}
+
+void RingSocketIO::Destroy()
+{
+	Slot(this->fd).ring = NULL;
+	this->sock = NULL;
+
+	/* What is left to send still goes out, but nothing more will be read */
+	if (this->receiving)
+	{
+		io_uring_sqe *sqe = GetSQE();
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = UserData(this, RT_RECV);
+		sqe->user_data = RemoveTag;
+	}
+
+	Release(this);
+}
+
+void SocketEngine::Init()
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	EngineHandle = syscall(__NR_io_uring_setup, RingSize, &params);
+	if (EngineHandle == -1)
+		throw SocketException("Could not initialize io_uring socket engine: " + Anope::LastError());
+
+	if (!(params.features & IORING_FEAT_EXT_ARG))
+		throw SocketException("Could not initialize io_uring socket engine: kernel does not support IORING_FEAT_EXT_ARG");
+
+	sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		sq_len = cq_len = std::max(sq_len, cq_len);
+
+	sq_ptr = mmap(NULL, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, EngineHandle, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED)
+		throw SocketException("Could not map io_uring submission ring: " + Anope::LastError());
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		cq_ptr = sq_ptr;
+	else
+	{
+		cq_ptr = mmap(NULL, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, EngineHandle, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED)
+			throw SocketException("Could not map io_uring completion ring: " + Anope::LastError());
+	}
+
+	sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+	void *sqes = mmap(NULL, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, EngineHandle, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		throw SocketException("Could not map io_uring submission entries: " + Anope::LastError());
+
+	char *sqb = static_cast<char *>(sq_ptr), *cqb = static_cast<char *>(cq_ptr);
+	sq.head = reinterpret_cast<unsigned *>(sqb + params.sq_off.head);
+	sq.tail = reinterpret_cast<unsigned *>(sqb + params.sq_off.tail);
+	sq.mask = reinterpret_cast<unsigned *>(sqb + params.sq_off.ring_mask);
+	sq.array = reinterpret_cast<unsigned *>(sqb + params.sq_off.array);
+	sq.sqes = static_cast<io_uring_sqe *>(sqes);
+	sq.pending = 0;
+
+	cq.head = reinterpret_cast<unsigned *>(cqb + params.cq_off.head);
+	cq.tail = reinterpret_cast<unsigned *>(cqb + params.cq_off.tail);
+	cq.mask = reinterpret_cast<unsigned *>(cqb + params.cq_off.ring_mask);
+	cq.cqes = reinterpret_cast<io_uring_cqe *>(cqb + params.cq_off.cqes);
+
+	slots.resize(DefaultSize);
+}
+
+void SocketEngine::Shutdown()
+{
+	while (!Sockets.empty())
+		delete Sockets.begin()->second;
+
+	if (EngineHandle != -1)
+	{
+		munmap(sq.sqes, sqes_len);
+		if (cq_ptr != sq_ptr)
+			munmap(cq_ptr, cq_len);
+		munmap(sq_ptr, sq_len);
+		close(EngineHandle);
+		EngineHandle = -1;
+	}
+}
+
+void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
+{
+	if (set == s->flags[flag])
+		return;
+
+	s->flags[flag] = set;
+
+	PollSlot &slot = Slot(s->GetFD());
+	if (slot.ring)
+	{
+		if (set)
+			Queue(slot.ring);
+		/* The socket is about to be closed, so requests for its fd have to reach the kernel first */
+		else if (!s->flags[SF_READABLE] && !s->flags[SF_WRITABLE])
+		{
+			SubmitSend(slot.ring);
+			Flush();
+		}
+		return;
+	}
+
+	if (slot.user_data != RemoveTag && slot.mask == WantedEvents(s))
+		return;
+
+	/* The poll is one shot, so instead of updating it in place it is replaced.
+	 * Nothing is submitted here, the requests go out with the next Process().
+	 */
+	Disarm(slot);
+	Arm(s);
+}
+
+/* Dispatch a poll completion for a socket */
+static void Dispatch(Socket *s, int fd, int res)
+{
+	if (res < 0 || (res & (POLLHUP | POLLERR)))
+	{
+		s->ProcessError();
+		delete s;
+		return;
+	}
+
+	if (!s->Process())
+	{
+		if (s->flags[SF_DEAD])
+		{
+			delete s;
+			return;
+		}
+		if (Slot(fd).user_data == RemoveTag)
+			Arm(s);
+		return;
+	}
+
+	if ((res & POLLIN) && !s->ProcessRead())
+		s->flags[SF_DEAD] = true;
+
+	if ((res & POLLOUT) && !s->ProcessWrite())
+		s->flags[SF_DEAD] = true;
+
+	if (s->flags[SF_DEAD])
+	{
+		delete s;
+		return;
+	}
+
+	/* Connected buffered and binary sockets using plain sockets do their I/O through the ring from now on */
+	if (s->io == &NormalSocketIO && (dynamic_cast<BufferedSocket *>(s) || dynamic_cast<BinarySocket *>(s)))
+	{
+		PollSlot &slot = Slot(fd);
+		Disarm(slot);
+		slot.ring = new RingSocketIO(s);
+		s->io = slot.ring;
+		Queue(slot.ring);
+	}
+	else if (Slot(fd).user_data == RemoveTag)
+		Arm(s);
+}
+
+/* Dispatch a socket doing its I/O through the ring */
+static void Dispatch(RingSocketIO *io)
+{
+	Socket *s = io->sock;
+
+	if (io->send_error)
+	{
+		SocketEngine::SetLastError(io->send_error);
+		s->ProcessError();
+		delete s;
+		return;
+	}
+
+	if (s->flags[SF_READABLE] && io->HasInput() && !s->ProcessRead())
+		s->flags[SF_DEAD] = true;
+
+	if (!s->flags[SF_DEAD] && s->flags[SF_WRITABLE] && io->send_end < RingSocketIO::SendSize && !s->ProcessWrite())
+		s->flags[SF_DEAD] = true;
+
+	if (s->flags[SF_DEAD])
+	{
+		delete s;
+		return;
+	}
+
+	/* Everything written while dispatching goes out in one request */
+	SubmitSend(io);
+
+	/* Whatever was not read is handed out next time */
+	if (s->flags[SF_READABLE] && io->recv_pos < io->recv_end)
+		Queue(io);
+	else
+		Receive(io);
+}
+
+void SocketEngine::Process()
+{
+	unsigned head = *cq.head, tail = __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE);
+
+	if (head == tail && ready.empty())
+	{
+		long timeout = TimerManager::GetTimeout(Config->ReadTimeout * 1000);
+		__kernel_timespec ts;
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+
+		io_uring_getevents_arg arg;
+		memset(&arg, 0, sizeof(arg));
+		arg.ts = reinterpret_cast<uintptr_t>(&ts);
+
+		int submitted = Enter(sq.pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+		Anope::CurTime = time(NULL);
+
+		/* ETIME is given if the read timeout expires, EINTR on signals */
+		if (submitted < 0)
+		{
+			if (errno != ETIME && errno != EINTR)
+				Log() << "SockEngine::Process(): error: " << Anope::LastError();
+		}
+		else
+			sq.pending -= std::min(sq.pending, static_cast<unsigned>(submitted));
+	}
+	else
+	{
+		Flush();
+		Anope::CurTime = time(NULL);
+	}
+
+	/* Copy the whole batch out so the kernel can reuse the ring while we dispatch */
+	Reap();
+
+	for (unsigned i = 0; i < completions.size(); ++i)
+	{
+		/* Dispatching may wait on a blocking socket, which adds to the list */
+		io_uring_cqe cqe = completions[i];
+
+		int fd = static_cast<int>((cqe.user_data >> 2) & 0xFFFFFFFF);
+		PollSlot &slot = Slot(fd);
+		/* Stale completion of a poll that was replaced or whose socket is gone */
+		if (slot.user_data != cqe.user_data)
+			continue;
+
+		slot.user_data = RemoveTag;
+		slot.mask = 0;
+
+		std::map<int, Socket *>::iterator it = Sockets.find(fd);
+		if (it == Sockets.end())
+			continue;
+
+		++dispatched;
+		Dispatch(it->second, fd, cqe.res);
+	}
+	completions.clear();
+
+	dispatching.swap(ready);
+	for (unsigned i = 0; i < dispatching.size(); ++i)
+	{
+		RingSocketIO *io = dispatching[i];
+		io->queued = false;
+
+		if (!io->sock)
+		{
+			Release(io);
+			continue;
+		}
+
+		++dispatched;
+		Dispatch(io);
+	}
+	dispatching.clear();
+
+	LastEvents = dispatched;
+	LastChanges = changes;
+	TotalEvents += dispatched;
+	TotalChanges += changes;
+	++TotalLoops;
+	dispatched = changes = 0;
+}
@@ -21,6 +21,8 @@
 #endif
 
 std::map<int, Socket *> SocketEngine::Sockets;
+unsigned SocketEngine::LastEvents = 0, SocketEngine::LastChanges = 0;
+unsigned long SocketEngine::TotalEvents = 0, SocketEngine::TotalChanges = 0, SocketEngine::TotalLoops = 0;
 
 uint32_t TotalRead = 0;
 uint32_t TotalWritten = 0;
@@ -9,26 +9,224 @@
 #include "services.h"
 #include "timers.h"
 
-std::multimap<time_t, Timer *> TimerManager::Timers;
+#ifndef _WIN32
+#include <time.h>
+#endif
 
-Timer::Timer(long time_from_now, time_t now, bool repeating)
+/* The wheel has a root level of 256 one millisecond slots, and four more
+ * levels of 64 slots each spanning a whole revolution of the level below.
+ * Timers go in the lowest level that reaches their deadline, and are moved
+ * down ("cascaded") when the wheel gets to their slot, so a timer is only
+ * touched a handful of times however far away it is. Timers further away
+ * than the wheel reaches (about 49 days) are kept in its last slot and
+ * placed again every time they are cascaded. Which slots have timers in
+ * them is kept in bitmaps, so the wheel can skip straight to the next slot
+ * which is due or has to be cascaded.
+ */
+static const unsigned RootBits = 8, LevelBits = 6, Levels = 4;
+static const unsigned RootSize = 1 << RootBits, LevelSize = 1 << LevelBits;
+static const uint64_t MaxDelta = (static_cast<uint64_t>(1) << (RootBits + LevelBits * Levels)) - 1;
+
+static TimerLink root[RootSize];
+static TimerLink levels[Levels][LevelSize];
+/* Slots which may have timers in them. Bits are set when a timer is put in
+ * a slot, and cleared when the slot is emptied or found to be empty.
+ */
+static uint64_t root_used[RootSize / 64];
+static uint64_t levels_used[Levels];
+/* The next millisecond of the wheel to be processed */
+static uint64_t current;
+/* Number of timers in the wheel */
+static size_t count;
+
+static unsigned Shift(unsigned level)
+{
+	return RootBits + LevelBits * level;
+}
+
+static bool Empty(const TimerLink &head)
+{
+	return head.next == &head;
+}
+
+static unsigned LowestBit(uint64_t bits)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(bits);
+#else
+	unsigned bit = 0;
+	for (; !(bits & 1); bits >>= 1)
+		++bit;
+	return bit;
+#endif
+}
+
+/* Find how many slots after the given one the first slot with timers in it is,
+ * going around the end of the slots, or -1 if there are none
+ */
+static long NextSlot(TimerLink *slots, uint64_t *used, unsigned words, unsigned from)
+{
+	unsigned size = words * 64;
+	for (unsigned i = 0; i <= words; ++i)
+	{
+		unsigned word = (from / 64 + i) % words;
+		uint64_t bits = used[word];
+		/* The first word is looked at again at the end for the slots before from */
+		if (i == 0)
+			bits &= ~static_cast<uint64_t>(0) << (from % 64);
+		else if (i == words)
+			bits &= ~(~static_cast<uint64_t>(0) << (from % 64));
+
+		for (; bits; bits &= bits - 1)
+		{
+			unsigned slot = word * 64 + LowestBit(bits);
+			if (!Empty(slots[slot]))
+				return (slot + size - from) % size;
+			/* All of its timers were deleted */
+			used[word] &= ~(static_cast<uint64_t>(1) << (slot % 64));
+		}
+	}
+
+	return -1;
+}
+
+static void Link(TimerLink &head, TimerLink &link)
+{
+	link.prev = head.prev;
+	link.next = &head;
+	head.prev->next = &link;
+	head.prev = &link;
+}
+
+static void Unlink(TimerLink &link)
+{
+	link.prev->next = link.next;
+	link.next->prev = link.prev;
+	link.prev = link.next = &link;
+}
+
+/* Move all of the timers in one list to the end of another */
+static void Splice(TimerLink &from, TimerLink &to)
+{
+	if (Empty(from))
+		return;
+
+	from.next->prev = to.prev;
+	from.prev->next = &to;
+	to.prev->next = from.next;
+	to.prev = from.prev;
+	from.prev = from.next = &from;
+}
+
+static void Insert(TimerLink &link, uint64_t deadline)
+{
+	uint64_t expires = std::max(deadline, current), delta = expires - current;
+	if (delta > MaxDelta)
+	{
+		expires = current + MaxDelta;
+		delta = MaxDelta;
+	}
+
+	if (delta < RootSize)
+	{
+		unsigned slot = expires & (RootSize - 1);
+		Link(root[slot], link);
+		root_used[slot / 64] |= static_cast<uint64_t>(1) << (slot % 64);
+		return;
+	}
+
+	unsigned level = 0;
+	while (delta >> Shift(level + 1))
+		++level;
+	unsigned slot = (expires >> Shift(level)) & (LevelSize - 1);
+	Link(levels[level][slot], link);
+	levels_used[level] |= static_cast<uint64_t>(1) << slot;
+}
+
+/* Called when the root level wraps, moves the timers in the slots of the
+ * upper levels that are now due down the wheel.
+ */
+static void Cascade()
+{
+	for (unsigned level = 0; level < Levels; ++level)
+	{
+		unsigned index = (current >> Shift(level)) & (LevelSize - 1);
+
+		TimerLink pending;
+		Splice(levels[level][index], pending);
+		levels_used[level] &= ~(static_cast<uint64_t>(1) << index);
+		while (!Empty(pending))
+		{
+			TimerLink &link = *pending.next;
+			Unlink(link);
+			Insert(link, link.timer->GetDeadline());
+		}
+
+		if (index)
+			break;
+	}
+}
+
+/* Find the first millisecond from current on when a root slot is due or an
+ * upper slot has to be cascaded, or 0 if there are no timers
+ */
+static uint64_t NextEvent()
+{
+	uint64_t next = 0;
+
+	/* Root slots hold exactly the timers due that millisecond */
+	long slot = NextSlot(root, root_used, RootSize / 64, current & (RootSize - 1));
+	if (slot >= 0)
+		next = current + slot;
+
+	/* Upper slots only need to be woken for when they are cascaded. A slot
+	 * which has been cascaded already is a whole revolution away.
+	 */
+	for (unsigned level = 0; level < Levels; ++level)
+	{
+		uint64_t base = (current + (static_cast<uint64_t>(1) << Shift(level)) - 1) >> Shift(level);
+		slot = NextSlot(levels[level], &levels_used[level], 1, base & (LevelSize - 1));
+		if (slot >= 0)
+		{
+			uint64_t when = (base + slot) << Shift(level);
+			if (!next || when < next)
+				next = when;
+		}
+	}
+
+	return next;
+}
+
+/* Convert a trigger time from the wall clock to a deadline on ours */
+static uint64_t DeadlineFor(time_t trigger)
+{
+	uint64_t now = TimerManager::Now();
+	if (trigger <= Anope::CurTime)
+		return now;
+	return now + static_cast<uint64_t>(trigger - Anope::CurTime) * 1000;
+}
+
+
+Timer::Timer(long time_from_now, time_t now, bool repeating) : link(this)
 {
 	owner = NULL;
 	trigger = now + time_from_now;
 	secs = time_from_now;
 	repeat = repeating;
 	settime = now;
+	deadline = DeadlineFor(trigger);
 
 	TimerManager::AddTimer(this);
 }
 
-Timer::Timer(Module *creator, long time_from_now, time_t now, bool repeating)
+Timer::Timer(Module *creator, long time_from_now, time_t now, bool repeating) : link(this)
 {
 	owner = creator;
 	trigger = now + time_from_now;
 	secs = time_from_now;
 	repeat = repeating;
 	settime = now;
+	deadline = DeadlineFor(trigger);
 
 	TimerManager::AddTimer(this);
 }
@@ -42,6 +240,7 @@ void Timer::SetTimer(time_t t)
 {
 	TimerManager::DelTimer(this);
 	trigger = t;
+	deadline = DeadlineFor(t);
 	TimerManager::AddTimer(this);
 }
 
@@ -60,14 +259,28 @@ time_t Timer::GetSetTime() const
 	return settime;
 }
 
+void Timer::SetDelay(uint64_t ms)
+{
+	TimerManager::DelTimer(this);
+	trigger = Anope::CurTime + static_cast<time_t>((ms + 999) / 1000);
+	deadline = TimerManager::Now() + ms;
+	TimerManager::AddTimer(this);
+}
+
 void Timer::SetSecs(time_t t)
 {
 	TimerManager::DelTimer(this);
 	secs = t;
 	trigger = Anope::CurTime + t;
+	deadline = TimerManager::Now() + static_cast<uint64_t>(std::max<time_t>(t, 0)) * 1000;
 	TimerManager::AddTimer(this);
 }
 
+uint64_t Timer::GetDeadline() const
+{
+	return deadline;
+}
+
 long Timer::GetSecs() const
 {
 	return secs;
@@ -78,49 +291,99 @@ Module *Timer::GetOwner() const
 	return owner;
 }
 
+uint64_t TimerManager::Now()
+{
+#ifdef _WIN32
+	return GetTickCount64();
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+long TimerManager::GetTimeout(long max)
+{
+	if (!count)
+		return max;
+
+	uint64_t next = NextEvent(), now = Now();
+	if (next <= now)
+		return 0;
+	return static_cast<long>(std::min<uint64_t>(next - now, max));
+}
+
 void TimerManager::AddTimer(Timer *t)
 {
-	Timers.insert(std::make_pair(t->GetTimer(), t));
+	if (!count)
+		current = Now();
+
+	Insert(t->link, t->deadline);
+	++count;
 }
 
 void TimerManager::DelTimer(Timer *t)
 {
-	std::pair<std::multimap<time_t, Timer *>::iterator, std::multimap<time_t, Timer *>::iterator> itpair = Timers.equal_range(t->GetTimer());
-	for (std::multimap<time_t, Timer *>::iterator i = itpair.first; i != itpair.second; ++i)
-	{
-		if (i->second == t)
-		{
-			Timers.erase(i);
-			break;
-		}
-	}
+	if (Empty(t->link))
+		return;
+
+	Unlink(t->link);
+	--count;
 }
 
 void TimerManager::TickTimers(time_t ctime)
 {
-	while (!Timers.empty())
-	{
-		std::multimap<time_t, Timer *>::iterator it = Timers.begin();
-		Timer *t = it->second;
+	uint64_t now = Now();
 
-		if (t->GetTimer() > ctime)
+	while (count)
+	{
+		/* Nothing happens in the milliseconds before this, so they are skipped */
+		uint64_t next = NextEvent();
+		if (next > now)
 			break;
+		current = next;
+
+		if (!(current & (RootSize - 1)))
+			Cascade();
+
+		unsigned slot = current & (RootSize - 1);
+		TimerLink expired;
+		Splice(root[slot], expired);
+		root_used[slot / 64] &= ~(static_cast<uint64_t>(1) << (slot % 64));
+		/* Timers added while ticking go in the next slot at the earliest */
+		++current;
+
+		while (!Empty(expired))
+		{
+			Timer *t = expired.next->timer;
+			DelTimer(t);
 
-		t->Tick(ctime);
+			t->Tick(ctime);
 
-		if (t->GetRepeat())
-			t->SetTimer(ctime + t->GetSecs());
-		else
-			delete t;
+			if (t->GetRepeat())
+				t->SetTimer(ctime + t->GetSecs());
+			else
+				delete t;
+		}
 	}
+
+	if (current <= now)
+		current = now + 1;
 }
 
 void TimerManager::DeleteTimersFor(Module *m)
 {
-	for (std::multimap<time_t, Timer *>::iterator it = Timers.begin(), it_next = it; it != Timers.end(); it = it_next)
-	{
-		++it_next;
-		if (it->second->GetOwner() == m)
-			delete it->second;
-	}
+	std::vector<Timer *> timers;
+	for (unsigned i = 0; i < RootSize; ++i)
+		for (TimerLink *link = root[i].next; link != &root[i]; link = link->next)
+			if (link->timer->GetOwner() == m)
+				timers.push_back(link->timer);
+	for (unsigned level = 0; level < Levels; ++level)
+		for (unsigned i = 0; i < LevelSize; ++i)
+			for (TimerLink *link = levels[level][i].next; link != &levels[level][i]; link = link->next)
+				if (link->timer->GetOwner() == m)
+					timers.push_back(link->timer);
+
+	for (unsigned i = 0; i < timers.size(); ++i)
+		delete timers[i];
 }
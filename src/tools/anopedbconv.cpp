@@ -0,0 +1,175 @@
+/* Converts db_flatfile databases between the text and binary formats.
+ *
+ * (C) 2003-2024 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ */
+
+#include "sysconf.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "modules/db_flatfile.h"
+
+static bool ReadFile(const char *path, std::string &out)
+{
+	std::ifstream f(path, std::ios_base::in | std::ios_base::binary);
+	if (!f.is_open())
+		return false;
+	out.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	return !f.bad();
+}
+
+static bool WriteFile(const char *path, const std::string &data)
+{
+	std::ofstream f(path, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+	if (!f.is_open())
+		return false;
+	f.write(data.data(), data.size());
+	f.close();
+	return f.good();
+}
+
+/* The same rules as db_flatfile's text loader: anything other than ID and DATA ends an object */
+static void TextToBinary(const std::string &in, std::string &out)
+{
+	FlatFile::Writer writer;
+	std::istringstream is(in);
+	std::string line;
+
+	bool have_line = false;
+	while (have_line || std::getline(is, line))
+	{
+		have_line = false;
+		if (line.compare(0, 7, "OBJECT ") != 0)
+			continue;
+
+		std::string type = line.substr(7);
+		uint64_t id = 0;
+		std::vector<std::pair<std::string, std::string> > fields;
+
+		while (std::getline(is, line))
+		{
+			if (line.compare(0, 3, "ID ") == 0)
+			{
+				FlatFile::ParseId(line.data() + 3, line.data() + line.length(), id);
+				continue;
+			}
+			else if (line.compare(0, 5, "DATA ") != 0)
+			{
+				/* Let the outer loop see a following OBJECT */
+				have_line = line != "END";
+				break;
+			}
+
+			size_t sp = line.find(' ', 5);
+			if (sp != std::string::npos)
+				fields.push_back(std::make_pair(line.substr(5, sp - 5), line.substr(sp + 1)));
+		}
+
+		writer.BeginObject(type, id);
+		for (unsigned i = 0; i < fields.size(); ++i)
+			writer.AddField(fields[i].first, fields[i].second.data(), fields[i].second.length());
+		writer.EndObject();
+	}
+
+	writer.Finish(out);
+}
+
+static bool BinaryToText(const std::string &in, std::string &out, std::string &error)
+{
+	FlatFile::Reader reader;
+	if (!reader.Open(in.data(), in.size(), error))
+		return false;
+
+	std::ostringstream os;
+	const std::vector<FlatFile::Reader::Section> &sections = reader.GetSections();
+	for (unsigned i = 0; i < sections.size(); ++i)
+	{
+		const FlatFile::Reader::String &type = reader.GetString(sections[i].type);
+
+		FlatFile::Reader::Object obj;
+		for (reader.Begin(sections[i], obj); reader.Next(obj, error);)
+		{
+			os << "OBJECT ";
+			os.write(type.data, type.length);
+			if (obj.id)
+				os << "\nID " << obj.id;
+			for (unsigned j = 0; j < obj.fields.size(); ++j)
+			{
+				const FlatFile::Reader::Field &f = obj.fields[j];
+				const FlatFile::Reader::String &key = reader.GetString(f.key);
+				os << "\nDATA ";
+				os.write(key.data, key.length);
+				os << " ";
+				os.write(f.value, f.length);
+			}
+			os << "\nEND\n";
+		}
+
+		if (!error.empty())
+			return false;
+	}
+
+	out = os.str();
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	int to_binary = -1, arg = 1;
+	if (arg < argc && !strcmp(argv[arg], "--binary"))
+		to_binary = 1, ++arg;
+	else if (arg < argc && !strcmp(argv[arg], "--text"))
+		to_binary = 0, ++arg;
+
+	if (argc - arg != 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " [--text|--binary] <input database> <output database>" << std::endl;
+		std::cerr << "Converts a db_flatfile database to the other format, or to the one given." << std::endl;
+		return 1;
+	}
+
+	const char *input = argv[arg], *output = argv[arg + 1];
+
+	std::string in, out;
+	if (!ReadFile(input, in))
+	{
+		std::cerr << "Unable to read " << input << std::endl;
+		return 1;
+	}
+
+	bool is_binary = FlatFile::IsBinary(in.data(), in.size());
+	if (to_binary == -1)
+		to_binary = !is_binary;
+
+	if (is_binary && !to_binary)
+	{
+		std::string error;
+		if (!BinaryToText(in, out, error))
+		{
+			std::cerr << "Unable to convert " << input << ": " << error << std::endl;
+			return 1;
+		}
+	}
+	else if (!is_binary && to_binary)
+		TextToBinary(in, out);
+	else
+		out.swap(in);
+
+	if (!WriteFile(output, out))
+	{
+		std::cerr << "Unable to write " << output << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -61,6 +61,8 @@ UplinkSocket::UplinkSocket() : Socket(-1, Config->Uplinks[Anope::CurrentUplink].
 {
 	error = false;
 	UplinkSock = this;
+	/* Start sending large bursts before they are fully queued */
+	this->SetWriteHighWater(NET_BUFSIZE);
 }
 
 UplinkSocket::~UplinkSocket()
@@ -130,9 +132,12 @@ UplinkSocket::~UplinkSocket()
 bool UplinkSocket::ProcessRead()
 {
 	bool b = BufferedSocket::ProcessRead();
-	for (Anope::string buf; (buf = this->GetLine()).empty() == false;)
+
+	this->lines.clear();
+	this->ReadLines(this->lines);
+	for (unsigned i = 0; i < this->lines.size(); ++i)
 	{
-		Anope::Process(buf);
+		Anope::Process(this->lines[i]);
 		User::QuitUsers();
 		Channel::DeleteChannels();
 	}
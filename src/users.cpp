@@ -22,8 +22,10 @@
 #include "language.h"
 #include "sockets.h"
 #include "uplink.h"
+#include "access.h"
 
-user_map UserListByNick, UserListByUID;
+user_map UserListByNick;
+Anope::id_map<User *> UserListByUID;
 
 int OperCount = 0;
 unsigned MaxUserCount = 0;
@@ -41,6 +43,7 @@ User::User(const Anope::string &snick, const Anope::string &sident, const Anope:
 	server = NULL;
 	invalid_pw_count = invalid_pw_time = lastmemosend = lastnickreg = lastmail = 0;
 	on_access = false;
+	access_generation = AccessCache::NewGeneration();
 
 	this->nick = snick;
 	this->ident = sident;
@@ -143,6 +146,7 @@ void User::ChangeNick(const Anope::string &newnick, time_t ts)
 		throw CoreException("User::ChangeNick() got a bad argument");
 
 	this->super_admin = false;
+	this->access_generation = AccessCache::NewGeneration();
 	Log(this, "nick") << "(" << this->realname << ") changed nick to " << newnick;
 
 	Anope::string old = this->nick;
@@ -154,7 +158,10 @@ void User::ChangeNick(const Anope::string &newnick, time_t ts)
 	{
 		NickAlias *old_na = NickAlias::Find(this->nick);
 		if (old_na && (this->IsIdentified(true) || this->IsRecognized()))
+		{
 			old_na->last_seen = Anope::CurTime;
+			old_na->QueueUpdate();
+		}
 
 		UserListByNick.erase(this->nick);
 
@@ -177,6 +184,7 @@ void User::ChangeNick(const Anope::string &newnick, time_t ts)
 		if (na && na->nc == this->Account())
 		{
 			na->last_seen = Anope::CurTime;
+			na->QueueUpdate();
 			this->UpdateHost();
 		}
 	}
@@ -283,7 +291,10 @@ void User::SetRealname(const Anope::string &srealname)
 	NickAlias *na = NickAlias::Find(this->nick);
 
 	if (na && (this->IsIdentified(true) || this->IsRecognized()))
+	{
 		na->last_realname = srealname;
+		na->QueueUpdate();
+	}
 
 	Log(this, "realname") << "changed realname to " << srealname;
 }
@@ -360,6 +371,7 @@ void User::Identify(NickAlias *na)
 		na->last_realhost = this->GetIdent() + "@" + this->host;
 		na->last_realname = this->realname;
 		na->last_seen = Anope::CurTime;
+		na->QueueUpdate();
 	}
 
 	IRCD->SendLogin(this, na);
@@ -411,6 +423,7 @@ void User::Logout()
 		return;
 
 	Log(this, "account") << "is no longer identified as " << this->nc->display;
+	this->access_generation = AccessCache::NewGeneration();
 
 	std::list<User *>::iterator it = std::find(this->nc->users.begin(), this->nc->users.end(), this);
 	if (it != this->nc->users.end())
@@ -500,6 +513,8 @@ bool User::HasPriv(const Anope::string &priv)
 
 void User::UpdateHost()
 {
+	this->access_generation = AccessCache::NewGeneration();
+
 	if (this->host.empty())
 		return;
 
@@ -512,10 +527,14 @@ void User::UpdateHost()
 	{
 		Anope::string last_usermask = this->GetIdent() + "@" + this->GetDisplayedHost();
 		Anope::string last_realhost = this->GetIdent() + "@" + this->host;
-		na->last_usermask = last_usermask;
-		na->last_realhost = last_realhost;
 		// This is called on signon, and if users are introduced with an account it won't update
-		na->last_realname = this->realname;
+		if (na->last_usermask != last_usermask || na->last_realhost != last_realhost || na->last_realname != this->realname)
+		{
+			na->last_usermask = last_usermask;
+			na->last_realhost = last_realhost;
+			na->last_realname = this->realname;
+			na->QueueUpdate();
+		}
 	}
 }
 
@@ -830,9 +849,9 @@ User* User::Find(const Anope::string &name, bool nick_only)
 {
 	if (!nick_only && IRCD && IRCD->RequiresID)
 	{
-		user_map::iterator it = UserListByUID.find(name);
-		if (it != UserListByUID.end())
-			return it->second;
+		User *u = UserListByUID.Find(name);
+		if (u)
+			return u;
 
 		if (IRCD->AmbiguousID)
 			return NULL;
@@ -19,10 +19,514 @@
 #include "commands.h"
 #include "servers.h"
 
+#include <queue>
+
 /* List of XLine managers we check users against in XLineManager::CheckAll */
 std::list<XLineManager *> XLineManager::XLineManagers;
 Serialize::Checker<std::multimap<Anope::string, XLine *, ci::less> > XLineManager::XLinesByUID("XLine");
 
+/* Files each XLine of a manager by the mask given by XLineManager::GetIndexMask:
+ * - literal masks in a hash map,
+ * - *.suffix and prefix.* masks in hash maps keyed by the literal part, which
+ *   are looked up at every label boundary of the user's strings,
+ * - CIDR ranges in a hash map per address family and prefix length, so
+ *   looking up an IP takes one lookup per prefix length in use,
+ * - regex XLines in chunks which are joined into a single alternation, so
+ *   a user only needs to be matched against each chunk once,
+ * - and anything else in a list checked against every user.
+ * XLines which expire are also kept in a min-heap ordered by expiry.
+ */
+class XLineIndex
+{
+	/* An XLine and the order it was added in */
+	struct Line
+	{
+		uint64_t seq;
+		XLine *x;
+
+		bool operator<(const Line &other) const { return seq < other.seq; }
+		bool operator==(const Line &other) const { return seq == other.seq; }
+	};
+
+	/* XLines in the order they were added in */
+	typedef std::vector<Line> Bucket;
+
+	/* Number of regex XLines joined into one expression. If a chunk matches its
+	 * XLines are matched one by one to find which did, so this is kept small.
+	 */
+	static const unsigned RegexChunkSize = 32;
+
+	struct RegexChunk
+	{
+		Bucket lines;
+		/* All of the expressions of lines joined together, or NULL if they
+		 * could not be compiled together and must be matched one by one
+		 */
+		Regex *combined;
+		/* Regex engine combined was compiled with */
+		Anope::string engine;
+		bool dirty;
+
+		RegexChunk() : combined(NULL), dirty(true) { }
+		~RegexChunk() { delete combined; }
+
+		void Build(const Anope::string &regexengine)
+		{
+			delete combined;
+			combined = NULL;
+			engine = regexengine;
+			dirty = false;
+
+			if (lines.size() < 2)
+				return;
+
+			ServiceReference<RegexProvider> provider("Regex", regexengine);
+			if (!provider)
+				return;
+
+			/* Regex modules drop the regexes of XLines when they are unloaded,
+			 * leave those to be checked one by one
+			 */
+			for (unsigned i = 0; i < lines.size(); ++i)
+				if (!lines[i].x->regex)
+					return;
+
+			Anope::string expression;
+			for (unsigned i = 0; i < lines.size(); ++i)
+				expression += (i ? "|(" : "(") + lines[i].x->regex->GetExpression() + ")";
+
+			try
+			{
+				combined = provider->Compile(expression);
+			}
+			catch (const RegexException &ex)
+			{
+				Log(LOG_DEBUG) << "Unable to combine " << lines.size() << " regex XLines: " << ex.GetReason();
+			}
+		}
+	};
+
+	enum Kind
+	{
+		RESIDUAL,
+		EXACT,
+		SUFFIX,
+		PREFIX,
+		REGEX
+	};
+
+	struct Entry
+	{
+		/* Order the XLine was added in, newer XLines are checked first */
+		uint64_t seq;
+		Kind kind;
+		Anope::string key;
+		/* Address family, prefix length and masked address if this is a CIDR range */
+		int family;
+		unsigned len;
+		std::string network;
+		/* Chunk this is in if this is a regex XLine */
+		RegexChunk *chunk;
+	};
+
+	struct Expiry
+	{
+		time_t expires;
+		uint64_t seq;
+		XLine *x;
+
+		bool operator>(const Expiry &other) const { return expires > other.expires; }
+	};
+
+	typedef std::map<std::pair<int, unsigned>, TR1NS::unordered_map<std::string, Bucket> > cidr_map;
+
+	TR1NS::unordered_map<XLine *, Entry> entries;
+	Anope::hash_map<Bucket> exact, suffix, prefix;
+	cidr_map cidrs;
+	Bucket residual;
+	std::vector<RegexChunk *> regexes;
+	std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry> > expiry;
+	uint64_t seq;
+
+	static bool HasWildcards(const Anope::string &mask, size_t pos = 0, size_t n = Anope::string::npos)
+	{
+		for (size_t i = pos; i < mask.length() && i - pos < n; ++i)
+			if (mask[i] == '*' || mask[i] == '?')
+				return true;
+		return false;
+	}
+
+	/* The address in sa masked to len bits */
+	static std::string Network(const sockaddrs &sa, unsigned len)
+	{
+		const unsigned char *bytes;
+		size_t size;
+		if (sa.family() == AF_INET6)
+		{
+			bytes = reinterpret_cast<const unsigned char *>(&sa.sa6.sin6_addr);
+			size = 16;
+		}
+		else
+		{
+			bytes = reinterpret_cast<const unsigned char *>(&sa.sa4.sin_addr);
+			size = 4;
+		}
+
+		std::string network(reinterpret_cast<const char *>(bytes), std::min<size_t>(size, (len + 7) / 8));
+		if (len % 8 && network.length() == (len + 7) / 8)
+			network[network.length() - 1] &= static_cast<char>(0xFF << (8 - len % 8));
+		return network;
+	}
+
+	/* Parses a CIDR range the same way as cidr::cidr does */
+	static bool ParseCIDR(const Anope::string &mask, Entry &e)
+	{
+		size_t sl = mask.find_last_of('/');
+		if (sl == Anope::string::npos)
+			return false;
+
+		Anope::string ip = mask.substr(0, sl), range = mask.substr(sl + 1);
+		bool ipv6 = ip.find(':') != Anope::string::npos;
+
+		e.family = ipv6 ? AF_INET6 : AF_INET;
+		e.len = ipv6 ? 128 : 32;
+		try
+		{
+			if (range.is_pos_number_only())
+				e.len = std::min(convertTo<unsigned>(range), e.len);
+		}
+		catch (const ConvertException &) { }
+
+		sockaddrs sa;
+		sa.pton(e.family, ip);
+		if (!sa.valid())
+			return false;
+
+		e.network = Network(sa, e.len);
+		return true;
+	}
+
+	/* Whether an expression can be joined with others without changing its meaning */
+	static bool Combinable(const Anope::string &expression)
+	{
+		/* Back references would refer to the wrong group */
+		for (size_t i = expression.find('\\'); i != Anope::string::npos && i + 1 < expression.length(); i = expression.find('\\', i + 2))
+			if (isdigit(expression[i + 1]))
+				return false;
+		return !expression.empty();
+	}
+
+	static void Erase(Bucket &bucket, const Line &line)
+	{
+		Bucket::iterator it = std::lower_bound(bucket.begin(), bucket.end(), line);
+		if (it != bucket.end() && *it == line)
+			bucket.erase(it);
+	}
+
+	static void Erase(Anope::hash_map<Bucket> &map, const Anope::string &key, const Line &line)
+	{
+		Anope::hash_map<Bucket>::iterator it = map.find(key);
+		if (it == map.end())
+			return;
+		Erase(it->second, line);
+		if (it->second.empty())
+			map.erase(it);
+	}
+
+	static void Find(const Anope::hash_map<Bucket> &map, const Anope::string &key, Bucket &candidates)
+	{
+		Anope::hash_map<Bucket>::const_iterator it = map.find(key);
+		if (it != map.end())
+			candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+	}
+
+	/* Find the indexed XLines which may match a user, newest first */
+	void Find(XLineManager *xlm, User *u, Bucket &candidates)
+	{
+		std::vector<Anope::string> keys;
+		const sockaddrs *ip = xlm->GetIndexKeys(u, keys);
+
+		for (unsigned i = 0; i < keys.size(); ++i)
+		{
+			const Anope::string &key = keys[i];
+			if (key.empty())
+				continue;
+
+			Find(exact, key, candidates);
+
+			if (suffix.empty() && prefix.empty())
+				continue;
+
+			for (size_t dot = key.find('.'); dot != Anope::string::npos; dot = key.find('.', dot + 1))
+			{
+				if (!suffix.empty())
+					Find(suffix, key.substr(dot + 1), candidates);
+				if (!prefix.empty())
+					Find(prefix, key.substr(0, dot), candidates);
+			}
+		}
+
+		if (!regexes.empty())
+		{
+			std::vector<Anope::string> subjects;
+			xlm->GetRegexKeys(u, subjects);
+
+			const Anope::string &regexengine = Config->GetBlock("options")->Get<const Anope::string>("regexengine");
+			for (unsigned i = 0; i < regexes.size(); ++i)
+			{
+				RegexChunk *chunk = regexes[i];
+				if (chunk->dirty || chunk->engine != regexengine)
+					chunk->Build(regexengine);
+
+				bool matched = !chunk->combined || subjects.empty();
+				for (unsigned j = 0; !matched && j < subjects.size(); ++j)
+					matched = chunk->combined->Matches(subjects[j]);
+
+				if (matched)
+					candidates.insert(candidates.end(), chunk->lines.begin(), chunk->lines.end());
+			}
+		}
+
+		if (ip && ip->valid())
+			for (cidr_map::const_iterator it = cidrs.begin(); it != cidrs.end(); ++it)
+			{
+				if (it->first.first != ip->family())
+					continue;
+
+				TR1NS::unordered_map<std::string, Bucket>::const_iterator nit = it->second.find(Network(*ip, it->first.second));
+				if (nit != it->second.end())
+					candidates.insert(candidates.end(), nit->second.begin(), nit->second.end());
+			}
+
+		/* There are usually only a few of these, unlike the residual XLines */
+		std::sort(candidates.rbegin(), candidates.rend());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	}
+
+ public:
+	XLineIndex() : seq(0) { }
+
+	void Add(XLineManager *xlm, XLine *x)
+	{
+		if (entries.count(x))
+			return;
+
+		Entry &e = entries[x];
+		e.seq = ++seq;
+		e.kind = RESIDUAL;
+		e.family = AF_UNSPEC;
+		e.len = 0;
+		e.chunk = NULL;
+
+		Anope::string mask;
+		if (x->regex)
+		{
+			if (Combinable(x->regex->GetExpression()))
+				e.kind = REGEX;
+		}
+		else if (xlm->GetIndexMask(x, mask) && !mask.empty())
+		{
+			if (!HasWildcards(mask))
+			{
+				e.kind = EXACT;
+				e.key = mask;
+
+				if (ParseCIDR(mask, e))
+				{
+					Line line = { e.seq, x };
+					cidrs[std::make_pair(e.family, e.len)][e.network].push_back(line);
+				}
+				else
+					e.family = AF_UNSPEC;
+			}
+			else if (mask.length() > 2 && mask[0] == '*' && mask[1] == '.' && !HasWildcards(mask, 2))
+			{
+				e.kind = SUFFIX;
+				e.key = mask.substr(2);
+			}
+			else if (mask.length() > 2 && mask[mask.length() - 1] == '*' && mask[mask.length() - 2] == '.' && !HasWildcards(mask, 0, mask.length() - 2))
+			{
+				e.kind = PREFIX;
+				e.key = mask.substr(0, mask.length() - 2);
+			}
+		}
+
+		/* Sequence numbers only increase, so appending keeps buckets in order */
+		Line line = { e.seq, x };
+		switch (e.kind)
+		{
+			case EXACT:
+				exact[e.key].push_back(line);
+				break;
+			case SUFFIX:
+				suffix[e.key].push_back(line);
+				break;
+			case PREFIX:
+				prefix[e.key].push_back(line);
+				break;
+			case REGEX:
+				if (regexes.empty() || regexes.back()->lines.size() >= RegexChunkSize)
+					regexes.push_back(new RegexChunk());
+				e.chunk = regexes.back();
+				e.chunk->lines.push_back(line);
+				e.chunk->dirty = true;
+				break;
+			default:
+				residual.push_back(line);
+		}
+
+		if (x->expires)
+		{
+			Expiry ex = { x->expires, e.seq, x };
+			expiry.push(ex);
+		}
+	}
+
+	void Remove(XLine *x)
+	{
+		TR1NS::unordered_map<XLine *, Entry>::iterator it = entries.find(x);
+		if (it == entries.end())
+			return;
+
+		const Entry &e = it->second;
+		Line line = { e.seq, x };
+		switch (e.kind)
+		{
+			case EXACT:
+				Erase(exact, e.key, line);
+				break;
+			case SUFFIX:
+				Erase(suffix, e.key, line);
+				break;
+			case PREFIX:
+				Erase(prefix, e.key, line);
+				break;
+			case REGEX:
+				Erase(e.chunk->lines, line);
+				e.chunk->dirty = true;
+				if (e.chunk->lines.empty())
+				{
+					regexes.erase(std::find(regexes.begin(), regexes.end(), e.chunk));
+					delete e.chunk;
+				}
+				break;
+			default:
+				Erase(residual, line);
+		}
+
+		if (e.family != AF_UNSPEC)
+		{
+			cidr_map::iterator cit = cidrs.find(std::make_pair(e.family, e.len));
+			if (cit != cidrs.end())
+			{
+				TR1NS::unordered_map<std::string, Bucket>::iterator nit = cit->second.find(e.network);
+				if (nit != cit->second.end())
+				{
+					Erase(nit->second, line);
+					if (nit->second.empty())
+						cit->second.erase(nit);
+				}
+				if (cit->second.empty())
+					cidrs.erase(cit);
+			}
+		}
+
+		/* Its entry in the expiry heap is skipped when it comes up */
+		entries.erase(it);
+	}
+
+	/* Free the combined regexes, they are rebuilt when next needed */
+	void DropRegexes()
+	{
+		for (unsigned i = 0; i < regexes.size(); ++i)
+		{
+			RegexChunk *chunk = regexes[i];
+			delete chunk->combined;
+			chunk->combined = NULL;
+			chunk->dirty = true;
+		}
+	}
+
+	void Clear()
+	{
+		entries.clear();
+		exact.clear();
+		suffix.clear();
+		prefix.clear();
+		cidrs.clear();
+		residual.clear();
+		for (unsigned i = 0; i < regexes.size(); ++i)
+			delete regexes[i];
+		regexes.clear();
+		while (!expiry.empty())
+			expiry.pop();
+	}
+
+	/* Expire all of the XLines which are due */
+	void Expire(XLineManager *xlm)
+	{
+		while (!expiry.empty() && expiry.top().expires < Anope::CurTime)
+		{
+			Expiry ex = expiry.top();
+			expiry.pop();
+
+			TR1NS::unordered_map<XLine *, Entry>::iterator it = entries.find(ex.x);
+			if (it == entries.end() || it->second.seq != ex.seq)
+				continue;
+
+			/* The expiry was changed after it was added */
+			if (ex.x->expires != ex.expires)
+			{
+				if (ex.x->expires)
+				{
+					ex.expires = ex.x->expires;
+					expiry.push(ex);
+				}
+				continue;
+			}
+
+			xlm->OnExpire(ex.x);
+			xlm->DelXLine(ex.x);
+		}
+	}
+
+	/* Check a user against the XLines which may match them, newest first.
+	 * The residual XLines are already in order, so the indexed ones are
+	 * merged into them as they are walked from the newest.
+	 */
+	XLine *Check(XLineManager *xlm, User *u)
+	{
+		Bucket candidates;
+		this->Find(xlm, u, candidates);
+
+		size_t r = residual.size(), c = 0;
+		while (r || c < candidates.size())
+		{
+			XLine *x;
+			if (r && (c == candidates.size() || residual[r - 1].seq > candidates[c].seq))
+				x = residual[--r].x;
+			else
+				x = candidates[c++].x;
+
+			/* Deleting this only moves the residual XLines after it, which have been checked already */
+			if (x->expires && x->expires < Anope::CurTime)
+			{
+				xlm->OnExpire(x);
+				xlm->DelXLine(x);
+				continue;
+			}
+
+			if (xlm->Check(u, x))
+			{
+				xlm->OnMatch(u, x);
+				return x;
+			}
+		}
+
+		return NULL;
+	}
+};
+
 void XLine::Init()
 {
 	if (this->mask.length() >= 2 && this->mask[0] == '/' && this->mask[this->mask.length() - 1] == '/' && !Config->GetBlock("options")->Get<const Anope::string>("regexengine").empty())
@@ -43,41 +547,49 @@ void XLine::Init()
 		}
 	}
 
+	Anope::string n, u, h, r;
+
 	size_t nick_t = this->mask.find('!');
 	if (nick_t != Anope::string::npos)
-		nick = this->mask.substr(0, nick_t);
+		n = this->mask.substr(0, nick_t);
 
 	size_t user_t = this->mask.find('!'), host_t = this->mask.find('@');
 	if (host_t != Anope::string::npos)
 	{
 		if (user_t != Anope::string::npos && host_t > user_t)
-			user = this->mask.substr(user_t + 1, host_t - user_t - 1);
+			u = this->mask.substr(user_t + 1, host_t - user_t - 1);
 		else
-			user = this->mask.substr(0, host_t);
+			u = this->mask.substr(0, host_t);
 	}
 
 	size_t real_t = this->mask.find('#');
 	if (host_t != Anope::string::npos)
 	{
 		if (real_t != Anope::string::npos && real_t > host_t)
-			host = this->mask.substr(host_t + 1, real_t - host_t - 1);
+			h = this->mask.substr(host_t + 1, real_t - host_t - 1);
 		else
-			host = this->mask.substr(host_t + 1);
+			h = this->mask.substr(host_t + 1);
 	}
 	else
 	{
 		if (real_t != Anope::string::npos)
-			host = this->mask.substr(0, real_t);
+			h = this->mask.substr(0, real_t);
 		else
-			host = this->mask;
+			h = this->mask;
 	}
 
 	if (real_t != Anope::string::npos)
-		real = this->mask.substr(real_t + 1);
+		r = this->mask.substr(real_t + 1);
+
+	nick = Anope::CompiledMask(n);
+	user = Anope::CompiledMask(u);
+	host = Anope::CompiledMask(h);
+	real = Anope::CompiledMask(r);
+	compiled_mask = Anope::CompiledMask(this->mask);
 
-	if (host.find('/') != Anope::string::npos)
+	if (h.find('/') != Anope::string::npos)
 	{
-		c = new cidr(host);
+		c = new cidr(h);
 		if (!c->valid())
 		{
 			delete c;
@@ -115,22 +627,22 @@ XLine::~XLine()
 
 const Anope::string &XLine::GetNick() const
 {
-	return nick;
+	return nick.GetMask();
 }
 
 const Anope::string &XLine::GetUser() const
 {
-	return user;
+	return user.GetMask();
 }
 
 const Anope::string &XLine::GetHost() const
 {
-	return host;
+	return host.GetMask();
 }
 
 const Anope::string &XLine::GetReal() const
 {
-	return real;
+	return real.GetMask();
 }
 
 Anope::string XLine::GetReason() const
@@ -153,23 +665,19 @@ bool XLine::IsRegex() const
 
 void XLine::Serialize(Serialize::Data &data) const
 {
-	data["mask"] << this->mask;
-	data["by"] << this->by;
-	data["created"] << this->created;
-	data["expires"] << this->expires;
-	data["reason"] << this->reason;
-	data["uid"] << this->id;
+	data.SetString("mask", this->mask);
+	data.SetString("by", this->by);
+	data.SetInt("created", this->created);
+	data.SetInt("expires", this->expires);
+	data.SetString("reason", this->reason);
+	data.SetString("uid", this->id);
 	if (this->manager)
-		data["manager"] << this->manager->name;
+		data.SetString("manager", this->manager->name);
 }
 
 Serializable* XLine::Unserialize(Serializable *obj, Serialize::Data &data)
 {
-	Anope::string smanager;
-
-	data["manager"] >> smanager;
-
-	ServiceReference<XLineManager> xlm("XLineManager", smanager);
+	ServiceReference<XLineManager> xlm("XLineManager", data.GetString("manager"));
 	if (!xlm)
 		return NULL;
 
@@ -177,33 +685,38 @@ Serializable* XLine::Unserialize(Serializable *obj, Serialize::Data &data)
 	if (obj)
 	{
 		xl = anope_dynamic_static_cast<XLine *>(obj);
-		data["mask"] >> xl->mask;
-		data["by"] >> xl->by;
-		data["reason"] >> xl->reason;
-		data["uid"] >> xl->id;
+
+		Anope::string mask = data.GetString("mask");
+		if (mask != xl->mask)
+		{
+			/* Parse and compile the new mask */
+			xl->mask = mask;
+			delete xl->regex;
+			xl->regex = NULL;
+			delete xl->c;
+			xl->c = NULL;
+			xl->Init();
+		}
+
+		xl->by = data.GetString("by");
+		xl->reason = data.GetString("reason");
+		xl->id = data.GetString("uid");
 
 		if (xlm != xl->manager)
 		{
 			xl->manager->DelXLine(xl);
 			xlm->AddXLine(xl);
 		}
+		else
+			xlm->UpdateXLine(xl);
 	}
 	else
 	{
-		Anope::string smask, sby, sreason, suid;
-		time_t expires;
-
-		data["mask"] >> smask;
-		data["by"] >> sby;
-		data["reason"] >> sreason;
-		data["uid"] >> suid;
-		data["expires"] >> expires;
-
-		xl = new XLine(smask, sby, expires, sreason, suid);
+		xl = new XLine(data.GetString("mask"), data.GetString("by"), data.GetInt("expires"), data.GetString("reason"), data.GetString("uid"));
 		xlm->AddXLine(xl);
 	}
 
-	data["created"] >> xl->created;
+	xl->created = data.GetInt("created", xl->created);
 	xl->manager = xlm;
 
 	return xl;
@@ -261,13 +774,14 @@ Anope::string XLineManager::GenerateUID()
 	return id;
 }
 
-XLineManager::XLineManager(Module *creator, const Anope::string &xname, char t) : Service(creator, "XLineManager", xname), type(t), xlines("XLine")
+XLineManager::XLineManager(Module *creator, const Anope::string &xname, char t) : Service(creator, "XLineManager", xname), type(t), xlines("XLine"), xline_index(new XLineIndex())
 {
 }
 
 XLineManager::~XLineManager()
 {
 	this->Clear();
+	delete xline_index;
 }
 
 const char &XLineManager::Type()
@@ -291,12 +805,21 @@ void XLineManager::AddXLine(XLine *x)
 		XLinesByUID->insert(std::make_pair(x->id, x));
 	this->xlines->push_back(x);
 	x->manager = this;
+	this->xline_index->Add(this, x);
+}
+
+void XLineManager::UpdateXLine(XLine *x)
+{
+	this->xline_index->Remove(x);
+	this->xline_index->Add(this, x);
 }
 
 void XLineManager::RemoveXLine(XLine *x)
 {
 	/* called from the destructor */
 
+	this->xline_index->Remove(x);
+
 	std::vector<XLine *>::iterator it = std::find(this->xlines->begin(), this->xlines->end(), x);
 
 	if (!x->id.empty())
@@ -319,6 +842,8 @@ void XLineManager::RemoveXLine(XLine *x)
 
 bool XLineManager::DelXLine(XLine *x)
 {
+	this->xline_index->Remove(x);
+
 	std::vector<XLine *>::iterator it = std::find(this->xlines->begin(), this->xlines->end(), x);
 
 	if (!x->id.empty())
@@ -351,15 +876,20 @@ XLine* XLineManager::GetEntry(unsigned index)
 	if (index >= this->xlines->size())
 		return NULL;
 
-	XLine *x = this->xlines->at(index);
-	x->QueueUpdate();
-	return x;
+	return this->xlines->at(index);
+}
+
+void XLineManager::DropRegexes()
+{
+	for (std::list<XLineManager *>::iterator it = XLineManagers.begin(), it_end = XLineManagers.end(); it != it_end; ++it)
+		(*it)->xline_index->DropRegexes();
 }
 
 void XLineManager::Clear()
 {
 	std::vector<XLine *> xl;
 	this->xlines->swap(xl);
+	this->xline_index->Clear();
 
 	for (unsigned i = 0; i < xl.size(); ++i)
 	{
@@ -383,6 +913,7 @@ bool XLineManager::CanAdd(CommandSource &source, const Anope::string &mask, time
 				if (x->reason != reason)
 				{
 					x->reason = reason;
+					x->QueueUpdate();
 					source.Reply(_("Reason for %s updated."), x->mask.c_str());
 				}
 				else
@@ -391,6 +922,7 @@ bool XLineManager::CanAdd(CommandSource &source, const Anope::string &mask, time
 			else
 			{
 				x->expires = expires;
+				x->QueueUpdate();
 				if (x->reason != reason)
 				{
 					x->reason = reason;
@@ -423,19 +955,13 @@ XLine* XLineManager::HasEntry(const Anope::string &mask)
 	if (it != XLinesByUID->end())
 		for (std::multimap<Anope::string, XLine *, ci::less>::iterator it2 = XLinesByUID->upper_bound(mask); it != it2; ++it)
 			if (it->second->manager == NULL || it->second->manager == this)
-			{
-				it->second->QueueUpdate();
 				return it->second;
-			}
 	for (unsigned i = 0, end = this->xlines->size(); i < end; ++i)
 	{
 		XLine *x = this->xlines->at(i);
 
 		if (x->mask.equals_ci(mask))
-		{
-			x->QueueUpdate();
 			return x;
-		}
 	}
 
 	return NULL;
@@ -443,27 +969,24 @@ XLine* XLineManager::HasEntry(const Anope::string &mask)
 
 XLine *XLineManager::CheckAllXLines(User *u)
 {
-	for (unsigned i = this->xlines->size(); i > 0; --i)
-	{
-		XLine *x = this->xlines->at(i - 1);
-
-		if (x->expires && x->expires < Anope::CurTime)
-		{
-			this->OnExpire(x);
-			this->DelXLine(x);
-			continue;
-		}
+	this->xline_index->Expire(this);
+	return this->xline_index->Check(this, u);
+}
 
-		if (this->Check(u, x))
-		{
-			this->OnMatch(u, x);
-			return x;
-		}
-	}
+bool XLineManager::GetIndexMask(const XLine *x, Anope::string &mask)
+{
+	return false;
+}
 
+const sockaddrs *XLineManager::GetIndexKeys(User *u, std::vector<Anope::string> &keys)
+{
 	return NULL;
 }
 
+void XLineManager::GetRegexKeys(User *u, std::vector<Anope::string> &keys)
+{
+}
+
 void XLineManager::OnExpire(const XLine *x)
 {
 }